@@ -0,0 +1,843 @@
+#include <string>
+#include <list>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <streambuf>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+
+#include "scytl-reader.h"
+#include "scytl-validate.h"
+#include "scytl-generate.h"
+#include "scytl-perf.h"
+#include "scytl-alloc.h"
+#include "scytl-json.h"
+#include "tinyxml2.h"
+
+using namespace std;
+using namespace tinyxml2;
+
+// Times each phase of reading a workbook on its own, so it's clear where the
+// time goes:
+//
+//   load        read the file into memory
+//   scan        find the worksheets and hash them
+//   parse       build the DOM for every worksheet
+//   toc         extract the table of contents from its DOM
+//   voters      extract Registered Voters from its DOM
+//   contests    extract every contest from its DOM
+//   validate    check Total Votes and Total on every contest
+//   read        all of the above, through CScytlReader::Read()
+//   format      Print() the results (to a stream that just counts bytes)
+//   ToInt       XMLUtil::ToInt() on every number in the workbook
+//   SkipWhiteSpace  XMLUtil::SkipWhiteSpace() on every run of whitespace
+//
+// Every phase is run a few times untimed first, then timed for the given
+// number of runs. Results are one line per phase:
+//
+//   workbook;phase;runs;median ms;p99 ms;MB/s;rows/s;allocs;allocs/row;instructions;ipc;cache misses;branch misses
+//
+// where bytes and rows are what the phase handles: the whole file for load,
+// scan, parse and read, only the numbers for ToInt, and so on. For ToInt and
+// SkipWhiteSpace "rows" are calls. Allocs are the heap allocations one run
+// makes (see scytl-alloc.h); unlike the times they don't depend on the host,
+// so they're what to watch while taking allocations out of a phase.
+// Instructions, cache misses and branch misses (medians per run, IPC from the
+// median instructions and cycles) are only there when the kernel hands out
+// hardware counters, see scytl-perf.h; they tell a phase that chases
+// pointers through the DOM (toc, contests) from one that streams through the
+// bytes (scan, parse). A last line per workbook gives the peak resident set
+// size while it was benchmarked.
+//
+// --json writes the same results as JSON, one result per line:
+//
+//   {"benchmark":"bench-scytl-reader","results":[
+//   {"workbook":"detail.xls","phase":"load","runs":10,"bytes":583154,"rows":4646,"medianMs":0.147,"p99Ms":0.164,"allocs":1,"instructions":312345,"cycles":201234,"cacheMisses":850,"branchMisses":1520},
+//   ...
+//   {"workbook":"detail.xls","phase":"memory","peakRssKb":10240}
+//   ]}
+//
+// and --baseline compares the results with a file written that way, listing
+// every median time, allocation count, instruction count and peak RSS that
+// got worse by more than the threshold. Baselines only mean something on the host (and build)
+// they were recorded on.
+
+// the reader's phases, one at a time
+class CPhaseReader : public CScytlReader
+{
+public:
+  CPhaseReader(const string &Filename) : CScytlReader(Filename) {}
+
+  using CScytlReader::TTocEntry;
+  using CScytlReader::loadFile;
+  using CScytlReader::scanWorksheets;
+  using CScytlReader::parseRange;
+  using CScytlReader::readTableOfContentsWorksheet;
+  using CScytlReader::readRegisteredVotersWorksheet;
+  using CScytlReader::readElectionResultsWorksheet;
+};
+
+// discards what's written to it, counting the bytes
+class CCountingBuffer : public streambuf
+{
+public:
+  CCountingBuffer() : Bytes(0) {}
+
+  unsigned long long Bytes;
+
+protected:
+  virtual int overflow(int c)
+  {
+    if (c != EOF)
+      ++Bytes;
+    return c == EOF ? 0 : c;
+  }
+
+  virtual streamsize xsputn(const char * /* s */, streamsize n)
+  {
+    Bytes += n;
+    return n;
+  }
+};
+
+static double now()
+{
+  return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// time, allocations and hardware counters spent between Start() and Stop(),
+// added up over however many times it's started and stopped
+class CStopwatch
+{
+public:
+  CStopwatch(const CPerfCounters &Counters)
+    : Seconds(0), counters(&Counters), startSeconds(0)
+  {}
+
+  void Start()
+  {
+    startAllocs = ThreadAllocCounts();
+    startCounters = counters->Sample();
+    startSeconds = now();
+  }
+
+  void Stop()
+  {
+    Seconds += now() - startSeconds;
+    Counters += counters->Sample() - startCounters;
+    Allocs += ThreadAllocCounts() - startAllocs;
+  }
+
+  double Seconds;
+  CPerfSample Counters;
+  CAllocCounts Allocs;
+
+private:
+  const CPerfCounters *counters;
+  double startSeconds;
+  CPerfSample startCounters;
+  CAllocCounts startAllocs;
+};
+
+class CPhase
+{
+public:
+  CPhase() : Bytes(0), Rows(0) {}
+
+  string Name;
+  vector<double> Seconds;
+  vector<double> Instructions;
+  vector<double> Cycles;
+  vector<double> CacheMisses;
+  vector<double> BranchMisses;
+  vector<double> Allocs;
+  unsigned long long Bytes;   // per run
+  unsigned long long Rows;    // per run
+};
+
+// one line of results. values that weren't measured are -1.
+class CResult
+{
+public:
+  CResult() : Runs(-1), Bytes(-1), Rows(-1), MedianMs(-1), P99Ms(-1), Allocs(-1), Instructions(-1),
+              Cycles(-1), CacheMisses(-1), BranchMisses(-1), PeakRssKb(-1) {}
+
+  string Workbook;
+  string Phase;
+  double Runs;
+  double Bytes;
+  double Rows;
+  double MedianMs;
+  double P99Ms;
+  double Allocs;
+  double Instructions;
+  double Cycles;
+  double CacheMisses;
+  double BranchMisses;
+  double PeakRssKb;
+};
+
+static double percentile(vector<double> samples, double p)
+{
+  sort(samples.begin(), samples.end());
+  size_t i = (size_t)(p * samples.size());
+  if (i >= samples.size())
+    i = samples.size() - 1;
+  return samples[i];
+}
+
+static void report(ostream &out, const CResult &result)
+{
+  char line[512];
+  if (result.Phase == "memory") {
+    snprintf(line, sizeof(line), "%s;memory;;;;;;;;;;;;peak RSS %.0f kB",
+             result.Workbook.c_str(), result.PeakRssKb);
+    out << line << endl;
+    return;
+  }
+
+  double seconds = result.MedianMs / 1e3;
+  snprintf(line, sizeof(line), "%s;%s;%.0f;%.3f;%.3f;%.1f;%.0f;",
+           result.Workbook.c_str(), result.Phase.c_str(), result.Runs,
+           result.MedianMs, result.P99Ms,
+           seconds > 0 ? result.Bytes / seconds / 1e6 : 0.0,
+           seconds > 0 ? result.Rows / seconds : 0.0);
+  out << line;
+  if (result.Allocs >= 0) {
+    snprintf(line, sizeof(line), "%.0f;%.2f;", result.Allocs, result.Rows > 0 ? result.Allocs / result.Rows : 0.0);
+    out << line;
+  }
+  else
+    out << ";;";
+  if (result.Instructions >= 0)
+    out << (unsigned long long)result.Instructions;
+  out << ";";
+  if (result.Instructions >= 0 && result.Cycles > 0) {
+    snprintf(line, sizeof(line), "%.2f", result.Instructions / result.Cycles);
+    out << line;
+  }
+  out << ";";
+  if (result.CacheMisses >= 0)
+    out << (unsigned long long)result.CacheMisses;
+  out << ";";
+  if (result.BranchMisses >= 0)
+    out << (unsigned long long)result.BranchMisses;
+  out << endl;
+}
+
+#ifdef __linux__
+// VmHWM from /proc/self/status, or failing that the (never reset) peak from
+// getrusage()
+static double peakRss()
+{
+  ifstream status("/proc/self/status");
+  string line;
+  while (getline(status, line))
+  {
+    if (line.compare(0, 6, "VmHWM:") == 0)
+      return atof(line.c_str() + 6);
+  }
+
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0)
+    return (double)usage.ru_maxrss;
+  return -1;
+}
+
+// start VmHWM again from the current RSS, so each workbook gets its own peak
+static void resetPeakRss()
+{
+  ofstream clear("/proc/self/clear_refs");
+  clear << "5" << endl;
+}
+#else
+static double peakRss() { return -1; }
+static void resetPeakRss() {}
+#endif
+
+// what the phases need, read once up front
+class CWorkbook
+{
+public:
+  vector<char> Buffer;
+  vector<CWorksheetRange> Sheets;
+  size_t Toc;
+  size_t Voters;
+  unsigned long long Rows;              // regions over every worksheet
+  unsigned long long TocRows;
+  unsigned long long ContestRows;
+  unsigned long long ContestBytes;
+  vector<string> Numbers;               // every vote count, as text
+  vector<const char *> WhiteSpace;      // start of every run of whitespace
+  unsigned long long WhiteSpaceBytes;
+};
+
+static int prepare(CPhaseReader &reader, CWorkbook &workbook)
+{
+  if (reader.loadFile(workbook.Buffer) || reader.scanWorksheets(workbook.Buffer, workbook.Sheets))
+    return 1;
+
+  workbook.Toc = workbook.Voters = workbook.Sheets.size();
+  workbook.ContestBytes = 0;
+  for (size_t i = 0; i < workbook.Sheets.size(); ++i)
+  {
+    if (workbook.Sheets[i].Name == "Table of Contents")
+      workbook.Toc = i;
+    else if (workbook.Sheets[i].Name == "Registered Voters")
+      workbook.Voters = i;
+    else
+      workbook.ContestBytes += workbook.Sheets[i].Length;
+  }
+  if (workbook.Toc == workbook.Sheets.size() || workbook.Voters == workbook.Sheets.size())
+    return 1;
+
+  if (reader.Read())
+    return 1;
+  workbook.Rows = reader.RegionProfiles().size();
+  workbook.ContestRows = 0;
+  const list<CElection> &elections = reader.ElectionResults();
+  for (list<CElection>::const_iterator it = elections.begin(); it != elections.end(); ++it)
+  {
+    workbook.ContestRows += it->Results.size();
+    for (list<CLabeledTuple>::const_iterator itRow = it->Results.begin(); itRow != it->Results.end(); ++itRow)
+    {
+      for (size_t i = 0; i < itRow->Data.size(); ++i)
+      {
+        ostringstream number;
+        number << itRow->Data[i];
+        workbook.Numbers.push_back(number.str());
+      }
+    }
+  }
+  workbook.Rows += workbook.ContestRows;
+  workbook.TocRows = elections.size() + 1;
+
+  workbook.WhiteSpaceBytes = 0;
+  const char *base = &workbook.Buffer[0];
+  size_t size = workbook.Buffer.size() - 1;
+  for (size_t i = 0; i < size; ++i)
+  {
+    if (!XMLUtil::IsWhiteSpace(base[i]))
+      continue;
+    if (i == 0 || !XMLUtil::IsWhiteSpace(base[i - 1]))
+      workbook.WhiteSpace.push_back(base + i);
+    ++workbook.WhiteSpaceBytes;
+  }
+
+  return 0;
+}
+
+// keeps the compiler from dropping the primitives' results
+static volatile long long sink;
+
+enum
+{
+  LOAD, SCAN, PARSE, TOC, VOTERS, CONTESTS, VALIDATE, READ, FORMAT, TOINT, SKIPWHITESPACE,
+  PHASES
+};
+
+static const char *phaseNames[PHASES] = {
+  "load", "scan", "parse", "toc", "voters", "contests", "validate", "read", "format",
+  "ToInt", "SkipWhiteSpace",
+};
+
+// one pass over every phase, one stopwatch per phase. returns 1 if anything
+// failed.
+static int runPhases(const string &filename, const CWorkbook &workbook, vector<CStopwatch> &watches,
+                     unsigned long long &formatted)
+{
+  CPhaseReader reader(filename);
+
+  {
+    vector<char> buffer;
+    watches[LOAD].Start();
+    if (reader.loadFile(buffer))
+      return 1;
+    watches[LOAD].Stop();
+  }
+
+  {
+    vector<CWorksheetRange> sheets;
+    watches[SCAN].Start();
+    if (reader.scanWorksheets(workbook.Buffer, sheets))
+      return 1;
+    watches[SCAN].Stop();
+  }
+
+  // parse and extract each worksheet in turn, timing the two separately
+  for (size_t i = 0; i < workbook.Sheets.size(); ++i)
+  {
+    const CWorksheetRange &sheet = workbook.Sheets[i];
+    watches[PARSE].Start();
+    const XMLElement *ws = reader.parseRange(workbook.Buffer, sheet.Offset, sheet.Length, "s:Worksheet");
+    watches[PARSE].Stop();
+    if (!ws)
+      return 1;
+
+    if (i == workbook.Toc) {
+      list<CPhaseReader::TTocEntry> entries;
+      watches[TOC].Start();
+      if (reader.readTableOfContentsWorksheet(ws, entries))
+        return 1;
+      watches[TOC].Stop();
+    }
+    else if (i == workbook.Voters) {
+      list<CRegionProfile> profiles;
+      watches[VOTERS].Start();
+      if (reader.readRegisteredVotersWorksheet(ws, profiles))
+        return 1;
+      watches[VOTERS].Stop();
+    }
+    else if (i > workbook.Voters) {
+      CElection election;
+      watches[CONTESTS].Start();
+      if (reader.readElectionResultsWorksheet(ws, election))
+        return 1;
+      watches[CONTESTS].Stop();
+      watches[VALIDATE].Start();
+      ValidateTotals(election, election.Mismatches);
+      watches[VALIDATE].Stop();
+    }
+  }
+
+  {
+    CScytlReader full(filename);
+    watches[READ].Start();
+    if (full.Read())
+      return 1;
+    watches[READ].Stop();
+
+    CCountingBuffer counter;
+    ostream out(&counter);
+    watches[FORMAT].Start();
+    full.Print(out);
+    watches[FORMAT].Stop();
+    formatted = counter.Bytes;
+  }
+
+  {
+    long long sum = 0;
+    watches[TOINT].Start();
+    for (size_t i = 0; i < workbook.Numbers.size(); ++i)
+    {
+      int value = 0;
+      XMLUtil::ToInt(workbook.Numbers[i].c_str(), &value);
+      sum += value;
+    }
+    watches[TOINT].Stop();
+    sink = sum;
+  }
+
+  {
+    long long sum = 0;
+    watches[SKIPWHITESPACE].Start();
+    for (size_t i = 0; i < workbook.WhiteSpace.size(); ++i)
+      sum += XMLUtil::SkipWhiteSpace(workbook.WhiteSpace[i]) - workbook.WhiteSpace[i];
+    watches[SKIPWHITESPACE].Stop();
+    sink = sum;
+  }
+
+  return 0;
+}
+
+static int benchmark(const string &filename, const string &label, int warmup, int runs,
+                     const CPerfCounters &counters, vector<CResult> &results)
+{
+  resetPeakRss();
+
+  CPhaseReader reader(filename);
+  CWorkbook workbook;
+  if (prepare(reader, workbook)) {
+    cout << "Error reading from <" << filename << ">" << endl;
+    return 1;
+  }
+
+  vector<CPhase> phases(PHASES);
+  for (size_t i = 0; i < phases.size(); ++i)
+    phases[i].Name = phaseNames[i];
+
+  unsigned long long fileBytes = workbook.Buffer.size() - 1;
+  unsigned long long numberBytes = 0;
+  for (size_t i = 0; i < workbook.Numbers.size(); ++i)
+    numberBytes += workbook.Numbers[i].size();
+
+  phases[LOAD].Bytes = phases[SCAN].Bytes = phases[PARSE].Bytes = phases[READ].Bytes = fileBytes;
+  phases[LOAD].Rows = phases[SCAN].Rows = phases[PARSE].Rows = phases[READ].Rows = phases[FORMAT].Rows = workbook.Rows;
+  phases[TOC].Bytes = workbook.Sheets[workbook.Toc].Length;
+  phases[TOC].Rows = workbook.TocRows;
+  phases[VOTERS].Bytes = workbook.Sheets[workbook.Voters].Length;
+  phases[VOTERS].Rows = workbook.Rows - workbook.ContestRows;
+  phases[CONTESTS].Bytes = phases[VALIDATE].Bytes = workbook.ContestBytes;
+  phases[CONTESTS].Rows = phases[VALIDATE].Rows = workbook.ContestRows;
+  phases[TOINT].Bytes = numberBytes;
+  phases[TOINT].Rows = workbook.Numbers.size();
+  phases[SKIPWHITESPACE].Bytes = workbook.WhiteSpaceBytes;
+  phases[SKIPWHITESPACE].Rows = workbook.WhiteSpace.size();
+
+  for (int i = 0; i < warmup + runs; ++i)
+  {
+    vector<CStopwatch> watches(PHASES, CStopwatch(counters));
+    unsigned long long formatted = 0;
+    if (runPhases(filename, workbook, watches, formatted)) {
+      cout << "Error reading from <" << filename << ">" << endl;
+      return 1;
+    }
+    if (i < warmup)
+      continue;
+
+    for (size_t p = 0; p < phases.size(); ++p)
+    {
+      phases[p].Seconds.push_back(watches[p].Seconds);
+      phases[p].Instructions.push_back((double)watches[p].Counters.Instructions);
+      phases[p].Cycles.push_back((double)watches[p].Counters.Cycles);
+      phases[p].CacheMisses.push_back((double)watches[p].Counters.CacheMisses);
+      phases[p].BranchMisses.push_back((double)watches[p].Counters.BranchMisses);
+      phases[p].Allocs.push_back((double)watches[p].Allocs.Allocs);
+    }
+    phases[FORMAT].Bytes = formatted;
+  }
+
+  for (size_t i = 0; i < phases.size(); ++i)
+  {
+    CResult result;
+    result.Workbook = label;
+    result.Phase = phases[i].Name;
+    result.Runs = (double)phases[i].Seconds.size();
+    result.Bytes = (double)phases[i].Bytes;
+    result.Rows = (double)phases[i].Rows;
+    result.MedianMs = percentile(phases[i].Seconds, 0.5) * 1e3;
+    result.P99Ms = percentile(phases[i].Seconds, 0.99) * 1e3;
+    if (AllocCounting())
+      result.Allocs = percentile(phases[i].Allocs, 0.5);
+    if (counters.Available())
+      result.Instructions = percentile(phases[i].Instructions, 0.5);
+    if (counters.HasCycles())
+      result.Cycles = percentile(phases[i].Cycles, 0.5);
+    if (counters.HasCacheMisses())
+      result.CacheMisses = percentile(phases[i].CacheMisses, 0.5);
+    if (counters.HasBranchMisses())
+      result.BranchMisses = percentile(phases[i].BranchMisses, 0.5);
+    results.push_back(result);
+  }
+
+  CResult memory;
+  memory.Workbook = label;
+  memory.Phase = "memory";
+  memory.PeakRssKb = peakRss();
+  results.push_back(memory);
+  return 0;
+}
+
+static void writeJsonNumber(ostream &out, const char *key, double value, const char *fmt)
+{
+  if (value < 0)
+    return;
+  char text[64];
+  snprintf(text, sizeof(text), fmt, value);
+  out << ",\"" << key << "\":" << text;
+}
+
+static int writeJson(const string &filename, const vector<CResult> &results)
+{
+  ofstream out(filename.c_str());
+  if (!out) {
+    cout << "Error: can't create <" << filename << ">" << endl;
+    return 1;
+  }
+
+  out << "{\"benchmark\":\"bench-scytl-reader\",\"results\":[" << endl;
+  for (size_t i = 0; i < results.size(); ++i)
+  {
+    const CResult &result = results[i];
+    out << "{\"workbook\":";
+    WriteJsonString(out, result.Workbook);
+    out << ",\"phase\":";
+    WriteJsonString(out, result.Phase);
+    writeJsonNumber(out, "runs", result.Runs, "%.0f");
+    writeJsonNumber(out, "bytes", result.Bytes, "%.0f");
+    writeJsonNumber(out, "rows", result.Rows, "%.0f");
+    writeJsonNumber(out, "medianMs", result.MedianMs, "%.4f");
+    writeJsonNumber(out, "p99Ms", result.P99Ms, "%.4f");
+    writeJsonNumber(out, "allocs", result.Allocs, "%.0f");
+    writeJsonNumber(out, "instructions", result.Instructions, "%.0f");
+    writeJsonNumber(out, "cycles", result.Cycles, "%.0f");
+    writeJsonNumber(out, "cacheMisses", result.CacheMisses, "%.0f");
+    writeJsonNumber(out, "branchMisses", result.BranchMisses, "%.0f");
+    writeJsonNumber(out, "peakRssKb", result.PeakRssKb, "%.0f");
+    out << "}" << (i + 1 < results.size() ? "," : "") << endl;
+  }
+  out << "]}" << endl;
+
+  out.close();
+  if (!out) {
+    cout << "Error writing <" << filename << ">" << endl;
+    return 1;
+  }
+  return 0;
+}
+
+// the value of "key" in a line written by writeJson()
+static bool jsonString(const string &line, const char *key, string &value)
+{
+  string pattern = string("\"") + key + "\":\"";
+  size_t p = line.find(pattern);
+  if (p == string::npos)
+    return false;
+
+  value.clear();
+  for (p += pattern.size(); p < line.size() && line[p] != '"'; ++p)
+  {
+    if (line[p] == '\\' && p + 1 < line.size())
+      ++p;
+    value += line[p];
+  }
+  return p < line.size();
+}
+
+static double jsonNumber(const string &line, const char *key)
+{
+  string pattern = string("\"") + key + "\":";
+  size_t p = line.find(pattern);
+  if (p == string::npos)
+    return -1;
+  return atof(line.c_str() + p + pattern.size());
+}
+
+static int readJson(const string &filename, vector<CResult> &results)
+{
+  ifstream in(filename.c_str());
+  if (!in) {
+    cout << "Error: can't open <" << filename << ">" << endl;
+    return 1;
+  }
+
+  string line;
+  while (getline(in, line))
+  {
+    CResult result;
+    if (!jsonString(line, "workbook", result.Workbook) || !jsonString(line, "phase", result.Phase))
+      continue;
+    result.Runs = jsonNumber(line, "runs");
+    result.Bytes = jsonNumber(line, "bytes");
+    result.Rows = jsonNumber(line, "rows");
+    result.MedianMs = jsonNumber(line, "medianMs");
+    result.P99Ms = jsonNumber(line, "p99Ms");
+    result.Allocs = jsonNumber(line, "allocs");
+    result.Instructions = jsonNumber(line, "instructions");
+    result.Cycles = jsonNumber(line, "cycles");
+    result.CacheMisses = jsonNumber(line, "cacheMisses");
+    result.BranchMisses = jsonNumber(line, "branchMisses");
+    result.PeakRssKb = jsonNumber(line, "peakRssKb");
+    results.push_back(result);
+  }
+  return 0;
+}
+
+// list what got worse than the baseline by more than 'threshold' (a
+// fraction). times below 'minimumMs' in both are too noisy to judge. returns
+// the number of regressions.
+static int compareBaseline(ostream &out, const vector<CResult> &baseline, const vector<CResult> &results,
+                           double threshold, double minimumMs)
+{
+  map<pair<string,string>, const CResult *> before;
+  for (size_t i = 0; i < baseline.size(); ++i)
+    before[make_pair(baseline[i].Workbook, baseline[i].Phase)] = &baseline[i];
+
+  int regressions = 0;
+  for (size_t i = 0; i < results.size(); ++i)
+  {
+    const CResult &after = results[i];
+    map<pair<string,string>, const CResult *>::const_iterator it = before.find(make_pair(after.Workbook, after.Phase));
+    if (it == before.end())
+      continue;
+    const CResult &base = *it->second;
+
+    const char *metrics[] = { "medianMs", "allocs", "instructions", "peakRssKb" };
+    double was[] = { base.MedianMs, base.Allocs, base.Instructions, base.PeakRssKb };
+    double is[] = { after.MedianMs, after.Allocs, after.Instructions, after.PeakRssKb };
+    for (int m = 0; m < 4; ++m)
+    {
+      if (was[m] <= 0 || is[m] < 0)
+        continue;
+      if (m == 0 && was[m] < minimumMs && is[m] < minimumMs)
+        continue;
+      if (is[m] <= was[m] * (1 + threshold))
+        continue;
+
+      char line[512];
+      snprintf(line, sizeof(line), "Regression;%s;%s;%s;%.4g;%.4g;+%.1f%%",
+               after.Workbook.c_str(), after.Phase.c_str(), metrics[m],
+               was[m], is[m], (is[m] / was[m] - 1) * 100);
+      out << line << endl;
+      ++regressions;
+    }
+  }
+  return regressions;
+}
+
+static string basename(const string &filename)
+{
+  size_t slash = filename.find_last_of("/\\");
+  return slash == string::npos ? filename : filename.substr(slash + 1);
+}
+
+void usage(int /* argc */, char * const *argv)
+{
+  cout << argv[0] << " [options] [<filename> ...]" << endl
+       << endl
+       << "Time each phase of reading the given workbooks, and of generated ones." << endl
+       << endl
+       << "  --runs <n>          timed runs per workbook, default 10" << endl
+       << "  --warmup <n>        untimed runs first, default 2" << endl
+       << "  --generate <n>      also benchmark a generated workbook with <n> regions (repeatable)" << endl
+       << "  --contests <n>      contests in generated workbooks" << endl
+       << "  --candidates <n>    candidates per contest in generated workbooks" << endl
+       << "  --vote-types <n>    vote types per candidate in generated workbooks" << endl
+       << "  --whitespace <ws>   whitespace style of generated workbooks" << endl
+       << "  --seed <n>          seed for generated workbooks" << endl
+       << "  --json <out>        write the results as JSON" << endl
+       << "  --baseline <file>   compare with results written by --json, exit 1 on a regression" << endl
+       << "  --threshold <pct>   how much worse than the baseline counts as a regression, default 10" << endl
+       << "  --min-ms <ms>       don't compare median times below this, default 0.1" << endl;
+}
+
+int main(int argc, char **argv)
+{
+  vector<string> infiles;
+  vector<int> generate;
+  CGeneratorOptions options;
+  int runs = 10;
+  int warmup = 2;
+  string jsonFile;
+  string baselineFile;
+  double threshold = 10;
+  double minimumMs = 0.1;
+
+  int narg = 1;
+  while (narg < argc)
+  {
+    string arg = argv[narg++];
+
+    if (arg == "--runs" && narg < argc) {
+      runs = atoi(argv[narg++]);
+      continue;
+    }
+    if (arg == "--warmup" && narg < argc) {
+      warmup = atoi(argv[narg++]);
+      continue;
+    }
+    if (arg == "--generate" && narg < argc) {
+      generate.push_back(atoi(argv[narg++]));
+      continue;
+    }
+    if (arg == "--contests" && narg < argc) {
+      options.Contests = atoi(argv[narg++]);
+      continue;
+    }
+    if (arg == "--candidates" && narg < argc) {
+      options.Candidates = atoi(argv[narg++]);
+      continue;
+    }
+    if (arg == "--vote-types" && narg < argc) {
+      options.VoteTypes = atoi(argv[narg++]);
+      continue;
+    }
+    if (arg == "--whitespace" && narg < argc) {
+      if (ParseWhitespace(argv[narg++], options.Whitespace)) {
+        usage(argc, argv);
+        exit(1);
+      }
+      continue;
+    }
+    if (arg == "--seed" && narg < argc) {
+      options.Seed = strtoull(argv[narg++], NULL, 10);
+      continue;
+    }
+    if (arg == "--json" && narg < argc) {
+      jsonFile = argv[narg++];
+      continue;
+    }
+    if (arg == "--baseline" && narg < argc) {
+      baselineFile = argv[narg++];
+      continue;
+    }
+    if (arg == "--threshold" && narg < argc) {
+      threshold = atof(argv[narg++]);
+      continue;
+    }
+    if (arg == "--min-ms" && narg < argc) {
+      minimumMs = atof(argv[narg++]);
+      continue;
+    }
+
+    infiles.push_back(arg);
+  }
+
+  bool ok = runs > 0 && warmup >= 0 && (!infiles.empty() || !generate.empty()) &&
+            options.Contests > 0 && options.Candidates > 0 && options.VoteTypes > 0 &&
+            threshold >= 0 && minimumMs >= 0;
+  for (size_t i = 0; i < generate.size(); ++i)
+    ok = ok && generate[i] > 0;
+  if (!ok)
+  {
+    usage(argc, argv);
+    exit(1);
+  }
+
+  // read the baseline first, so a bad path doesn't cost a whole run
+  vector<CResult> baseline;
+  if (baselineFile != "" && readJson(baselineFile, baseline))
+    return 1;
+
+  CPerfCounters counters;
+  counters.Open();
+  SetAllocCounting(true);
+
+  cout << "workbook;phase;runs;median ms;p99 ms;MB/s;rows/s;allocs;allocs/row;instructions;ipc;cache misses;branch misses" << endl;
+
+  int result = 0;
+  vector<CResult> results;
+  for (vector<string>::const_iterator it = infiles.begin(); it != infiles.end(); ++it)
+    result |= benchmark(*it, basename(*it), warmup, runs, counters, results);
+
+  for (vector<int>::const_iterator it = generate.begin(); it != generate.end(); ++it)
+  {
+    options.Regions = *it;
+
+    ostringstream label;
+    label << "generated-" << options.Regions << "x" << options.Contests << "x"
+          << options.Candidates << "x" << options.VoteTypes;
+    string filename = "bench-" + label.str() + ".xls";
+
+    CScytlGenerator generator(options);
+    if (generator.Write(filename)) {
+      result = 1;
+      continue;
+    }
+    result |= benchmark(filename, label.str(), warmup, runs, counters, results);
+
+    remove(filename.c_str());
+    remove(IndexFilename(filename).c_str());
+  }
+
+  for (size_t i = 0; i < results.size(); ++i)
+    report(cout, results[i]);
+
+  if (jsonFile != "" && writeJson(jsonFile, results))
+    result = 1;
+
+  if (baselineFile != "" && compareBaseline(cout, baseline, results, threshold / 100, minimumMs))
+    result = 1;
+
+  return result;
+}
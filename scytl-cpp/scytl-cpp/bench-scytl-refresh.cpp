@@ -0,0 +1,388 @@
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "scytl-watch.h"
+#include "scytl-generate.h"
+
+using namespace std;
+
+// Election night, in miniature: a writer thread rewrites a set of generated
+// workbooks over and over with growing vote counts, while a CScytlWatcher
+// reloads them the way --watch and --serve do. Each rewrite is timed from the
+// moment the new workbook is complete on disk (renamed into place, or closed
+// when writing in place) to the moment a reload that read it has finished.
+//
+// Updates come in rounds: every workbook is rewritten once per round, back to
+// back, and rounds start --interval apart. Results are latency percentiles
+// per workbook, over every update, and per round ("batch": from the first
+// workbook of a round being written to the last one being reloaded).
+//
+//   file;updates;min ms;median ms;p90 ms;p99 ms;max ms
+//
+// A reload that picks up several writes at once counts for each of them, so
+// coalesced writes show up as the longer latencies they are.
+
+// not CScytlWatcher::now(): latencies want a clock that never steps
+static double steadyNow()
+{
+  return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// writes still waiting for a reload, per workbook, in the order they happened
+class CPendingWrites
+{
+public:
+  CPendingWrites(size_t Files) : writes(Files), remaining(0) {}
+
+  void Written(size_t file, int round, double when)
+  {
+    lock_guard<mutex> guard(lock);
+    writes[file].push_back(make_pair(round, when));
+    ++remaining;
+  }
+
+  // every write to 'file' that finished before 'started' has been picked up
+  void Reloaded(size_t file, double started, double finished,
+                vector<double> &latencies, vector<pair<int,double> > &rounds)
+  {
+    lock_guard<mutex> guard(lock);
+    deque<pair<int,double> > &pending = writes[file];
+    while (!pending.empty() && pending.front().second < started)
+    {
+      latencies.push_back(finished - pending.front().second);
+      rounds.push_back(make_pair(pending.front().first, finished));
+      pending.pop_front();
+      --remaining;
+    }
+  }
+
+  int Remaining()
+  {
+    lock_guard<mutex> guard(lock);
+    return remaining;
+  }
+
+private:
+  mutex lock;
+  vector<deque<pair<int,double> > > writes;
+  int remaining;
+};
+
+// records the latency of every write each reload picks up
+class CRefreshWatcher : public CScytlWatcher
+{
+public:
+  CRefreshWatcher(ostream &Out, const vector<string> &Files, CPendingWrites &Pending)
+    : CScytlWatcher(Out), Latencies(Files.size()), files(Files), pending(Pending)
+  {}
+
+  // per workbook
+  vector<vector<double> > Latencies;
+
+  // (round, time the write was picked up) for every write
+  vector<pair<int,double> > Rounds;
+
+protected:
+  virtual void Reloaded(const CScytlReader &reader, double /* changed */, double readSeconds)
+  {
+    double finished = steadyNow();
+    size_t file = find(files.begin(), files.end(), reader.Filename()) - files.begin();
+    if (file < files.size())
+      pending.Reloaded(file, finished - readSeconds, finished, Latencies[file], Rounds);
+  }
+
+private:
+  const vector<string> &files;
+  CPendingWrites &pending;
+};
+
+class CRefreshOptions
+{
+public:
+  CRefreshOptions() : Files(4), Updates(10), IntervalMs(1000), InPlace(false), Directory(".")
+  {
+    Workbook.Regions = 2000;
+    Workbook.Contests = 10;
+  }
+
+  int Files;
+  int Updates;          // rounds
+  int IntervalMs;       // between the starts of two rounds
+  bool InPlace;         // truncate and rewrite instead of rename()
+  string Directory;
+  CGeneratorOptions Workbook;
+};
+
+static string workbookName(const CRefreshOptions &options, int file)
+{
+  ostringstream name;
+  name << options.Directory << "/refresh-" << file + 1 << ".xls";
+  return name.str();
+}
+
+// every workbook's contents for one round. each workbook is its own county,
+// with its own seed.
+static void generateRound(const CRefreshOptions &options, int round, vector<string> &contents)
+{
+  contents.resize(options.Files);
+  for (int i = 0; i < options.Files; ++i)
+  {
+    CGeneratorOptions workbook = options.Workbook;
+    workbook.Seed += i;
+    workbook.Reporting = 100 * round / options.Updates;
+
+    ostringstream out;
+    CScytlGenerator(workbook).Write(out);
+    contents[i] = out.str();
+  }
+}
+
+static int writeWorkbook(const string &filename, const string &contents, bool inPlace)
+{
+  string target = inPlace ? filename : filename + ".tmp";
+  FILE *fp = fopen(target.c_str(), "wb");
+  if (!fp) {
+    cout << "Error: can't create <" << target << ">" << endl;
+    return 1;
+  }
+  bool ok = fwrite(contents.data(), 1, contents.size(), fp) == contents.size();
+  ok = fclose(fp) == 0 && ok;
+  if (ok && !inPlace)
+    ok = rename(target.c_str(), filename.c_str()) == 0;
+  if (!ok) {
+    cout << "Error writing <" << filename << ">" << endl;
+    return 1;
+  }
+  return 0;
+}
+
+// round 0 was written before the watcher started; the rest go here
+static void writeRounds(const CRefreshOptions &options, const vector<string> &files,
+                        CPendingWrites &pending, vector<double> &roundStarts, atomic<bool> &failed)
+{
+  double next = steadyNow();
+  for (int round = 1; round <= options.Updates && !failed; ++round)
+  {
+    vector<string> contents;
+    generateRound(options, round, contents);
+
+    next += options.IntervalMs / 1000.0;
+    double wait = next - steadyNow();
+    if (wait > 0)
+      this_thread::sleep_for(chrono::duration<double>(wait));
+
+    for (int i = 0; i < options.Files; ++i)
+    {
+      if (writeWorkbook(files[i], contents[i], options.InPlace)) {
+        failed = true;
+        return;
+      }
+      double written = steadyNow();
+      if (i == 0)
+        roundStarts[round] = written;
+      pending.Written(i, round, written);
+    }
+  }
+}
+
+static void report(ostream &out, const string &name, vector<double> latencies)
+{
+  if (latencies.empty()) {
+    out << name << ";0;;;;;" << endl;
+    return;
+  }
+
+  sort(latencies.begin(), latencies.end());
+  double percentiles[] = { 0, 0.5, 0.9, 0.99, 1 };
+  out << name << ";" << latencies.size();
+  for (int i = 0; i < 5; ++i)
+  {
+    size_t at = (size_t)(percentiles[i] * latencies.size());
+    if (at >= latencies.size())
+      at = latencies.size() - 1;
+    char value[32];
+    snprintf(value, sizeof(value), ";%.3f", latencies[at] * 1000.0);
+    out << value;
+  }
+  out << endl;
+}
+
+void usage(int /* argc */, char * const *argv)
+{
+  CRefreshOptions defaults;
+  cout << argv[0] << " [options]" << endl
+       << endl
+       << "Rewrite generated workbooks with growing counts while they're being watched, and" << endl
+       << "report how long each rewrite takes to show up in the reloaded results." << endl
+       << endl
+       << "  --files <n>         workbooks, default " << defaults.Files << endl
+       << "  --updates <n>       rounds of rewrites, default " << defaults.Updates << endl
+       << "  --interval <ms>     between the starts of two rounds, default " << defaults.IntervalMs << endl
+       << "  --in-place          rewrite the workbooks in place rather than rename() over them" << endl
+       << "  --dir <path>        where to write the workbooks, default " << defaults.Directory << endl
+       << "  --regions <n>       regions per worksheet, default " << defaults.Workbook.Regions << endl
+       << "  --contests <n>      contests per workbook, default " << defaults.Workbook.Contests << endl
+       << "  --candidates <n>    candidates per contest, default " << defaults.Workbook.Candidates << endl
+       << "  --vote-types <n>    vote types per candidate, default " << defaults.Workbook.VoteTypes << endl
+       << "  --whitespace <ws>   pretty, compact, tabs or crlf, default pretty" << endl
+       << "  --seed <n>          seed for the first workbook, default " << defaults.Workbook.Seed << endl;
+}
+
+int main(int argc, char **argv)
+{
+  CRefreshOptions options;
+
+  int narg = 1;
+  while (narg < argc)
+  {
+    string arg = argv[narg++];
+
+    if (arg == "--files" && narg < argc) {
+      options.Files = atoi(argv[narg++]);
+      continue;
+    }
+    if (arg == "--updates" && narg < argc) {
+      options.Updates = atoi(argv[narg++]);
+      continue;
+    }
+    if (arg == "--interval" && narg < argc) {
+      options.IntervalMs = atoi(argv[narg++]);
+      continue;
+    }
+    if (arg == "--in-place") {
+      options.InPlace = true;
+      continue;
+    }
+    if (arg == "--dir" && narg < argc) {
+      options.Directory = argv[narg++];
+      continue;
+    }
+    if (arg == "--regions" && narg < argc) {
+      options.Workbook.Regions = atoi(argv[narg++]);
+      continue;
+    }
+    if (arg == "--contests" && narg < argc) {
+      options.Workbook.Contests = atoi(argv[narg++]);
+      continue;
+    }
+    if (arg == "--candidates" && narg < argc) {
+      options.Workbook.Candidates = atoi(argv[narg++]);
+      continue;
+    }
+    if (arg == "--vote-types" && narg < argc) {
+      options.Workbook.VoteTypes = atoi(argv[narg++]);
+      continue;
+    }
+    if (arg == "--whitespace" && narg < argc) {
+      if (ParseWhitespace(argv[narg++], options.Workbook.Whitespace)) {
+        usage(argc, argv);
+        exit(1);
+      }
+      continue;
+    }
+    if (arg == "--seed" && narg < argc) {
+      options.Workbook.Seed = strtoull(argv[narg++], NULL, 10);
+      continue;
+    }
+
+    usage(argc, argv);
+    exit(1);
+  }
+
+  if (options.Files < 1 || options.Updates < 1 || options.IntervalMs < 0 ||
+      options.Workbook.Regions < 1 || options.Workbook.Contests < 1 ||
+      options.Workbook.Candidates < 1 || options.Workbook.VoteTypes < 1)
+  {
+    usage(argc, argv);
+    exit(1);
+  }
+
+  vector<string> files;
+  for (int i = 0; i < options.Files; ++i)
+    files.push_back(workbookName(options, i));
+
+  // nothing counted yet
+  {
+    vector<string> contents;
+    generateRound(options, 0, contents);
+    for (int i = 0; i < options.Files; ++i)
+      if (writeWorkbook(files[i], contents[i], options.InPlace))
+        return 1;
+  }
+
+  CPendingWrites pending(files.size());
+  CRefreshWatcher watcher(cerr, files, pending);
+  for (size_t i = 0; i < files.size(); ++i)
+    watcher.Add(files[i]);
+  if (watcher.Start())
+    return 1;
+
+  vector<double> roundStarts(options.Updates + 1, 0);
+  atomic<bool> failed(false);
+  atomic<bool> writing(true);
+  thread writer([&]() {
+    writeRounds(options, files, pending, roundStarts, failed);
+    writing = false;
+  });
+
+  // keep reloading until every write has been picked up. a write that never
+  // shows up (a failed reload) gives up after a few quiet seconds.
+  double quietSince = steadyNow();
+  while (writing || (pending.Remaining() && steadyNow() - quietSince < 5))
+  {
+    int remaining = pending.Remaining();
+    if (watcher.Poll(100)) {
+      failed = true;
+      break;
+    }
+    if (pending.Remaining() != remaining || writing)
+      quietSince = steadyNow();
+  }
+  writer.join();
+
+  cout << "file;updates;min ms;median ms;p90 ms;p99 ms;max ms" << endl;
+  vector<double> all;
+  for (size_t i = 0; i < files.size(); ++i)
+  {
+    report(cout, files[i], watcher.Latencies[i]);
+    all.insert(all.end(), watcher.Latencies[i].begin(), watcher.Latencies[i].end());
+  }
+  report(cout, "all", all);
+
+  // a round is done when its last write has been picked up
+  vector<double> roundDone(options.Updates + 1, 0);
+  vector<int> roundWrites(options.Updates + 1, 0);
+  for (size_t i = 0; i < watcher.Rounds.size(); ++i)
+  {
+    int round = watcher.Rounds[i].first;
+    roundDone[round] = max(roundDone[round], watcher.Rounds[i].second);
+    ++roundWrites[round];
+  }
+  vector<double> batches;
+  for (int round = 1; round <= options.Updates; ++round)
+    if (roundWrites[round] == options.Files)
+      batches.push_back(roundDone[round] - roundStarts[round]);
+  report(cout, "batch", batches);
+
+  if (pending.Remaining())
+    cout << "Error: " << pending.Remaining() << " writes were never picked up" << endl;
+
+  for (size_t i = 0; i < files.size(); ++i)
+  {
+    remove(files[i].c_str());
+    remove(IndexFilename(files[i]).c_str());
+  }
+
+  return failed || pending.Remaining() ? 1 : 0;
+}
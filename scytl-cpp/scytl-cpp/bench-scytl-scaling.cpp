@@ -0,0 +1,507 @@
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "scytl-reader.h"
+#include "scytl-watch.h"
+#include "scytl-generate.h"
+
+using namespace std;
+
+// How far the parallel ingest paths scale, on generated precinct-scale
+// workbooks:
+//
+//  workbook   one workbook read with CScytlReader::SetThreads(t), then printed,
+//             as read-scytl-data --threads does
+//  workbooks  several workbooks loaded by a CScytlWatcher with SetThreads(t),
+//             each printed as it comes in, as --watch --threads does
+//
+// at 1..N threads, both with a fixed input (strong scaling: the workbook has
+// N times --contests contests, or there are N workbooks) and with an input
+// that grows with the threads (weak scaling: t times --contests contests, or t
+// workbooks). One line per point:
+//
+//  mode;scaling;threads;MB;ms;speedup;efficiency;busy %;sys %;minor faults;context switches;io ms;output ms;limit
+//
+// 'busy' is the CPU time used over the time 't' threads had (100% is every
+// thread running all the time), 'sys' the share of that CPU time spent in the
+// kernel. 'io' is how long reading the input into memory takes and 'output'
+// how long printing the results takes, both on one thread; the workbook is
+// read in one go before it's split up, and results are always printed one
+// workbook at a time, so neither gets any faster with more threads.
+//
+// 'limit' is a guess at what stopped the point scaling any better, once the
+// efficiency has dropped below 80%:
+//
+//  cores      more threads than hardware threads
+//  io         the threads mostly waited for the serial read of the input
+//  output     the threads mostly waited for the serial printing of the results
+//  allocator  busy, but more of the time in the kernel or faulting in pages
+//             than on one thread: malloc() arenas growing, mmap() and munmap()
+//  waits      idle for reasons io and output don't explain: locks, or the
+//             disk when the page cache is cold
+//  memory     busy and in user space, just slower per row: memory bandwidth
+//             and shared caches
+//
+// The input is read from the page cache after the first run; drop the caches
+// between runs for cold-disk numbers.
+
+// throws away what's printed, so printing costs only the formatting
+class CNullBuffer : public streambuf
+{
+protected:
+  virtual int overflow(int c)
+  {
+    return c == EOF ? 0 : c;
+  }
+
+  virtual streamsize xsputn(const char * /* s */, streamsize n)
+  {
+    return n;
+  }
+};
+
+// prints each workbook as it's reloaded, without the latency line on cerr
+class CQuietWatcher : public CScytlWatcher
+{
+public:
+  CQuietWatcher(ostream &Out) : CScytlWatcher(Out) {}
+
+protected:
+  virtual void Reloaded(const CScytlReader &reader, double /* changed */, double /* readSeconds */)
+  {
+    out << "File;" << reader.Filename() << endl;
+    reader.Print(out);
+  }
+};
+
+static double steadyNow()
+{
+  return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static double seconds(const timeval &tv)
+{
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+// wall and process times for one timed run
+class CSample
+{
+public:
+  CSample() : Wall(0), User(0), System(0), Faults(0), Switches(0) {}
+
+  double Wall;
+  double User;
+  double System;
+  long Faults;
+  long Switches;
+};
+
+class CScalingOptions
+{
+public:
+  CScalingOptions() : MaxThreads((int)thread::hardware_concurrency()), Runs(3), Directory(".")
+  {
+    if (MaxThreads < 1)
+      MaxThreads = 1;
+    Workbook.Contests = 10;
+  }
+
+  int MaxThreads;
+  int Runs;           // timed runs per point, the fastest counts
+  string Directory;
+  CGeneratorOptions Workbook;
+  string Mode;        // "" for both
+  string Scaling;     // "" for both
+};
+
+// one point: the threads and what they ran on
+class CPoint
+{
+public:
+  CPoint() : Threads(1), Bytes(0), IoSeconds(0), OutputSeconds(0) {}
+
+  int Threads;
+  vector<string> Files;
+  unsigned long long Bytes;
+  CSample Best;
+  double IoSeconds;
+  double OutputSeconds;
+};
+
+static void sample(CSample &s)
+{
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  s.Wall = steadyNow();
+  s.User = seconds(usage.ru_utime);
+  s.System = seconds(usage.ru_stime);
+  s.Faults = usage.ru_minflt;
+  s.Switches = usage.ru_nvcsw + usage.ru_nivcsw;
+}
+
+static CSample since(const CSample &start)
+{
+  CSample end;
+  sample(end);
+  end.Wall -= start.Wall;
+  end.User -= start.User;
+  end.System -= start.System;
+  end.Faults -= start.Faults;
+  end.Switches -= start.Switches;
+  return end;
+}
+
+static string workbookName(const CScalingOptions &options, const string &tag, int file)
+{
+  ostringstream name;
+  name << options.Directory << "/scaling-" << tag << "-" << file + 1 << ".xls";
+  return name.str();
+}
+
+static int generate(const string &filename, const CGeneratorOptions &workbook)
+{
+  if (CScytlGenerator(workbook).Write(filename)) {
+    cout << "Error: can't write <" << filename << ">" << endl;
+    return 1;
+  }
+  return 0;
+}
+
+static void removeWorkbooks(const vector<string> &files)
+{
+  for (vector<string>::const_iterator it = files.begin(); it != files.end(); ++it)
+  {
+    remove(it->c_str());
+    remove(IndexFilename(*it).c_str());
+  }
+}
+
+// how long reading the files into memory takes, one after the other
+static double readFiles(const vector<string> &files, unsigned long long &bytes)
+{
+  bytes = 0;
+  double start = steadyNow();
+  for (vector<string>::const_iterator it = files.begin(); it != files.end(); ++it)
+  {
+    ifstream in(it->c_str(), ios::in | ios::binary);
+    in.seekg(0, ios::end);
+    vector<char> buffer((size_t)in.tellg());
+    in.seekg(0, ios::beg);
+    in.read(buffer.empty() ? NULL : &buffer[0], buffer.size());
+    bytes += in.gcount();
+  }
+  return steadyNow() - start;
+}
+
+// one run of the single workbook path. 'print' times the output on its own
+// instead of being part of the run.
+static int runWorkbook(const CPoint &point, CSample &result, double *print)
+{
+  CNullBuffer null;
+  ostream out(&null);
+
+  CSample start;
+  sample(start);
+  CScytlReader reader(point.Files.front());
+  reader.SetThreads(point.Threads);
+  if (reader.Read()) {
+    cout << "Error reading from <" << point.Files.front() << ">" << endl;
+    return 1;
+  }
+  double printStart = steadyNow();
+  reader.Print(out);
+  result = since(start);
+  if (print)
+    *print = steadyNow() - printStart;
+  return 0;
+}
+
+static int runWorkbooks(const CPoint &point, CSample &result, double *print)
+{
+  CNullBuffer null;
+  ostream out(&null);
+
+  CSample start;
+  sample(start);
+  CQuietWatcher watcher(out);
+  watcher.SetThreads(point.Threads);
+  for (vector<string>::const_iterator it = point.Files.begin(); it != point.Files.end(); ++it)
+    if (watcher.Add(*it))
+      return 1;
+  if (watcher.Start())
+    return 1;
+  result = since(start);
+
+  if (print) {
+    double printStart = steadyNow();
+    for (size_t i = 0; i < watcher.Count(); ++i)
+      watcher.Reader(i).Print(out);
+    *print = steadyNow() - printStart;
+  }
+  return 0;
+}
+
+// one warm-up run that also times the serial parts, then the fastest of the
+// timed runs
+static int measure(const CScalingOptions &options, bool single, CPoint &point)
+{
+  point.IoSeconds = readFiles(point.Files, point.Bytes);
+
+  CSample warmup;
+  if (single ? runWorkbook(point, warmup, &point.OutputSeconds) : runWorkbooks(point, warmup, &point.OutputSeconds))
+    return 1;
+
+  for (int run = 0; run < options.Runs; ++run)
+  {
+    CSample s;
+    if (single ? runWorkbook(point, s, NULL) : runWorkbooks(point, s, NULL))
+      return 1;
+    if (run == 0 || s.Wall < point.Best.Wall)
+      point.Best = s;
+  }
+  return 0;
+}
+
+static const char *limit(const CPoint &point, const CPoint &first, bool single, double efficiency)
+{
+  if (efficiency >= 0.8 || point.Threads == 1)
+    return "-";
+  if (point.Threads > (int)thread::hardware_concurrency())
+    return "cores";
+
+  const CSample &s = point.Best;
+  double threadTime = s.Wall * point.Threads;
+  double cpu = s.User + s.System;
+  double lost = 1 - efficiency;
+
+  // while one thread reads or prints, the other t - 1 have nothing to do.
+  // the watcher reads its workbooks in parallel, so only the printing is
+  // serial there.
+  double io = single ? point.IoSeconds : 0;
+  double serial = (point.Threads - 1) * (io + point.OutputSeconds) / threadTime;
+  if (serial >= lost / 2)
+    return io > point.OutputSeconds ? "io" : "output";
+
+  if (cpu / threadTime < 0.8)
+    return "waits";
+
+  // more kernel time, or more page faults per byte of input, than one thread
+  // needed for the same work
+  double firstCpu = first.Best.User + first.Best.System;
+  double sysShare = cpu > 0 ? s.System / cpu : 0;
+  double firstSysShare = firstCpu > 0 ? first.Best.System / firstCpu : 0;
+  double faults = point.Bytes ? (double)s.Faults / point.Bytes : 0;
+  double firstFaults = first.Bytes ? (double)first.Best.Faults / first.Bytes : 0;
+  if (sysShare > firstSysShare + 0.1 || faults > firstFaults * 1.25)
+    return "allocator";
+
+  return "memory";
+}
+
+static void report(ostream &out, const char *mode, bool weak, const CPoint &point, const CPoint &first, bool single)
+{
+  const CSample &s = point.Best;
+
+  // weak scaling does t times the work, so keeping the time flat is a
+  // speedup of t
+  double speedup = s.Wall > 0 ? first.Best.Wall / s.Wall : 0;
+  if (weak)
+    speedup *= point.Threads;
+  double efficiency = speedup / point.Threads;
+  double cpu = s.User + s.System;
+
+  char line[512];
+  snprintf(line, sizeof(line), "%s;%s;%d;%.1f;%.1f;%.2f;%.0f%%;%.0f%%;%.0f%%;%ld;%ld;%.1f;%.1f;%s",
+           mode, weak ? "weak" : "strong", point.Threads, point.Bytes / 1048576.0,
+           s.Wall * 1000.0, speedup, efficiency * 100.0,
+           s.Wall > 0 ? 100.0 * cpu / (s.Wall * point.Threads) : 0.0,
+           cpu > 0 ? 100.0 * s.System / cpu : 0.0,
+           s.Faults, s.Switches, point.IoSeconds * 1000.0, point.OutputSeconds * 1000.0,
+           limit(point, first, single, efficiency));
+  out << line << endl;
+}
+
+// the workbooks for a point. strong scaling shares them between points.
+static int prepare(const CScalingOptions &options, bool single, bool weak, int threads, CPoint &point)
+{
+  point = CPoint();
+  point.Threads = threads;
+
+  int size = weak ? threads : options.MaxThreads;
+  ostringstream tag;
+  tag << (single ? "workbook" : "workbooks") << "-" << (weak ? "weak" : "strong") << "-" << size;
+
+  if (single) {
+    CGeneratorOptions workbook = options.Workbook;
+    workbook.Contests *= size;
+    point.Files.push_back(workbookName(options, tag.str(), 0));
+    return generate(point.Files.back(), workbook);
+  }
+
+  for (int i = 0; i < size; ++i)
+  {
+    CGeneratorOptions workbook = options.Workbook;
+    workbook.Seed += i;
+    point.Files.push_back(workbookName(options, tag.str(), i));
+    if (generate(point.Files.back(), workbook))
+      return 1;
+  }
+  return 0;
+}
+
+static int scale(const CScalingOptions &options, bool single, bool weak)
+{
+  const char *mode = single ? "workbook" : "workbooks";
+  CPoint first;
+  vector<string> strongFiles;
+  for (int threads = 1; threads <= options.MaxThreads; ++threads)
+  {
+    CPoint point;
+    bool reuse = !weak && threads > 1;
+    if (reuse) {
+      point.Threads = threads;
+      point.Files = strongFiles;
+    } else if (prepare(options, single, weak, threads, point)) {
+      removeWorkbooks(point.Files);
+      return 1;
+    }
+
+    int result = measure(options, single, point);
+    if (!weak)
+      strongFiles = point.Files;
+    else
+      removeWorkbooks(point.Files);
+    if (result) {
+      removeWorkbooks(strongFiles);
+      return 1;
+    }
+
+    if (threads == 1)
+      first = point;
+    report(cout, mode, weak, point, first, single);
+  }
+  removeWorkbooks(strongFiles);
+  return 0;
+}
+
+void usage(int /* argc */, char * const *argv)
+{
+  CScalingOptions defaults;
+  cout << argv[0] << " [options]" << endl
+       << endl
+       << "Read generated workbooks at 1..N threads and report how well the parallel" << endl
+       << "ingest scales, and what limits it." << endl
+       << endl
+       << "  --threads <n>       up to n threads, default " << defaults.MaxThreads << endl
+       << "  --mode <m>          workbook (one workbook, threads per worksheet) or workbooks" << endl
+       << "                      (threads per workbook, as with --watch), default both" << endl
+       << "  --scaling <s>       strong (fixed input) or weak (input grows with threads), default both" << endl
+       << "  --runs <n>          timed runs per point, default " << defaults.Runs << endl
+       << "  --dir <path>        where to write the workbooks, default " << defaults.Directory << endl
+       << "  --regions <n>       regions per worksheet, default " << defaults.Workbook.Regions << endl
+       << "  --contests <n>      contests per workbook and thread, default " << defaults.Workbook.Contests << endl
+       << "  --candidates <n>    candidates per contest, default " << defaults.Workbook.Candidates << endl
+       << "  --vote-types <n>    vote types per candidate, default " << defaults.Workbook.VoteTypes << endl
+       << "  --whitespace <ws>   pretty, compact, tabs or crlf, default pretty" << endl
+       << "  --seed <n>          seed for the first workbook, default " << defaults.Workbook.Seed << endl;
+}
+
+int main(int argc, char **argv)
+{
+  CScalingOptions options;
+
+  int narg = 1;
+  while (narg < argc)
+  {
+    string arg = argv[narg++];
+
+    if (arg == "--threads" && narg < argc) {
+      options.MaxThreads = atoi(argv[narg++]);
+      continue;
+    }
+    if (arg == "--mode" && narg < argc) {
+      options.Mode = argv[narg++];
+      continue;
+    }
+    if (arg == "--scaling" && narg < argc) {
+      options.Scaling = argv[narg++];
+      continue;
+    }
+    if (arg == "--runs" && narg < argc) {
+      options.Runs = atoi(argv[narg++]);
+      continue;
+    }
+    if (arg == "--dir" && narg < argc) {
+      options.Directory = argv[narg++];
+      continue;
+    }
+    if (arg == "--regions" && narg < argc) {
+      options.Workbook.Regions = atoi(argv[narg++]);
+      continue;
+    }
+    if (arg == "--contests" && narg < argc) {
+      options.Workbook.Contests = atoi(argv[narg++]);
+      continue;
+    }
+    if (arg == "--candidates" && narg < argc) {
+      options.Workbook.Candidates = atoi(argv[narg++]);
+      continue;
+    }
+    if (arg == "--vote-types" && narg < argc) {
+      options.Workbook.VoteTypes = atoi(argv[narg++]);
+      continue;
+    }
+    if (arg == "--whitespace" && narg < argc) {
+      if (ParseWhitespace(argv[narg++], options.Workbook.Whitespace)) {
+        usage(argc, argv);
+        exit(1);
+      }
+      continue;
+    }
+    if (arg == "--seed" && narg < argc) {
+      options.Workbook.Seed = strtoull(argv[narg++], NULL, 10);
+      continue;
+    }
+
+    usage(argc, argv);
+    exit(1);
+  }
+
+  if (options.MaxThreads < 1 || options.Runs < 1 ||
+      (options.Mode != "" && options.Mode != "workbook" && options.Mode != "workbooks") ||
+      (options.Scaling != "" && options.Scaling != "strong" && options.Scaling != "weak") ||
+      options.Workbook.Regions < 1 || options.Workbook.Contests < 1 ||
+      options.Workbook.Candidates < 1 || options.Workbook.VoteTypes < 1)
+  {
+    usage(argc, argv);
+    exit(1);
+  }
+
+  cout << "mode;scaling;threads;MB;ms;speedup;efficiency;busy %;sys %;minor faults;context switches;io ms;output ms;limit" << endl;
+  for (int single = 1; single >= 0; --single)
+  {
+    if (options.Mode != "" && options.Mode != (single ? "workbook" : "workbooks"))
+      continue;
+    for (int weak = 0; weak <= 1; ++weak)
+    {
+      if (options.Scaling != "" && options.Scaling != (weak ? "weak" : "strong"))
+        continue;
+      if (scale(options, single != 0, weak != 0))
+        return 1;
+    }
+  }
+
+  return 0;
+}
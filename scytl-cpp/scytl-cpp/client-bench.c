@@ -0,0 +1,180 @@
+/*
+  Compares round-trip latency of the binary socket protocol against the HTTP
+  server, for the same queries against the same workbook.
+
+    g++ -std=c++11 -O2 -pthread -o read-scytl-data read-scytl-data.cpp scytl-*.cpp tinyxml2.cpp
+    gcc -std=c99 -D_GNU_SOURCE -O2 -o client-bench client-bench.c scytl-client.c
+    ./read-scytl-data --serve 8080 --socket /tmp/scytl.sock detail.xls &
+    ./client-bench /tmp/scytl.sock 8080 [requests]
+
+  Both servers are answering from their response caches after the first
+  request, so this mostly measures framing, parsing and copying.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "scytl-client.h"
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int compare(const void *a, const void *b)
+{
+  double x = *(const double *)a, y = *(const double *)b;
+  return x < y ? -1 : x > y;
+}
+
+static void report(const char *name, double *samples, int n)
+{
+  qsort(samples, n, sizeof(double), compare);
+  printf("%-24s p50 %8.1f us   p99 %8.1f us   max %8.1f us\n", name,
+         samples[n / 2] * 1e6, samples[n * 99 / 100] * 1e6, samples[n - 1] * 1e6);
+}
+
+static int http_connect(int port)
+{
+  struct sockaddr_in addr;
+  int one = 1;
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+    close(fd);
+    return -1;
+  }
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  return fd;
+}
+
+/* one keep-alive GET. returns the body length, or -1. */
+static long http_get(int fd, const char *path, char **buffer, size_t *capacity)
+{
+  char request[512];
+  size_t used = 0;
+  long length = -1;
+  char *end = NULL;
+  int n = snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\nHost: localhost\r\n\r\n", path);
+  if (send(fd, request, n, MSG_NOSIGNAL) != n)
+    return -1;
+
+  for (;;) {
+    ssize_t got;
+    if (used == *capacity) {
+      *capacity = *capacity ? *capacity * 2 : 65536;
+      *buffer = (char *)realloc(*buffer, *capacity);
+    }
+    got = read(fd, *buffer + used, *capacity - used);
+    if (got < 0 && errno == EINTR)
+      continue;
+    if (got <= 0)
+      return -1;
+    used += got;
+
+    if (!end) {
+      char *field;
+      end = (char *)memmem(*buffer, used, "\r\n\r\n", 4);
+      if (!end)
+        continue;
+      field = (char *)memmem(*buffer, end - *buffer, "Content-Length: ", 16);
+      if (!field)
+        return -1;
+      length = strtol(field + 16, NULL, 10);
+    }
+    if (used >= (size_t)(end + 4 - *buffer) + length)
+      return length;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  const char *path;
+  int port, requests, i, fd;
+  scytl_client *client;
+  scytl_info info;
+  scytl_contest contest;
+  scytl_aggregates aggregates;
+  double *samples;
+  char *buffer = NULL;
+  size_t capacity = 0;
+  char url[64];
+
+  if (argc < 3) {
+    fprintf(stderr, "%s <socket path> <http port> [requests]\n", argv[0]);
+    return 1;
+  }
+  path = argv[1];
+  port = atoi(argv[2]);
+  requests = argc > 3 ? atoi(argv[3]) : 10000;
+  if (requests < 1)
+    requests = 1;
+  samples = (double *)malloc(requests * sizeof(double));
+
+  client = scytl_connect(path);
+  fd = http_connect(port);
+  if (!client || fd < 0) {
+    fprintf(stderr, "Error connecting to <%s> or port %d\n", path, port);
+    return 1;
+  }
+  if (scytl_get_info(client, &info) != SCYTL_STATUS_OK || info.contests == 0) {
+    fprintf(stderr, "Error: nothing loaded\n");
+    return 1;
+  }
+
+  /* one contest, cycling through all of them */
+  for (i = 0; i < requests; ++i) {
+    double start = now();
+    if (scytl_get_contest(client, i % info.contests, &contest) != SCYTL_STATUS_OK)
+      return 1;
+    samples[i] = now() - start;
+  }
+  report("socket contest", samples, requests);
+
+  for (i = 0; i < requests; ++i) {
+    double start = now();
+    snprintf(url, sizeof(url), "/contests/%u", i % info.contests);
+    if (http_get(fd, url, &buffer, &capacity) < 0)
+      return 1;
+    samples[i] = now() - start;
+  }
+  report("http contest (json)", samples, requests);
+
+  for (i = 0; i < requests; ++i) {
+    double start = now();
+    if (scytl_get_aggregates(client, &aggregates) != SCYTL_STATUS_OK)
+      return 1;
+    samples[i] = now() - start;
+  }
+  report("socket aggregates", samples, requests);
+
+  for (i = 0; i < requests; ++i) {
+    double start = now();
+    if (http_get(fd, "/aggregates", &buffer, &capacity) < 0)
+      return 1;
+    samples[i] = now() - start;
+  }
+  report("http aggregates (json)", samples, requests);
+
+  scytl_close(client);
+  close(fd);
+  free(buffer);
+  free(samples);
+  return 0;
+}
@@ -0,0 +1,89 @@
+#include <string>
+#include <iostream>
+#include <cstdlib>
+
+#include "scytl-generate.h"
+
+using namespace std;
+
+void usage(int /* argc */, char * const *argv)
+{
+  CGeneratorOptions defaults;
+  cout << argv[0] << " [options] <out>" << endl
+       << endl
+       << "Write a synthetic Scytl workbook to <out> (\"-\" for stdout). The same options" << endl
+       << "always give the same file." << endl
+       << endl
+       << "  --regions <n>       regions (rows) per worksheet, default " << defaults.Regions << endl
+       << "  --contests <n>      contest worksheets, default " << defaults.Contests << endl
+       << "  --candidates <n>    candidates per contest, default " << defaults.Candidates << endl
+       << "  --vote-types <n>    vote-type columns per candidate, default " << defaults.VoteTypes << endl
+       << "  --reporting <pct>   percent of the votes counted so far, default " << defaults.Reporting << endl
+       << "  --whitespace <ws>   pretty, compact, tabs or crlf, default pretty" << endl
+       << "  --seed <n>          default " << defaults.Seed << endl;
+}
+
+int main(int argc, char **argv)
+{
+  CGeneratorOptions options;
+  string outfile;
+
+  int narg = 1;
+  while (narg < argc)
+  {
+    string arg = argv[narg++];
+
+    if (arg == "--regions" && narg < argc) {
+      options.Regions = atoi(argv[narg++]);
+      continue;
+    }
+    if (arg == "--contests" && narg < argc) {
+      options.Contests = atoi(argv[narg++]);
+      continue;
+    }
+    if (arg == "--candidates" && narg < argc) {
+      options.Candidates = atoi(argv[narg++]);
+      continue;
+    }
+    if (arg == "--vote-types" && narg < argc) {
+      options.VoteTypes = atoi(argv[narg++]);
+      continue;
+    }
+    if (arg == "--reporting" && narg < argc) {
+      options.Reporting = atoi(argv[narg++]);
+      continue;
+    }
+    if (arg == "--whitespace" && narg < argc) {
+      if (ParseWhitespace(argv[narg++], options.Whitespace)) {
+        usage(argc, argv);
+        exit(1);
+      }
+      continue;
+    }
+    if (arg == "--seed" && narg < argc) {
+      options.Seed = strtoull(argv[narg++], NULL, 10);
+      continue;
+    }
+    if (outfile != "") {
+      usage(argc, argv);
+      exit(1);
+    }
+    outfile = arg;
+  }
+
+  if (outfile == "" || options.Regions < 1 || options.Contests < 1 ||
+      options.Candidates < 1 || options.VoteTypes < 1 ||
+      options.Reporting < 0 || options.Reporting > 100)
+  {
+    usage(argc, argv);
+    exit(1);
+  }
+
+  CScytlGenerator generator(options);
+  if (outfile == "-") {
+    generator.Write(cout);
+    cout.flush();
+    return cout ? 0 : 1;
+  }
+  return generator.Write(outfile);
+}
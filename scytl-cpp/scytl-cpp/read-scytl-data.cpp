@@ -2,666 +2,371 @@
 #include <list>
 #include <vector>
 #include <iostream>
-#include <sstream>
-#include <utility>
-
-#include "tinyxml2.h"
-
-class CDocumentProperties
-{
-public:
-  std::string Title;
-  std::string Author;
-  std::string Created;
-};
-
-class CRegionProfile
-{
-public:
-  std::string RegionName;
-  int RegisteredVoters;
-  int BallotsCast;
-  double VoterTurnout;
-};
-
-class CLabeledTuple
-{
-public:
-  std::string Label;
-  std::vector<int> Data;
-};
-
-class CElectionHeader
-{
-public:
-  std::string ColumnName;
-  std::string CandidateName;
-};
-
-class CElection
-{
-public:
-  std::string ElectionName;
-  std::vector<CElectionHeader> Header;
-  std::list<CLabeledTuple> Results;
-};
-
-class CScytlReader
-{
-public:
-  CScytlReader(const std::string &Filename);
-  ~CScytlReader();
-
-  int Read();
-
-protected:
-  typedef std::pair<int,std::string> TTocEntry;
-
-  int readDocumentProperties(const tinyxml2::XMLElement *dp, CDocumentProperties &documentProperties);
-  int readTableOfContentsWorksheet(const tinyxml2::XMLElement *ws, std::list<TTocEntry> &toc);
-  int readRegisteredVotersWorksheet(const tinyxml2::XMLElement *ws, std::list<CRegionProfile> &regionProfiles);
-  int readElectionResultsWorksheet(const tinyxml2::XMLElement *ws, CElection &election);
-
-private:
-  std::string filename;
-  tinyxml2::XMLDocument doc;
-
-  CDocumentProperties documentProperties;
-  std::list<TTocEntry> tableOfContents;
-  std::list<CRegionProfile> regionProfiles;
-  std::list<CElection> electionResults;
-};
+#include <cstdlib>
+#include <thread>
+
+#include "scytl-reader.h"
+#include "scytl-watch.h"
+#include "scytl-diff.h"
+#include "scytl-snapshot.h"
+#include "scytl-validate.h"
+#include "scytl-ingest.h"
+#include "scytl-server.h"
+#include "scytl-socket.h"
+#include "scytl-alloc.h"
+#include "scytl-perf.h"
+#include "scytl-trace.h"
 
 using namespace std;
-using namespace tinyxml2;
 
-CScytlReader::CScytlReader(const string &Filename)
-  : filename(Filename)
+void usage(int argc, char * const *argv)
 {
+  cout << argv[0] << " [--snapshot <out>] <filename>" << endl
+       << argv[0] << " --validate <filename>" << endl
+       << argv[0] << " --contest <page|name> <filename>" << endl
+       << argv[0] << " --watch [--delta] <filename> [<filename> ...]" << endl
+       << argv[0] << " --diff <old> <new>" << endl
+       << argv[0] << " [--serve <port>] [--socket <path>] [--lazy <mb>] <filename>" << endl
+       << endl
+       << "  --snapshot <out>  write a binary snapshot of the results instead of printing them" << endl
+       << "  --contest <c>     print one contest, by TOC page, name or start of a name" << endl
+       << "  --validate        list the rows whose Total Votes or Total columns don't add up" << endl
+       << "  --watch           reload and print results whenever a workbook is rewritten" << endl
+       << "  --delta           with --watch, print only what changed on each reload" << endl
+       << "  --diff            print what changed between two workbooks or snapshots" << endl
+       << "  --serve <port>    answer HTTP queries on localhost, reloading when the workbook changes" << endl
+       << "  --socket <path>   answer binary queries on a Unix domain socket (see scytl-protocol.h)" << endl
+       << "  --lazy <mb>       with --serve/--socket, extract contests only when they're asked for, keeping up to" << endl
+       << "                    <mb> of them in memory. only contests are served; no regions, aggregates or changes" << endl
+       << "  --threads <n>     extract worksheets on up to <n> threads (whole workbooks with --watch)" << endl
+       << "  --stats <format>  log timings, sizes and memory use of every read to stderr, as text or json" << endl
+       << "                    (and latency percentiles after every reload with --watch or --serve)" << endl
+       << "  --allocs          with --stats, count heap allocations per phase and worksheet as well" << endl
+       << "  --counters        with --stats, read hardware counters (instructions, IPC, cache and branch misses) too" << endl
+       << "  --trace <file>    write a Chrome trace-event timeline of the read (of each refresh with --watch or" << endl
+       << "                    --serve) to <file>, for chrome://tracing or ui.perfetto.dev" << endl
+       << "  --metrics <file>  with --watch or --serve/--socket, keep Prometheus metrics in <file>, rewritten" << endl
+       << "                    after every reload and every 10 seconds (--serve also answers GET /metrics)" << endl;
 }
 
-CScytlReader::~CScytlReader()
+// contests from either a workbook or a binary snapshot
+int readElections(const string &filename, int threads, const CReadStats::EFormat *statsFormat, list<CElection> &elections)
 {
-}
+  if (IsSnapshot(filename)) {
+    if (ReadSnapshot(filename, elections)) {
+      cout << "Error reading snapshot <" << filename << ">" << endl;
+      return 1;
+    }
+    return 0;
+  }
 
-int CScytlReader::readDocumentProperties(const XMLElement *dp, CDocumentProperties &documentProperties)
-{
-  if (!dp)
+  CScytlReader fin(filename);
+  fin.SetThreads(threads);
+  CReadStats stats;
+  if (statsFormat)
+    fin.SetStats(&stats);
+  if (fin.Read()) {
+    cout << "Error reading from <" << filename << ">" << endl;
     return 1;
-
-  const XMLElement *title = dp->FirstChildElement("o:Title");
-  if (!title) return 1;
-  documentProperties.Title = title->GetText();
-
-  const XMLElement *author = dp->FirstChildElement("o:Author");
-  if (!author) return 1;
-  documentProperties.Author = author->GetText();
-
-  const XMLElement *created = dp->FirstChildElement("o:Created");
-  if (!created) return 1;
-  documentProperties.Created = created->GetText();
-
+  }
+  if (statsFormat)
+    stats.Print(cerr, *statsFormat);
+  elections = fin.ElectionResults();
   return 0;
 }
 
-int CScytlReader::readTableOfContentsWorksheet(const XMLElement *ws, list<TTocEntry> &toc)
+// write the trace of a one-off run, if one was asked for, and pass 'result'
+// on. a trace that can't be written fails the run.
+int finishTrace(const string &traceFile, int result)
 {
-  const XMLElement *table = ws->FirstChildElement("s:Table");
-  if (!table)
+  if (traceFile != "" && WriteTrace(traceFile))
     return 1;
+  return result;
+}
 
-  const XMLElement *row;
-  for (row = table->FirstChildElement("s:Row"); row; row = row->NextSiblingElement())
-  {
-    // the Table of Contents entries we're interested in will have two cells on the same row,
-    // the first will be a Number and the second will be a String. anything else is not
-    // important to us and can be ignored.
+int main(int argc, char **argv)
+{
+  vector<string> infiles;
+  string snapshot;
+  bool watch = false;
+  bool delta = false;
+  bool diff = false;
+  bool validate = false;
+  string contest;
+  bool oneContest = false;
+  int port = 0;
+  string socketPath;
+  int threads = 1;
+  bool withStats = false;
+  CReadStats::EFormat statsFormat = CReadStats::Text;
+  bool allocs = false;
+  bool counters = false;
+  string traceFile;
+  string metricsFile;
+  int lazyMegabytes = 0;
 
-    // Example:
-    //
-    //  <s:Row>
-    //    <s:Cell s:StyleID="Page">
-    //      <s:Data s:Type="Number">1</s:Data>
-    //    </s:Cell>
-    //    <s:Cell>
-    //      <s:Data s:Type="String">Registered Voters</s:Data>
-    //    </s:Cell>
-    //  </s:Row>
+  int narg = 1;
+  while (narg < argc)
+  {
+    string arg = argv[narg++];
 
-    const XMLElement *cell1 = row->FirstChildElement("s:Cell");
-    const XMLElement *cell2 = cell1 ? cell1->NextSiblingElement() : NULL;
-    if (!cell1 || !cell2)
+    if (arg == "--watch") {
+      watch = true;
       continue;
-    {
-      const char *cellstyle = cell1->Attribute("s:StyleID");
-      if (!cellstyle || strcmp(cellstyle, "Page"))
-        continue;
     }
-
-    const XMLElement *data1 = cell1->FirstChildElement("s:Data");
-    const XMLElement *data2 = cell2->FirstChildElement("s:Data");
-    if (!data1 || !data2)
+    if (arg == "--delta") {
+      delta = true;
       continue;
-
-    if (strcmp(data1->Attribute("s:Type"), "Number") || 
-        strcmp(data2->Attribute("s:Type"), "String"))
+    }
+    if (arg == "--validate") {
+      validate = true;
       continue;
-
-    int page;
-    if (data1->QueryIntText(&page) != XML_SUCCESS)
+    }
+    if (arg == "--diff") {
+      diff = true;
       continue;
-
-    string contest = data2->GetText();
-
-    toc.push_back(TTocEntry(page, contest));
-  }
-
-  return 0;
-}
-
-int CScytlReader::readRegisteredVotersWorksheet(const XMLElement *ws, list<CRegionProfile> &regionProfiles)
-{
-  const XMLElement *table = ws->FirstChildElement("s:Table");
-  if (!table)
-    return 1;
-
-  // the first row contains our header
-
-  // Example:
-  //
-  //  <s:Row>
-  //    <s:Cell>
-  //      <s:Data s:Type="String">County</s:Data>
-  //    </s:Cell>
-  //    <s:Cell>
-  //      <s:Data s:Type="String">Registered Voters</s:Data>
-  //    </s:Cell>
-  //    <s:Cell>
-  //      <s:Data s:Type="String">Ballots Cast</s:Data>
-  //    </s:Cell>
-  //    <s:Cell>
-  //      <s:Data s:Type="String">Voter Turnout</s:Data>
-  //    </s:Cell>
-  //  </s:Row>
-
-  list<string> header;
-  const XMLElement *row = table->FirstChildElement("s:Row");
-  if (row)
-  {
-    for (const XMLElement *cell = row->FirstChildElement("s:Cell");
-         cell;
-         cell = cell->NextSiblingElement())
-    {
-      const XMLElement *data = cell->FirstChildElement("s:Data");
-      if (data)
-      {
-        const char *type = data->Attribute("s:Type");
-        if (!strcmp(type, "String"))
-          header.push_back(data->GetText());
+    }
+    if (arg == "--serve" && narg < argc) {
+      port = atoi(argv[narg++]);
+      if (port <= 0 || port > 65535) {
+        usage(argc, argv);
+        exit(1);
       }
+      continue;
     }
-    row = row->NextSiblingElement();
-  }
-
-  // now, read in voter data one row at a time. because this is the
-  // registered voters page, we know what columns we should expect.
-
-  // Example:
-  //
-  //  <s:Row>
-  //    <s:Cell>
-  //      <s:Data s:Type="String">Arkansas</s:Data>
-  //    </s:Cell>
-  //    <s:Cell s:StyleID="VoteCount">
-  //      <s:Data s:Type="Number">9095</s:Data>
-  //    </s:Cell>
-  //    <s:Cell s:StyleID="VoteCount">
-  //      <s:Data s:Type="Number">1898</s:Data>
-  //    </s:Cell>
-  //    <s:Cell s:StyleID="VoteCount">
-  //      <s:Data s:Type="String">20.87 %</s:Data>
-  //    </s:Cell>
-  //  </s:Row>
-
-  for (;
-       row;
-       row = row->NextSiblingElement())
-  {
-    CRegionProfile profile;
-
-    const XMLElement *cell = row->FirstChildElement("s:Cell");
-
-    // read the region name (aka county/precinct name)
-    if (cell)
-    {
-      const XMLElement *data = cell->FirstChildElement("s:Data");
-      const char *type = data ? data->Attribute("s:Type") : NULL;
-      if (type && !strcmp(type, "String"))
-        profile.RegionName = data->GetText();
-      cell = cell->NextSiblingElement();
+    if (arg == "--socket" && narg < argc) {
+      socketPath = argv[narg++];
+      continue;
     }
-
-    // Use header to determine remaining columns
-    list<string>::iterator itHeader = header.begin();
-    // ignore first header entry (County) because it may differ for precinct-level files
-    if (itHeader != header.end()) ++itHeader;
-
-    for (;
-         cell && itHeader != header.end();
-         cell = cell->NextSiblingElement(), ++itHeader)
-    {
-      const char *style = cell->Attribute("s:StyleID");
-      const XMLElement *data = cell->FirstChildElement("s:Data");
-      const char *type = data ? data->Attribute("s:Type") : NULL;
-
-      // we'll use the header name, the cell style, and the data type to verify file integrity
-      // and make sure we're reading from the correct column.
-      if (*itHeader == "Registered Voters"
-          && style && !strcmp(style, "VoteCount")
-          && type && !strcmp(type, "Number"))
-      {
-        if (data->QueryIntText(&profile.RegisteredVoters) != XML_SUCCESS)
-          return 1;
+    if (arg == "--lazy" && narg < argc) {
+      lazyMegabytes = atoi(argv[narg++]);
+      if (lazyMegabytes < 1) {
+        usage(argc, argv);
+        exit(1);
       }
-      else if (*itHeader == "Ballots Cast"
-               && style && !strcmp(style, "VoteCount")
-               && type && !strcmp(type, "Number"))
-      {
-        if (data->QueryIntText(&profile.BallotsCast) != XML_SUCCESS)
-          return 1;
-      }
-      else if (*itHeader == "Voter Turnout"
-               && style && !strcmp(style, "VoteCount")
-               && type && !strcmp(type, "String"))
-      {
-        string turnout_str = data->GetText();
-        // truncate to remove the appended percent sign
-        istringstream buf(turnout_str.substr(0, turnout_str.length()-2));
-
-        // convert to double, and make sure we read the WHOLE string
-        buf >> profile.VoterTurnout;
-        if (buf.fail()) return 1;
-        buf.peek();
-        if (!buf.eof()) return 1;
+      continue;
+    }
+    if (arg == "--threads" && narg < argc) {
+      threads = atoi(argv[narg++]);
+      if (threads < 1) {
+        usage(argc, argv);
+        exit(1);
       }
-      else
-      {
-        cout << "Error: unrecognized column name in Registered Voters worksheet (header says '" << *itHeader << "')" << endl;
-        return 1;
+      continue;
+    }
+    if (arg == "--stats" && narg < argc) {
+      if (ParseStatsFormat(argv[narg++], statsFormat)) {
+        usage(argc, argv);
+        exit(1);
       }
+      withStats = true;
+      continue;
+    }
+    if (arg == "--allocs") {
+      allocs = true;
+      continue;
+    }
+    if (arg == "--counters") {
+      counters = true;
+      continue;
+    }
+    if (arg == "--trace" && narg < argc) {
+      traceFile = argv[narg++];
+      continue;
+    }
+    if (arg == "--metrics" && narg < argc) {
+      metricsFile = argv[narg++];
+      continue;
+    }
+    if (arg == "--contest" && narg < argc) {
+      contest = argv[narg++];
+      oneContest = true;
+      continue;
+    }
+    if (arg == "--snapshot" && narg < argc) {
+      snapshot = argv[narg++];
+      continue;
     }
 
-    // make sure we have the same number of headers and columns
-    if (cell || itHeader != header.end())
-      return 1;
-
-    regionProfiles.push_back(profile);
+    infiles.push_back(arg);
   }
 
-  return 0;
-}
-
-int CScytlReader::readElectionResultsWorksheet(const XMLElement *ws, CElection &election)
-{
-  const XMLElement *table = ws->FirstChildElement("s:Table");
-  if (!table)
-    return 1;
-
-  // first row should contain our election name
-
-  // Example:
-  //
-  //  <s:Row>
-  //    <s:Cell s:MergeAcross="6" s:StyleID="headerLbl">
-  //      <s:Data s:Type="String">U.S. President - DEM</s:Data>
-  //    </s:Cell>
-  //  </s:Row>
-
-  const XMLElement *row = table->FirstChildElement("s:Row");
+  bool ok;
+  if (oneContest)
+    ok = infiles.size() == 1 && !validate && !watch && !diff && !delta && !port && socketPath == "" && snapshot == "";
+  else if (validate)
+    ok = infiles.size() == 1 && !watch && !diff && !delta && !port && socketPath == "" && snapshot == "";
+  else if (port || socketPath != "")
+    ok = infiles.size() == 1 && !watch && !diff && !delta && snapshot == "";
+  else if (watch)
+    ok = !infiles.empty() && !diff && snapshot == "";
+  else if (diff)
+    ok = infiles.size() == 2 && !delta && snapshot == "";
+  else
+    ok = infiles.size() == 1 && !delta;
+
+  if (metricsFile != "" && !watch && !port && socketPath == "")
+    ok = false;
+  if (lazyMegabytes && !port && socketPath == "")
+    ok = false;
+
+  if (!ok || ((allocs || counters) && !withStats))
   {
-    const XMLElement *cell = row ? row->FirstChildElement("s:Cell") : NULL;
-    const XMLElement *data = cell ? cell->FirstChildElement("s:Data") : NULL;
-    const char *style = cell ? cell->Attribute("s:StyleID") : NULL;
-    const char *type = data ? data->Attribute("s:Type") : NULL;
-    if (style && !strcmp(style, "headerLbl") &&
-        type && !strcmp(type, "String"))
-    {
-      election.ElectionName = data->GetText();
-
-      // use MergeAcross to determine how many columns there are
-      // so we can allocate the header's vector
-      int mergeacross = 0;
-      cell->QueryIntAttribute("s:MergeAcross", &mergeacross);
-      election.Header.resize(mergeacross + 1);
-
-      row = row->NextSiblingElement();
-    }
-    else return 1;
+    usage(argc, argv);
+    exit(1);
   }
+  SetAllocCounting(allocs);
 
-  // next row has candidate names. be careful about the "MergeAcross" attribute.
-
-  // Example:
-  //
-  //  <s:Row>
-  //    <s:Cell>
-  //      <s:Data s:Type="String"/>
-  //    </s:Cell>
-  //    <s:Cell>
-  //      <s:Data s:Type="String"/>
-  //    </s:Cell>
-  //    <s:Cell s:MergeAcross="1">
-  //      <s:Data s:Type="String">John Wolfe</s:Data>
-  //    </s:Cell>
-  //    <s:Cell s:MergeAcross="1">
-  //      <s:Data s:Type="String">Barack Obama</s:Data>
-  //    </s:Cell>
-  //    <s:Cell>
-  //      <s:Data s:Type="String"/>
-  //    </s:Cell>
-  //  </s:Row>
-
-  {
-    vector<CElectionHeader>::iterator itHeader = election.Header.begin();
-    const XMLElement *cell = row ? row->FirstChildElement("s:Cell") : NULL;
-    for (;
-         cell && itHeader != election.Header.end();
-         cell = cell->NextSiblingElement())
-    {
-      const XMLElement *data = cell ? cell->FirstChildElement("s:Data") : NULL;
-      int mergeacross = 0;
-      cell->QueryIntAttribute("s:MergeAcross", &mergeacross);
-
-      for (int i = 0;
-           i <= mergeacross && itHeader != election.Header.end();
-           ++i, ++itHeader)
-      {
-        if (data && data->GetText())
-          itHeader->CandidateName = data->GetText();
-      }
-    }
-
-    // make sure we used the right number of columns
-    if (cell || itHeader != election.Header.end())
-      return 1;
+  // the stats just leave the counters out if the kernel won't give us any
+  SetPerfCounting(counters);
+  if (counters && !ThreadPerfAvailable())
+    cerr << "Hardware counters aren't available here (see perf_event_paranoid), leaving them out" << endl;
 
-    row = row->NextSiblingElement();
+  if (traceFile != "") {
+    SetTracing(true);
+    SetTraceThreadName("main");
   }
 
-  // the next row has column names
-
-  // Example:
-  //
-  //  <s:Row>
-  //    <s:Cell>
-  //      <s:Data s:Type="String">County</s:Data>
-  //    </s:Cell>
-  //    <s:Cell>
-  //      <s:Data s:Type="String">Registered Voters</s:Data>
-  //    </s:Cell>
-  //    <s:Cell>
-  //      <s:Data s:Type="String">Election Day</s:Data>
-  //    </s:Cell>
-  //    <s:Cell>
-  //      <s:Data s:Type="String">Total Votes</s:Data>
-  //    </s:Cell>
-  //    <s:Cell>
-  //      <s:Data s:Type="String">Election Day</s:Data>
-  //    </s:Cell>
-  //    <s:Cell>
-  //      <s:Data s:Type="String">Total Votes</s:Data>
-  //    </s:Cell>
-  //    <s:Cell>
-  //      <s:Data s:Type="String">Total</s:Data>
-  //    </s:Cell>
-  //  </s:Row>
-
+  if (port || socketPath != "")
   {
-    vector<CElectionHeader>::iterator itHeader = election.Header.begin();
-    const XMLElement *cell = row ? row->FirstChildElement("s:Cell") : NULL;
-    for (;
-         cell && itHeader != election.Header.end();
-         cell = cell->NextSiblingElement(), ++itHeader)
-    {
-      const XMLElement *data = cell->FirstChildElement("s:Data");
-      const char *type = data ? data->Attribute("s:Type") : NULL;
+    CScytlIngest ingest(infiles.front());
+    ingest.SetThreads(threads);
+    if (withStats)
+      ingest.SetStats(statsFormat);
+    if (traceFile != "")
+      ingest.SetTrace(traceFile);
+    if (metricsFile != "")
+      ingest.SetMetricsFile(metricsFile);
+    if (lazyMegabytes)
+      ingest.SetLazy((size_t)lazyMegabytes * 1024 * 1024);
+    if (ingest.Start())
+      return 1;
 
-      if (type && !strcmp(type, "String") && data->GetText())
-        itHeader->ColumnName = data->GetText();
-      else
+    if (port == 0) {
+      CScytlSocketServer local(ingest, socketPath);
+      if (local.Start())
         return 1;
+      return local.Run();
     }
 
-    // make sure we used the right number of columns
-    if (cell || itHeader != election.Header.end())
+    CScytlServer server(ingest, port);
+    if (server.Start())
       return 1;
+    if (socketPath == "")
+      return server.Run();
 
-    row = row->NextSiblingElement();
+    // both: the socket server gets a loop of its own
+    CScytlSocketServer local(ingest, socketPath);
+    if (local.Start())
+      return 1;
+    thread localThread(&CScytlSocketServer::Run, &local);
+    int result = server.Run();
+    localThread.join();
+    return result;
   }
 
-  // the rest of the rows are voter data
-
-  // Example:
-  //
-  //  <s:Row>
-  //    <s:Cell>
-  //      <s:Data s:Type="String">Arkansas</s:Data>
-  //    </s:Cell>
-  //    <s:Cell s:StyleID="VoteCount">
-  //      <s:Data s:Type="Number">0</s:Data>
-  //    </s:Cell>
-  //    <s:Cell s:StyleID="VoteCount">
-  //      <s:Data s:Type="Number">508</s:Data>
-  //    </s:Cell>
-  //    <s:Cell s:StyleID="VoteCount">
-  //      <s:Data s:Type="Number">508</s:Data>
-  //    </s:Cell>
-  //    <s:Cell s:StyleID="VoteCount">
-  //      <s:Data s:Type="Number">599</s:Data>
-  //    </s:Cell>
-  //    <s:Cell s:StyleID="VoteCount">
-  //      <s:Data s:Type="Number">599</s:Data>
-  //    </s:Cell>
-  //    <s:Cell s:StyleID="VoteCount">
-  //      <s:Data s:Type="Number">1107</s:Data>
-  //    </s:Cell>
-  //  </s:Row>
-
-  for (;
-       row;
-       row = row->NextSiblingElement())
+  if (watch)
   {
-    CLabeledTuple tuple;
-
-    // the first cell is the label (a string)
-    const XMLElement *cell = row->FirstChildElement("s:Cell");
+    CScytlWatcher watcher(cout);
+    watcher.SetDeltas(delta);
+    watcher.SetThreads(threads);
+    if (withStats)
+      watcher.SetStats(statsFormat);
+    if (traceFile != "")
+      watcher.SetTrace(traceFile);
+    if (metricsFile != "")
+      watcher.SetMetricsFile(metricsFile);
+    for (vector<string>::const_iterator it = infiles.begin(); it != infiles.end(); ++it)
     {
-      const XMLElement *data = cell ? cell->FirstChildElement("s:Data") : NULL;
-      const char *type = data ? data->Attribute("s:Type") : NULL;
-      if (type && !strcmp(type, "String"))
-        tuple.Label = data->GetText();
-      else return 1;
-
-      cell = cell->NextSiblingElement();
-    }
-
-    // the remaining cells are vote counts (integers)
-    for (;
-         cell;
-         cell = cell->NextSiblingElement())
-    {
-      const XMLElement *data = cell ? cell->FirstChildElement("s:Data") : NULL;
-      const char *style = cell ? cell->Attribute("s:StyleID") : NULL;
-      const char *type = data ? data->Attribute("s:Type") : NULL;
-      if (style && !strcmp(style, "VoteCount") && type && !strcmp(type, "Number"))
-      {
-        int value;
-        if (data->QueryIntText(&value) != XML_SUCCESS)
-          return 1;
-        tuple.Data.push_back(value);
-      } else return 1;
+      if (watcher.Add(*it)) {
+        usage(argc, argv);
+        exit(1);
+      }
     }
 
-    // make sure our tuple has the right length
-    if (tuple.Data.size() + 1 != election.Header.size())
+    if (watcher.Start())
       return 1;
-
-    election.Results.push_back(tuple);
+    return watcher.Run();
   }
 
-  return 0;
-}
-
-int CScytlReader::Read()
-{
-  doc.LoadFile(filename.c_str());
-  if (doc.Error()) {
-    doc.PrintError();
-    cout << "Error loading <" << filename << ">" << endl;
-    return 1;
-  }
-
-  // locate root node
-  const XMLElement *root = doc.FirstChildElement("s:Workbook");
-  if (!root) {
-    cout << "Couldn't find root s:Workbook node" << endl;
-    return 1;
-  }
-
-  // read document properties
-  const XMLElement *dp = root->FirstChildElement("o:DocumentProperties");
-  if (readDocumentProperties(dp, documentProperties)) {
-    cout << "Error reading document properties" << endl;
-    return 1;
-  }
-
-  // build table of contents
-  const XMLElement *ws = root->FirstChildElement("s:Worksheet");
-  while (ws && strcmp(ws->Attribute("s:Name"), "Table of Contents"))
-    ws = ws->NextSiblingElement();
-
-  if (readTableOfContentsWorksheet(ws, tableOfContents)) {
-    cout << "Error reading table of contents" << endl;
-    return 1;
-  }
+  if (diff)
+  {
+    list<CElection> before, after;
+    const CReadStats::EFormat *format = withStats ? &statsFormat : NULL;
+    if (readElections(infiles[0], threads, format, before) || readElections(infiles[1], threads, format, after))
+      return 1;
 
-  // read registered voter info
-  while (ws && strcmp(ws->Attribute("s:Name"), "Registered Voters"))
-    ws = ws->NextSiblingElement();
-  if (readRegisteredVotersWorksheet(ws, regionProfiles)) {
-    cout << "Error reading registered voters worksheet" << endl;
-    return 1;
+    CTraceSpan output("output");
+    CElectionDelta changes;
+    DiffElections(before, after, changes);
+    PrintDelta(cout, changes);
+    output.End();
+    return finishTrace(traceFile, 0);
   }
 
-  // read election info
-  ws = ws->NextSiblingElement();
-  for (;
-       ws;
-       ws = ws->NextSiblingElement())
+  if (oneContest)
   {
+    CScytlReader fin(infiles.front());
     CElection election;
-    if (readElectionResultsWorksheet(ws, election)) {
-      cout << "Error reading election results worksheet" << endl;
+    if (fin.ReadContest(contest, election)) {
+      // list the candidates when the name didn't pick out just one
+      vector<pair<int,string> > matches;
+      if (fin.FindContests(contest, matches) == 0) {
+        for (vector<pair<int,string> >::const_iterator it = matches.begin(); it != matches.end(); ++it)
+          cout << it->first << ";" << it->second << endl;
+      }
       return 1;
     }
-    electionResults.push_back(election);
+    CTraceSpan output("output");
+    CScytlReader::PrintElection(cout, election);
+    output.End();
+    return finishTrace(traceFile, 0);
   }
 
-  // test document properties
-  cout << "Title;" << documentProperties.Title << endl
-       << "Author;" << documentProperties.Author << endl
-       << "Created;" << documentProperties.Created << endl;
-
-  // test table of contents
-  for (list<TTocEntry>::const_iterator tocIt = tableOfContents.begin();
-       tocIt != tableOfContents.end();
-       ++tocIt)
-  {
-    cout << tocIt->first << ";" << tocIt->second << endl;
-  }
-
-  // test registered voters
-  cout << "County;Registered Voters;Ballots Cast;Voter Turnout" << endl;
-  for (list<CRegionProfile>::const_iterator itRegion = regionProfiles.begin();
-       itRegion != regionProfiles.end();
-       ++itRegion)
+  CScytlReader fin(infiles.front());
+  fin.SetThreads(threads);
+  CReadStats stats;
+  if (withStats)
+    fin.SetStats(&stats);
+  if (fin.Read())
   {
-    cout << "  " << itRegion->RegionName << ";"
-                 << itRegion->RegisteredVoters << ";"
-                 << itRegion->BallotsCast << ";"
-                 << itRegion->VoterTurnout << endl;
+    cout << "Error reading from <" << infiles.front() << ">" << endl;
+    return 1;
   }
 
-  // test election results
-  for (list<CElection>::const_iterator itElection = electionResults.begin();
-       itElection != electionResults.end();
-       ++itElection)
-  {
-    cout << itElection->ElectionName << endl;
+  // the stats of a printing run include the printing
+  if (withStats && (validate || snapshot != ""))
+    stats.Print(cerr, statsFormat);
 
-    for (vector<CElectionHeader>::const_iterator itHeader = itElection->Header.begin();
-         itHeader != itElection->Header.end();
-         ++itHeader)
+  CTraceSpan output("output");
+  if (validate) {
+    int mismatches = 0;
+    const list<CElection> &elections = fin.ElectionResults();
+    for (list<CElection>::const_iterator it = elections.begin(); it != elections.end(); ++it)
     {
-      if (itHeader != itElection->Header.begin())
-        cout << ";";
-
-      if (itHeader->CandidateName != "")
-        cout << itHeader->CandidateName << " - ";
-      cout << itHeader->ColumnName;
+      PrintMismatches(cout, *it);
+      mismatches += (int)it->Mismatches.size();
     }
-    cout << endl;
-
-    for (list<CLabeledTuple>::const_iterator itTuple = itElection->Results.begin();
-         itTuple != itElection->Results.end();
-         ++itTuple)
-    {
-      cout << itTuple->Label << ";";
-      for (vector<int>::const_iterator itData = itTuple->Data.begin();
-           itData != itTuple->Data.end();
-           ++itData)
-      {
-        if (itData != itTuple->Data.begin())
-          cout << ";";
-        cout << *itData;
-      }
-      cout << endl;
-    }
-  }
-
-  return 0;
-}
-
-void usage(int argc, char * const *argv)
-{
-  cout << argv[0] << " <filename>" << endl;
-}
-
-int main(int argc, char **argv)
-{
-  string infile;
-
-  int narg = 1;
-  while (narg < argc)
-  {
-    // insert other arguments here
-
-    infile = argv[narg++];
-    break;
+    output.End();
+    return finishTrace(traceFile, mismatches ? 1 : 0);
   }
 
-  if (narg != argc || infile == "")
-  {
-    usage(argc, argv);
-    exit(1);
+  if (snapshot != "") {
+    if (WriteSnapshot(snapshot, fin.ElectionResults())) {
+      cout << "Error writing snapshot <" << snapshot << ">" << endl;
+      return 1;
+    }
+    output.End();
+    return finishTrace(traceFile, 0);
   }
 
-  CScytlReader fin(infile);
-  if (fin.Read())
-  {
-    cout << "Error reading from <" << infile << ">" << endl;
-    return 1;
+  CPhaseClock printing;
+  fin.Print(cout);
+  output.End();
+  if (withStats) {
+    stats.AddPhase("print", printing);
+    stats.Print(cerr, statsFormat);
   }
 
-  return 0;
+  return finishTrace(traceFile, 0);
 }
@@ -0,0 +1,103 @@
+#include <string>
+#include <list>
+#include <vector>
+#include <map>
+
+#include "scytl-aggregate.h"
+#include "scytl-simd.h"
+
+using namespace std;
+
+CColumnarContest::CColumnarContest(const CElection &election)
+  : Rows(0), Columns(election.Header.size() ? election.Header.size() - 1 : 0)
+{
+  for (list<CLabeledTuple>::const_iterator it = election.Results.begin(); it != election.Results.end(); ++it)
+  {
+    if (!IsTotalsLabel(it->Label))
+      Labels.push_back(it->Label);
+  }
+  Rows = Labels.size();
+
+  // a short row is padded out with zeros
+  Votes.assign(Rows * Columns, 0);
+  size_t row = 0;
+  for (list<CLabeledTuple>::const_iterator it = election.Results.begin(); it != election.Results.end(); ++it)
+  {
+    if (IsTotalsLabel(it->Label))
+      continue;
+    for (size_t c = 0; c < Columns && c < it->Data.size(); ++c)
+      Votes[c * Rows + row] = it->Data[c];
+    ++row;
+  }
+}
+
+void CandidateSpans(const vector<CElectionHeader> &header, vector<CCandidateSpan> &spans)
+{
+  spans.clear();
+
+  // the label column has no data
+  for (size_t i = 1; i < header.size(); ++i)
+  {
+    const string &candidate = header[i].CandidateName;
+    if (candidate == "")
+      continue;
+
+    if (spans.empty() || spans.back().Candidate != candidate || spans.back().End != i - 1) {
+      CCandidateSpan span;
+      span.Candidate = candidate;
+      span.First = i - 1;
+      span.End = i - 1;
+      span.TotalVotes = -1;
+      spans.push_back(span);
+    }
+
+    CCandidateSpan &span = spans.back();
+    if (header[i].ColumnName == "Total Votes")
+      span.TotalVotes = (int)(i - 1);
+    span.End = i;
+  }
+}
+
+void ColumnTotals(const CColumnarContest &contest, vector<long long> &totals)
+{
+  totals.resize(contest.Columns);
+  for (size_t c = 0; c < contest.Columns; ++c)
+    totals[c] = SumInt32(contest.Column(c), contest.Rows);
+}
+
+void AggregateContest(const CElection &election, const CColumnarContest &contest, CContestTotals &totals)
+{
+  ColumnTotals(contest, totals.Columns);
+
+  vector<CCandidateSpan> spans;
+  CandidateSpans(election.Header, spans);
+
+  totals.Candidates.clear();
+  totals.VoteTypes.clear();
+  map<string, size_t> voteTypes;
+  for (vector<CCandidateSpan>::const_iterator it = spans.begin(); it != spans.end(); ++it)
+  {
+    CGroupTotal candidate;
+    candidate.Name = it->Candidate;
+    candidate.Total = 0;
+
+    for (size_t c = it->First; c < it->End && c < totals.Columns.size(); ++c)
+    {
+      if ((int)c != it->TotalVotes)
+        candidate.Total += totals.Columns[c];
+
+      const string &name = election.Header[c + 1].ColumnName;
+      map<string, size_t>::const_iterator itType = voteTypes.find(name);
+      if (itType == voteTypes.end()) {
+        CGroupTotal type;
+        type.Name = name;
+        type.Total = 0;
+        itType = voteTypes.insert(make_pair(name, totals.VoteTypes.size())).first;
+        totals.VoteTypes.push_back(type);
+      }
+      totals.VoteTypes[itType->second].Total += totals.Columns[c];
+    }
+
+    totals.Candidates.push_back(candidate);
+  }
+}
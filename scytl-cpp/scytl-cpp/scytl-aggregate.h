@@ -0,0 +1,66 @@
+#ifndef SCYTL_AGGREGATE_INCLUDED
+#define SCYTL_AGGREGATE_INCLUDED
+
+#include <string>
+#include <vector>
+
+#include "scytl-reader.h"
+
+// One contest transposed into columns, so every column of votes is a single
+// contiguous array. The totals row is left out.
+class CColumnarContest
+{
+public:
+  CColumnarContest() : Rows(0), Columns(0) {}
+  CColumnarContest(const CElection &election);
+
+  size_t Rows;
+  size_t Columns;                     // same as CLabeledTuple::Data
+  std::vector<std::string> Labels;    // one per row
+  std::vector<int> Votes;             // Votes[column * Rows + row]
+
+  const int *Column(size_t column) const { return Rows ? &Votes[column * Rows] : NULL; }
+};
+
+// the columns one candidate's votes are spread over. indexes are into
+// CLabeledTuple::Data (one less than the CElectionHeader index).
+//
+// Example:
+//
+//  County;Registered Voters;Mitt Romney - Election Day;Mitt Romney - Total Votes;...;Total
+//
+//  Candidate = "Mitt Romney", First = 1, End = 3, TotalVotes = 2
+class CCandidateSpan
+{
+public:
+  std::string Candidate;
+  size_t First;
+  size_t End;
+  int TotalVotes;     // the candidate's "Total Votes" column, -1 if none
+};
+
+void CandidateSpans(const std::vector<CElectionHeader> &header, std::vector<CCandidateSpan> &spans);
+
+class CGroupTotal
+{
+public:
+  std::string Name;
+  long long Total;
+};
+
+// totals for one contest, over every region
+class CContestTotals
+{
+public:
+  std::vector<long long> Columns;         // per column
+  std::vector<CGroupTotal> Candidates;    // each candidate over their vote types ("Total Votes" left out)
+  std::vector<CGroupTotal> VoteTypes;     // each vote type over every candidate, in first seen order
+};
+
+// per-column totals over every region. statewide totals can overflow an int,
+// so they're added up in 64 bits.
+void ColumnTotals(const CColumnarContest &contest, std::vector<long long> &totals);
+
+void AggregateContest(const CElection &election, const CColumnarContest &contest, CContestTotals &totals);
+
+#endif // SCYTL_AGGREGATE_INCLUDED
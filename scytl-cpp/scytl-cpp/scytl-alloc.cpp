@@ -0,0 +1,130 @@
+#include <new>
+#include <atomic>
+#include <cstdlib>
+
+#include "scytl-alloc.h"
+
+using namespace std;
+
+static atomic<bool> counting(false);
+
+// plain counters, so they need no construction before the first allocation
+// on a thread
+static thread_local long long threadAllocs;
+static thread_local long long threadFrees;
+static thread_local long long threadBytes;
+
+void SetAllocCounting(bool Enabled)
+{
+  counting.store(Enabled);
+}
+
+bool AllocCounting()
+{
+  return counting.load();
+}
+
+CAllocCounts ThreadAllocCounts()
+{
+  CAllocCounts counts;
+  counts.Allocs = threadAllocs;
+  counts.Frees = threadFrees;
+  counts.Bytes = threadBytes;
+  return counts;
+}
+
+static void *allocate(size_t size)
+{
+  if (counting.load(memory_order_relaxed)) {
+    ++threadAllocs;
+    threadBytes += size;
+  }
+
+  // what the standard operator new does: keep asking the new handler for
+  // memory until there is some or there is no handler
+  for (;;)
+  {
+    void *p = malloc(size ? size : 1);
+    if (p)
+      return p;
+    new_handler handler = get_new_handler();
+    if (!handler)
+      return NULL;
+    handler();
+  }
+}
+
+static void release(void *p)
+{
+  if (!p)
+    return;
+  if (counting.load(memory_order_relaxed))
+    ++threadFrees;
+  free(p);
+}
+
+void *operator new(size_t size)
+{
+  void *p = allocate(size);
+  if (!p)
+    throw bad_alloc();
+  return p;
+}
+
+void *operator new[](size_t size)
+{
+  void *p = allocate(size);
+  if (!p)
+    throw bad_alloc();
+  return p;
+}
+
+void *operator new(size_t size, const nothrow_t &) throw()
+{
+  try {
+    return allocate(size);
+  } catch (...) {
+    return NULL;
+  }
+}
+
+void *operator new[](size_t size, const nothrow_t &) throw()
+{
+  try {
+    return allocate(size);
+  } catch (...) {
+    return NULL;
+  }
+}
+
+void operator delete(void *p) throw()
+{
+  release(p);
+}
+
+void operator delete[](void *p) throw()
+{
+  release(p);
+}
+
+// what C++14 compilers call when they know the size. it must go through
+// release() as well, or counted frees would miss every one of them.
+void operator delete(void *p, size_t) throw()
+{
+  operator delete(p);
+}
+
+void operator delete[](void *p, size_t) throw()
+{
+  operator delete[](p);
+}
+
+void operator delete(void *p, const nothrow_t &) throw()
+{
+  release(p);
+}
+
+void operator delete[](void *p, const nothrow_t &) throw()
+{
+  release(p);
+}
@@ -0,0 +1,50 @@
+#ifndef SCYTL_ALLOC_INCLUDED
+#define SCYTL_ALLOC_INCLUDED
+
+// Heap allocation accounting. Linking scytl-alloc.cpp replaces the global
+// operator new and delete with ones that count, per thread, how many
+// allocations and frees are made and how many bytes are asked for: every
+// std::string, vector growth, list node and stream buffer goes through them.
+// Counting is off until SetAllocCounting(true); until then the only cost is
+// one relaxed atomic load per allocation. malloc() called directly isn't seen.
+//
+// Example:
+//
+//  SetAllocCounting(true);
+//  CAllocCounts before = ThreadAllocCounts();
+//  reader.Read();
+//  CAllocCounts used = ThreadAllocCounts() - before;
+class CAllocCounts
+{
+public:
+  CAllocCounts() : Allocs(0), Frees(0), Bytes(0) {}
+
+  long long Allocs;
+  long long Frees;
+  long long Bytes;    // asked for by the allocations
+
+  CAllocCounts operator-(const CAllocCounts &other) const
+  {
+    CAllocCounts difference;
+    difference.Allocs = Allocs - other.Allocs;
+    difference.Frees = Frees - other.Frees;
+    difference.Bytes = Bytes - other.Bytes;
+    return difference;
+  }
+
+  CAllocCounts &operator+=(const CAllocCounts &other)
+  {
+    Allocs += other.Allocs;
+    Frees += other.Frees;
+    Bytes += other.Bytes;
+    return *this;
+  }
+};
+
+void SetAllocCounting(bool Enabled);
+bool AllocCounting();
+
+// everything the calling thread has counted so far
+CAllocCounts ThreadAllocCounts();
+
+#endif // SCYTL_ALLOC_INCLUDED
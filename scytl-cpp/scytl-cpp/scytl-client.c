@@ -0,0 +1,220 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "scytl-client.h"
+
+struct scytl_client
+{
+  int fd;
+  unsigned long long *buffer;   /* 8-byte aligned, so results can be used in place */
+  size_t capacity;              /* bytes */
+  size_t length;                /* bytes of the last response body */
+};
+
+scytl_client *scytl_connect(const char *path)
+{
+  struct sockaddr_un addr;
+  scytl_client *client;
+  int fd;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path))
+    return NULL;
+  strcpy(addr.sun_path, path);
+
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return NULL;
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+    close(fd);
+    return NULL;
+  }
+
+  client = (scytl_client *)calloc(1, sizeof(*client));
+  if (!client) {
+    close(fd);
+    return NULL;
+  }
+  client->fd = fd;
+  return client;
+}
+
+void scytl_close(scytl_client *client)
+{
+  if (!client)
+    return;
+  close(client->fd);
+  free(client->buffer);
+  free(client);
+}
+
+static int write_all(int fd, const char *data, size_t length)
+{
+  while (length) {
+    /* MSG_NOSIGNAL: a server that went away is an error, not SIGPIPE for
+       whichever process embeds us */
+    ssize_t n = send(fd, data, length, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return -1;
+    data += n;
+    length -= n;
+  }
+  return 0;
+}
+
+static int read_all(int fd, char *data, size_t length)
+{
+  while (length) {
+    ssize_t n = read(fd, data, length);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return -1;
+    data += n;
+    length -= n;
+  }
+  return 0;
+}
+
+/* send one request and read the response body into client->buffer. returns
+   the response status, or -1. */
+static int request(scytl_client *client, unsigned char opcode, const void *payload, size_t size,
+                   unsigned long long *version)
+{
+  char header[sizeof(unsigned int) + 1];
+  unsigned int length = (unsigned int)(size + 1);
+  unsigned int status;
+
+  if (size + 1 > SCYTL_MAX_REQUEST)
+    return SCYTL_STATUS_BAD_REQUEST;
+
+  memcpy(header, &length, sizeof(length));
+  header[sizeof(length)] = (char)opcode;
+  if (write_all(client->fd, header, sizeof(header)) || write_all(client->fd, (const char *)payload, size))
+    return -1;
+
+  if (read_all(client->fd, (char *)&length, sizeof(length)) || length < SCYTL_RESPONSE_HEADER)
+    return -1;
+  if (length > client->capacity) {
+    size_t capacity = client->capacity ? client->capacity : 4096;
+    unsigned long long *buffer;
+    while (capacity < length)
+      capacity *= 2;
+    buffer = (unsigned long long *)malloc(capacity);
+    if (!buffer)
+      return -1;
+    free(client->buffer);
+    client->buffer = buffer;
+    client->capacity = capacity;
+  }
+  if (read_all(client->fd, (char *)client->buffer, length))
+    return -1;
+  client->length = length;
+
+  memcpy(&status, client->buffer, sizeof(status));
+  *version = client->buffer[1];
+  return (int)status;
+}
+
+static const char *payload(const scytl_client *client)
+{
+  return (const char *)client->buffer + SCYTL_RESPONSE_HEADER;
+}
+
+int scytl_get_info(scytl_client *client, scytl_info *info)
+{
+  const unsigned int *p;
+  int status = request(client, SCYTL_OP_INFO, NULL, 0, &info->version);
+  if (status != SCYTL_STATUS_OK)
+    return status;
+  if (client->length < SCYTL_RESPONSE_HEADER + 2 * sizeof(unsigned int))
+    return -1;
+  p = (const unsigned int *)payload(client);
+  info->contests = p[0];
+  info->regions = p[1];
+  return status;
+}
+
+static int read_contest(scytl_client *client, int status, scytl_contest *contest)
+{
+  const unsigned int *p;
+  size_t votes;
+  if (status != SCYTL_STATUS_OK)
+    return status;
+  if (client->length < SCYTL_RESPONSE_HEADER + 4 * sizeof(unsigned int))
+    return -1;
+
+  p = (const unsigned int *)payload(client);
+  contest->id = p[0];
+  contest->rows = p[1];
+  contest->columns = p[2];
+  contest->label_bytes = p[3];
+  votes = (size_t)contest->rows * contest->columns * sizeof(int);
+  if (client->length != SCYTL_RESPONSE_HEADER + 4 * sizeof(unsigned int) + votes + contest->label_bytes)
+    return -1;
+  contest->votes = (const int *)(p + 4);
+  contest->labels = (const char *)(p + 4) + votes;
+  return status;
+}
+
+int scytl_get_contest(scytl_client *client, unsigned int id, scytl_contest *contest)
+{
+  return read_contest(client, request(client, SCYTL_OP_CONTEST_BY_ID, &id, sizeof(id), &contest->version), contest);
+}
+
+int scytl_get_contest_by_name(scytl_client *client, const char *name, scytl_contest *contest)
+{
+  return read_contest(client, request(client, SCYTL_OP_CONTEST_BY_NAME, name, strlen(name), &contest->version), contest);
+}
+
+int scytl_get_region(scytl_client *client, const char *name, scytl_region *region)
+{
+  const unsigned int *p;
+  int status = request(client, SCYTL_OP_REGION, name, strlen(name), &region->version);
+  if (status != SCYTL_STATUS_OK)
+    return status;
+  if (client->length < SCYTL_RESPONSE_HEADER + 2 * sizeof(unsigned int))
+    return -1;
+
+  p = (const unsigned int *)payload(client);
+  region->count = p[0];
+  if (client->length < SCYTL_RESPONSE_HEADER + (2 + 2 * (size_t)region->count + 1) * sizeof(unsigned int))
+    return -1;
+  region->contests = p + 2;
+  region->offsets = region->contests + region->count;
+  region->votes = (const int *)(region->offsets + region->count + 1);
+  if ((const char *)(region->votes + region->offsets[region->count]) > payload(client) - SCYTL_RESPONSE_HEADER + client->length)
+    return -1;
+  return status;
+}
+
+int scytl_get_aggregates(scytl_client *client, scytl_aggregates *aggregates)
+{
+  const unsigned int *p;
+  size_t offset;
+  int status = request(client, SCYTL_OP_AGGREGATES, NULL, 0, &aggregates->version);
+  if (status != SCYTL_STATUS_OK)
+    return status;
+  if (client->length < SCYTL_RESPONSE_HEADER + 2 * sizeof(unsigned int))
+    return -1;
+
+  p = (const unsigned int *)payload(client);
+  aggregates->count = p[0];
+  aggregates->offsets = p + 2;
+  offset = SCYTL_RESPONSE_HEADER + (2 + (size_t)aggregates->count + 1) * sizeof(unsigned int);
+  if (client->length < offset)
+    return -1;
+  offset = (offset + 7) & ~(size_t)7;
+  aggregates->totals = (const long long *)((const char *)client->buffer + offset);
+  if (offset + aggregates->offsets[aggregates->count] * sizeof(long long) > client->length)
+    return -1;
+  return status;
+}
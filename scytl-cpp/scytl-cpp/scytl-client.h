@@ -0,0 +1,78 @@
+#ifndef SCYTL_CLIENT_INCLUDED
+#define SCYTL_CLIENT_INCLUDED
+
+#include <stddef.h>
+
+#include "scytl-protocol.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+  Client for the binary query protocol served by read-scytl-data --socket.
+
+  Results point straight into the connection's receive buffer, so they are
+  only good until the next request on the same connection. Functions return
+  a SCYTL_STATUS_* value, or -1 if the connection failed.
+
+  Example:
+
+    scytl_client *client = scytl_connect("/tmp/scytl.sock");
+    scytl_contest contest;
+    if (client && scytl_get_contest(client, 0, &contest) == SCYTL_STATUS_OK)
+      printf("%d\n", contest.votes[0]);   // first region, first column
+    scytl_close(client);
+*/
+
+typedef struct scytl_client scytl_client;
+
+typedef struct
+{
+  unsigned long long version;
+  unsigned int contests;
+  unsigned int regions;
+} scytl_info;
+
+typedef struct
+{
+  unsigned long long version;
+  unsigned int id;
+  unsigned int rows;
+  unsigned int columns;
+  const int *votes;           /* votes[column * rows + row] */
+  const char *labels;         /* rows NUL terminated strings */
+  size_t label_bytes;
+} scytl_contest;
+
+typedef struct
+{
+  unsigned long long version;
+  unsigned int count;
+  const unsigned int *contests;
+  const unsigned int *offsets;
+  const int *votes;           /* contests[i]'s row is votes[offsets[i]] .. votes[offsets[i+1]] */
+} scytl_region;
+
+typedef struct
+{
+  unsigned long long version;
+  unsigned int count;
+  const unsigned int *offsets;
+  const long long *totals;    /* contest i's totals are totals[offsets[i]] .. totals[offsets[i+1]] */
+} scytl_aggregates;
+
+scytl_client *scytl_connect(const char *path);
+void scytl_close(scytl_client *client);
+
+int scytl_get_info(scytl_client *client, scytl_info *info);
+int scytl_get_contest(scytl_client *client, unsigned int id, scytl_contest *contest);
+int scytl_get_contest_by_name(scytl_client *client, const char *name, scytl_contest *contest);
+int scytl_get_region(scytl_client *client, const char *name, scytl_region *region);
+int scytl_get_aggregates(scytl_client *client, scytl_aggregates *aggregates);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SCYTL_CLIENT_INCLUDED */
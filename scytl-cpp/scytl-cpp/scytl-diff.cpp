@@ -0,0 +1,223 @@
+#include <string>
+#include <list>
+#include <vector>
+#include <map>
+#include <iostream>
+
+#include "scytl-diff.h"
+#include "scytl-simd.h"
+
+using namespace std;
+
+static bool sameHeader(const vector<CElectionHeader> &a, const vector<CElectionHeader> &b)
+{
+  if (a.size() != b.size())
+    return false;
+  for (size_t i = 0; i < a.size(); ++i)
+  {
+    if (a[i].ColumnName != b[i].ColumnName || a[i].CandidateName != b[i].CandidateName)
+      return false;
+  }
+  return true;
+}
+
+static void addContest(const CElection &election, CContestDelta &delta)
+{
+  delta.Added = true;
+  delta.Header = election.Header;
+  delta.AddedRegions = election.Results;
+}
+
+static void diffRow(const CLabeledTuple &before, const CLabeledTuple &after, CContestDelta &delta)
+{
+  // the headers match, so the rows should be the same length. if they aren't,
+  // send the region again rather than guessing which columns moved.
+  size_t n = after.Data.size();
+  if (before.Data.size() != n) {
+    delta.RemovedRegions.push_back(before.Label);
+    delta.AddedRegions.push_back(after);
+    return;
+  }
+  if (!n)
+    return;
+
+  const int *a = &before.Data[0];
+  const int *b = &after.Data[0];
+  for (size_t i = FirstDifference(a, b, n); i < n; i = FirstDifference(a, b, n, i + 1))
+  {
+    CCellChange change;
+    change.Region = after.Label;
+    change.Column = (int)i + 1;   // Data doesn't include the label column
+    change.OldValue = a[i];
+    change.NewValue = b[i];
+    delta.Changed.push_back(change);
+  }
+}
+
+static bool diffContest(const CElection &before, const CElection &after, CContestDelta &delta)
+{
+  delta.ElectionName = after.ElectionName;
+
+  if (!sameHeader(before.Header, after.Header)) {
+    addContest(after, delta);
+    return true;
+  }
+
+  // regions almost always come in the same order, so walk both lists together
+  // and only fall back to matching by name once they disagree
+  list<CLabeledTuple>::const_iterator itBefore = before.Results.begin();
+  list<CLabeledTuple>::const_iterator itAfter = after.Results.begin();
+  for (;
+       itBefore != before.Results.end() && itAfter != after.Results.end() &&
+       itBefore->Label == itAfter->Label;
+       ++itBefore, ++itAfter)
+  {
+    diffRow(*itBefore, *itAfter, delta);
+  }
+
+  if (itBefore != before.Results.end() || itAfter != after.Results.end())
+  {
+    map<string, const CLabeledTuple *> remaining;
+    for (; itBefore != before.Results.end(); ++itBefore)
+      remaining[itBefore->Label] = &*itBefore;
+
+    for (; itAfter != after.Results.end(); ++itAfter)
+    {
+      map<string, const CLabeledTuple *>::iterator it = remaining.find(itAfter->Label);
+      if (it == remaining.end()) {
+        delta.AddedRegions.push_back(*itAfter);
+      } else {
+        diffRow(*it->second, *itAfter, delta);
+        remaining.erase(it);
+      }
+    }
+
+    for (map<string, const CLabeledTuple *>::const_iterator it = remaining.begin();
+         it != remaining.end();
+         ++it)
+    {
+      delta.RemovedRegions.push_back(it->first);
+    }
+  }
+
+  return !delta.Changed.empty() || !delta.AddedRegions.empty() || !delta.RemovedRegions.empty();
+}
+
+void DiffElections(const vector<const CElection *> &before,
+                   const vector<const CElection *> &after,
+                   CElectionDelta &delta)
+{
+  map<string, const CElection *> remaining;
+  for (vector<const CElection *>::const_iterator it = before.begin(); it != before.end(); ++it)
+    remaining[(*it)->ElectionName] = *it;
+
+  for (vector<const CElection *>::const_iterator itAfter = after.begin(); itAfter != after.end(); ++itAfter)
+  {
+    CContestDelta contest;
+    map<string, const CElection *>::iterator it = remaining.find((*itAfter)->ElectionName);
+    if (it == remaining.end()) {
+      contest.ElectionName = (*itAfter)->ElectionName;
+      addContest(**itAfter, contest);
+    } else if (it->second == *itAfter) {
+      // the same contest, shared between two models
+      remaining.erase(it);
+      continue;
+    } else {
+      bool changed = diffContest(*it->second, **itAfter, contest);
+      remaining.erase(it);
+      if (!changed)
+        continue;
+    }
+    delta.Contests.push_back(contest);
+  }
+
+  for (map<string, const CElection *>::const_iterator it = remaining.begin(); it != remaining.end(); ++it)
+  {
+    CContestDelta contest;
+    contest.ElectionName = it->first;
+    contest.Removed = true;
+    delta.Contests.push_back(contest);
+  }
+}
+
+void DiffElections(const list<CElection> &before,
+                   const list<CElection> &after,
+                   CElectionDelta &delta)
+{
+  vector<const CElection *> b, a;
+  for (list<CElection>::const_iterator it = before.begin(); it != before.end(); ++it)
+    b.push_back(&*it);
+  for (list<CElection>::const_iterator it = after.begin(); it != after.end(); ++it)
+    a.push_back(&*it);
+  DiffElections(b, a, delta);
+}
+
+void DiffLastRead(const CScytlReader &reader, CElectionDelta &delta)
+{
+  // contests that Read() reused are unchanged by definition, so only the ones
+  // it extracted again have to be compared against what they replaced
+  vector<const CElection *> before;
+  for (list<CElection>::const_iterator it = reader.ReplacedResults().begin();
+       it != reader.ReplacedResults().end();
+       ++it)
+  {
+    before.push_back(&*it);
+  }
+  DiffElections(before, reader.ChangedResults(), delta);
+}
+
+void PrintDelta(ostream &out, const CElectionDelta &delta)
+{
+  // Example:
+  //
+  //  Contest;U.S. President - DEM;changed
+  //  Cell;Arkansas;2;508;512
+  //  Region;Benton;removed
+  //  Region;Desha;0;17;17;4;4;21
+  //  Contest;State Senate District 1 - REP;added
+  //  County;Registered Voters;...
+  //  Arkansas;0;212;...
+
+  for (vector<CContestDelta>::const_iterator it = delta.Contests.begin();
+       it != delta.Contests.end();
+       ++it)
+  {
+    out << "Contest;" << it->ElectionName << ";"
+        << (it->Removed ? "removed" : it->Added ? "added" : "changed") << endl;
+
+    if (it->Added)
+    {
+      CScytlReader::PrintHeader(out, it->Header);
+      for (list<CLabeledTuple>::const_iterator itTuple = it->AddedRegions.begin();
+           itTuple != it->AddedRegions.end();
+           ++itTuple)
+      {
+        CScytlReader::PrintTuple(out, *itTuple);
+      }
+      continue;
+    }
+
+    for (vector<CCellChange>::const_iterator itCell = it->Changed.begin();
+         itCell != it->Changed.end();
+         ++itCell)
+    {
+      out << "Cell;" << itCell->Region << ";" << itCell->Column << ";"
+          << itCell->OldValue << ";" << itCell->NewValue << endl;
+    }
+
+    for (vector<string>::const_iterator itRegion = it->RemovedRegions.begin();
+         itRegion != it->RemovedRegions.end();
+         ++itRegion)
+    {
+      out << "Region;" << *itRegion << ";removed" << endl;
+    }
+
+    for (list<CLabeledTuple>::const_iterator itTuple = it->AddedRegions.begin();
+         itTuple != it->AddedRegions.end();
+         ++itTuple)
+    {
+      out << "Region;";
+      CScytlReader::PrintTuple(out, *itTuple);
+    }
+  }
+}
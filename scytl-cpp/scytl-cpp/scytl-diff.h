@@ -0,0 +1,62 @@
+#ifndef SCYTL_DIFF_INCLUDED
+#define SCYTL_DIFF_INCLUDED
+
+#include <string>
+#include <list>
+#include <vector>
+#include <iostream>
+
+#include "scytl-reader.h"
+
+// one vote count that moved between two loads
+class CCellChange
+{
+public:
+  std::string Region;
+  int Column;           // index into CElection::Header
+  int OldValue;
+  int NewValue;
+};
+
+// everything that changed in one contest. a contest that is new, or whose
+// columns changed, is sent in full (Added) instead of cell by cell.
+class CContestDelta
+{
+public:
+  CContestDelta() : Added(false), Removed(false) {}
+
+  std::string ElectionName;
+  bool Added;
+  bool Removed;
+
+  std::vector<CElectionHeader> Header;     // only when Added
+  std::list<CLabeledTuple> AddedRegions;   // every row when Added
+  std::vector<std::string> RemovedRegions;
+  std::vector<CCellChange> Changed;
+};
+
+class CElectionDelta
+{
+public:
+  std::vector<CContestDelta> Contests;
+
+  bool Empty() const { return Contests.empty(); }
+};
+
+// compare two sets of contests. contests are matched by name and regions by
+// label; contests that are identical don't show up in the delta at all.
+void DiffElections(const std::vector<const CElection *> &before,
+                   const std::vector<const CElection *> &after,
+                   CElectionDelta &delta);
+void DiffElections(const std::list<CElection> &before,
+                   const std::list<CElection> &after,
+                   CElectionDelta &delta);
+
+// what changed in the last CScytlReader::Read(). only the contests that were
+// actually re-extracted need to be compared.
+void DiffLastRead(const CScytlReader &reader, CElectionDelta &delta);
+
+// semicolon separated, in the same spirit as CScytlReader::Print()
+void PrintDelta(std::ostream &out, const CElectionDelta &delta);
+
+#endif // SCYTL_DIFF_INCLUDED
@@ -0,0 +1,291 @@
+#include <string>
+#include <map>
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#endif
+
+#include "scytl-epoll.h"
+
+using namespace std;
+
+CEpollServer::CEpollServer(size_t MaxInput, size_t MaxOutput)
+  : maxInput(MaxInput), maxOutput(MaxOutput), listenFd(-1), epollFd(-1)
+{
+}
+
+CEpollServer::~CEpollServer()
+{
+#ifdef __linux__
+  for (map<int, CConnection>::iterator it = connections.begin(); it != connections.end(); ++it)
+    ::close(it->first);
+  if (listenFd >= 0)
+    ::close(listenFd);
+  if (epollFd >= 0)
+    ::close(epollFd);
+#endif
+}
+
+int CEpollServer::listenOn(int fd)
+{
+#ifdef __linux__
+  listenFd = fd;
+
+  epollFd = epoll_create1(EPOLL_CLOEXEC);
+  if (epollFd < 0) {
+    cout << "Error creating epoll instance: " << strerror(errno) << endl;
+    return 1;
+  }
+
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.fd = listenFd;
+  if (epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev)) {
+    cout << "Error adding listening socket to epoll: " << strerror(errno) << endl;
+    return 1;
+  }
+
+  return 0;
+#else
+  cout << "Server modes require epoll, which isn't available on this platform" << endl;
+  return 1;
+#endif
+}
+
+int CEpollServer::Run()
+{
+#ifdef __linux__
+  struct epoll_event events[256];
+  for (;;)
+  {
+    int n = epoll_wait(epollFd, events, sizeof(events) / sizeof(events[0]), -1);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      cout << "Error waiting for events: " << strerror(errno) << endl;
+      return 1;
+    }
+
+    for (int i = 0; i < n; ++i)
+    {
+      int fd = events[i].data.fd;
+      if (fd == listenFd) {
+        accept();
+        continue;
+      }
+
+      map<int, CConnection>::iterator it = connections.find(fd);
+      if (it == connections.end()) {
+        ready(fd);
+        continue;
+      }
+      CConnection &connection = it->second;
+
+      if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+        close(connection);
+        continue;
+      }
+      if ((events[i].events & EPOLLIN) && receive(connection)) {
+        close(connection);
+        continue;
+      }
+      if (send(connection)) {
+        close(connection);
+        continue;
+      }
+
+      // requests held back while the output was full. if the peer takes the
+      // answers as fast as we make them there's no EPOLLOUT to come back on,
+      // so keep going until the socket fills or nothing more can be answered
+      bool failed = false;
+      while (!connection.In.empty() && !outputFull(connection))
+      {
+        size_t pending = connection.In.size();
+        process(connection);
+        if (send(connection)) {
+          failed = true;
+          break;
+        }
+        if (!connection.Out.empty() || connection.In.size() == pending)
+          break;
+      }
+      if (failed) {
+        close(connection);
+        continue;
+      }
+      if (connection.Out.empty())
+        drained(connection);
+      update(connection);
+    }
+  }
+#else
+  return 1;
+#endif
+}
+
+int CEpollServer::watch(int fd)
+{
+#ifdef __linux__
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.fd = fd;
+  if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev)) {
+    cout << "Error adding descriptor to epoll: " << strerror(errno) << endl;
+    return 1;
+  }
+  return 0;
+#else
+  return 1;
+#endif
+}
+
+CEpollServer::CConnection *CEpollServer::find(int fd)
+{
+  map<int, CConnection>::iterator it = connections.find(fd);
+  return it == connections.end() ? NULL : &it->second;
+}
+
+void CEpollServer::push(CConnection &connection)
+{
+  // the loop writes it as soon as the socket is writable
+  update(connection);
+}
+
+int CEpollServer::accept()
+{
+#ifdef __linux__
+  for (;;)
+  {
+    int fd = accept4(listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0)
+      return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : 1;
+
+    accepted(fd);
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev)) {
+      ::close(fd);
+      continue;
+    }
+
+    connections[fd].Fd = fd;
+  }
+#else
+  return 1;
+#endif
+}
+
+int CEpollServer::receive(CConnection &connection)
+{
+#ifdef __linux__
+  char buf[16384];
+  bool eof = false;
+  for (;;)
+  {
+    // the rest waits in the socket until the peer reads some of its answers
+    if (outputFull(connection))
+      break;
+
+    ssize_t len = read(connection.Fd, buf, sizeof(buf));
+    if (len > 0) {
+      connection.In.append(buf, len);
+
+      // let process() make room first: a client pipelining lots of small
+      // requests is fine, one whose requests don't fit isn't
+      if (connection.In.size() > maxInput) {
+        process(connection);
+        if (connection.In.size() > maxInput && !outputFull(connection))
+          return 1;
+      }
+      continue;
+    }
+    if (len == 0) {
+      eof = true;
+      break;
+    }
+    if (errno == EINTR)
+      continue;
+    if (errno == EAGAIN || errno == EWOULDBLOCK)
+      break;
+    return 1;
+  }
+
+  // a client that shuts down its end after sending a request still gets an
+  // answer, so handle whatever complete requests we have before closing
+  process(connection);
+  if (eof)
+    connection.Close = true;
+  return 0;
+#else
+  return 1;
+#endif
+}
+
+int CEpollServer::send(CConnection &connection)
+{
+#ifdef __linux__
+  while (connection.Sent < connection.Out.size())
+  {
+    // MSG_NOSIGNAL: a client that hangs up on us must not take the whole
+    // process down with SIGPIPE; we get EPIPE and close it instead
+    ssize_t len = ::send(connection.Fd, connection.Out.data() + connection.Sent,
+                         connection.Out.size() - connection.Sent, MSG_NOSIGNAL);
+    if (len < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        // process() appends to what's left, so drop what's been written
+        // before it piles up in front
+        if (connection.Sent >= connection.Out.size() / 2) {
+          connection.Out.erase(0, connection.Sent);
+          connection.Sent = 0;
+        }
+        return 0;
+      }
+      return 1;
+    }
+    connection.Sent += len;
+  }
+
+  connection.Out.clear();
+  connection.Sent = 0;
+  return connection.Close ? 1 : 0;
+#else
+  return 1;
+#endif
+}
+
+void CEpollServer::update(CConnection &connection)
+{
+#ifdef __linux__
+  // only ask for EPOLLOUT while there's something waiting to be written, and
+  // for EPOLLIN while there's room for more answers
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = (outputFull(connection) ? 0u : (unsigned int)EPOLLIN) |
+              (connection.Out.empty() ? 0u : (unsigned int)EPOLLOUT);
+  ev.data.fd = connection.Fd;
+  epoll_ctl(epollFd, EPOLL_CTL_MOD, connection.Fd, &ev);
+#endif
+}
+
+void CEpollServer::close(CConnection &connection)
+{
+#ifdef __linux__
+  int fd = connection.Fd;
+  closed(fd);
+  epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, NULL);
+  ::close(fd);
+  connections.erase(fd);
+#endif
+}
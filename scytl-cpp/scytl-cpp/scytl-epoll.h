@@ -0,0 +1,83 @@
+#ifndef SCYTL_EPOLL_INCLUDED
+#define SCYTL_EPOLL_INCLUDED
+
+#include <string>
+#include <map>
+
+// Non-blocking accept/read/write loop shared by the server modes. Subclasses
+// create and bind the listening socket, hand it to listenOn(), and implement
+// process() to turn whatever has arrived on a connection into output.
+//
+// A connection never holds more than 'MaxInput' bytes that process() has left
+// unconsumed; one that sends more than that is closed, so subclasses don't
+// each have to guard against a peer that never stops sending. Once more than
+// 'MaxOutput' bytes are waiting to be written to a connection, nothing more
+// is read from it until the peer has taken some, so a client that sends
+// requests but never reads the answers only gets as far as its socket
+// buffers let it.
+class CEpollServer
+{
+public:
+  CEpollServer(size_t MaxInput = 1024 * 1024, size_t MaxOutput = 4 * 1024 * 1024);
+  virtual ~CEpollServer();
+
+  // serve until something goes badly wrong
+  int Run();
+
+protected:
+  class CConnection
+  {
+  public:
+    CConnection() : Fd(-1), Sent(0), Close(false) {}
+
+    int Fd;
+    std::string In;       // received, not yet processed
+    std::string Out;      // waiting to be written
+    size_t Sent;          // how much of Out has been written
+    bool Close;           // close once Out has been written
+  };
+
+  // take ownership of a bound, listening, non-blocking socket
+  int listenOn(int fd);
+
+  // consume complete requests from connection.In and append the answers to
+  // connection.Out. stop early once outputFull(); process() is called again
+  // for the rest when the peer has read enough.
+  virtual void process(CConnection &connection) = 0;
+
+  bool outputFull(const CConnection &connection) const
+  { return connection.Out.size() - connection.Sent >= maxOutput; }
+
+  // called for every new connection before it is added to the loop
+  virtual void accepted(int /* fd */) {}
+
+  // called once everything queued on a connection has been written, and
+  // just before a connection is closed
+  virtual void drained(CConnection & /* connection */) {}
+  virtual void closed(int /* fd */) {}
+
+  // wake up the loop when 'fd' becomes readable, and call ready() for it
+  int watch(int fd);
+  virtual void ready(int /* fd */) {}
+
+  // the connection for 'fd', NULL if it has gone away
+  CConnection *find(int fd);
+
+  // send whatever has been added to connection.Out outside of process()
+  void push(CConnection &connection);
+
+private:
+  int accept();
+  int receive(CConnection &connection);
+  int send(CConnection &connection);
+  void close(CConnection &connection);
+  void update(CConnection &connection);
+
+  size_t maxInput;
+  size_t maxOutput;
+  int listenFd;
+  int epollFd;
+  std::map<int, CConnection> connections;
+};
+
+#endif // SCYTL_EPOLL_INCLUDED
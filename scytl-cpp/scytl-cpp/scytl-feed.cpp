@@ -0,0 +1,94 @@
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/eventfd.h>
+#endif
+
+#include "scytl-feed.h"
+
+using namespace std;
+
+CChangeFeed::CChangeFeed(size_t History)
+  : history(History ? History : 1), fd(-1)
+{
+#ifdef __linux__
+  fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
+}
+
+CChangeFeed::~CChangeFeed()
+{
+#ifdef __linux__
+  if (fd >= 0)
+    close(fd);
+#endif
+}
+
+void CChangeFeed::Append(unsigned long long version, const vector<shared_ptr<const CElection> > &elections)
+{
+  {
+    lock_guard<mutex> guard(lock);
+    versions.push_back(make_pair(version, elections));
+    if (versions.size() > history)
+      versions.pop_front();
+  }
+
+#ifdef __linux__
+  unsigned long long one = 1;
+  if (write(fd, &one, sizeof(one)) < 0) {
+    // the counter can't realistically overflow, and a wakeup that's already
+    // pending is as good as another one
+  }
+#endif
+}
+
+void CChangeFeed::Acknowledge()
+{
+#ifdef __linux__
+  unsigned long long count;
+  if (read(fd, &count, sizeof(count)) < 0) {
+    // nothing pending
+  }
+#endif
+}
+
+unsigned long long CChangeFeed::Latest()
+{
+  lock_guard<mutex> guard(lock);
+  return versions.empty() ? 0 : versions.back().first;
+}
+
+int CChangeFeed::Since(unsigned long long since, CElectionDelta &delta, unsigned long long &latest)
+{
+  // take references to both versions and diff outside the lock, so the
+  // ingest thread is never held up by a slow diff
+  TElections before, after;
+  {
+    lock_guard<mutex> guard(lock);
+    if (versions.empty())
+      return 1;
+    latest = versions.back().first;
+    if (since == latest)
+      return 0;
+
+    deque<pair<unsigned long long, TElections> >::const_iterator it = versions.begin();
+    while (it != versions.end() && it->first != since)
+      ++it;
+    if (it == versions.end())
+      return 1;
+    before = it->second;
+    after = versions.back().second;
+  }
+
+  vector<const CElection *> a, b;
+  for (size_t i = 0; i < before.size(); ++i)
+    a.push_back(before[i].get());
+  for (size_t i = 0; i < after.size(); ++i)
+    b.push_back(after[i].get());
+  DiffElections(a, b, delta);
+  return 0;
+}
@@ -0,0 +1,53 @@
+#ifndef SCYTL_FEED_INCLUDED
+#define SCYTL_FEED_INCLUDED
+
+#include <vector>
+#include <deque>
+#include <utility>
+#include <memory>
+#include <mutex>
+
+#include "scytl-reader.h"
+#include "scytl-diff.h"
+
+// Remembers the contests of the last few published models, so subscribers can
+// be told what changed since whichever version they saw last. A subscriber
+// that falls behind by several reloads gets one delta covering all of them,
+// and one that falls further behind than the history goes has to resync.
+//
+// Append() is called from the ingest thread and never waits on subscribers.
+// Since() diffs on the caller's thread.
+class CChangeFeed
+{
+public:
+  CChangeFeed(size_t History = 64);
+  ~CChangeFeed();
+
+  // record the contests as of 'version'
+  void Append(unsigned long long version, const std::vector<std::shared_ptr<const CElection> > &elections);
+
+  // readable after every Append(), until Acknowledge() is called
+  int Fd() const { return fd; }
+  void Acknowledge();
+
+  // the most recent version appended, 0 if none
+  unsigned long long Latest();
+
+  // what changed between 'since' and the latest version. returns 1 when
+  // 'since' is no longer in the history (the subscriber has to resync).
+  int Since(unsigned long long since, CElectionDelta &delta, unsigned long long &latest);
+
+private:
+  CChangeFeed(const CChangeFeed &);     // not supported
+  void operator=(const CChangeFeed &);  // not supported
+
+  typedef std::vector<std::shared_ptr<const CElection> > TElections;
+
+  size_t history;
+  int fd;
+
+  std::mutex lock;
+  std::deque<std::pair<unsigned long long, TElections> > versions;
+};
+
+#endif // SCYTL_FEED_INCLUDED
@@ -0,0 +1,426 @@
+#include <string>
+#include <vector>
+#include <ostream>
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+
+#include "scytl-generate.h"
+
+using namespace std;
+
+static const char *offices[] = {
+  "U.S. Congress District",
+  "State Senate District",
+  "State Representative District",
+  "Circuit Judge District",
+  "Justice of the Peace District",
+  "School Board Zone",
+};
+
+static const char *parties[] = { "DEM", "REP", "NP" };
+
+static const char *firstNames[] = {
+  "John", "Mary", "James", "Linda", "Robert", "Susan", "David", "Karen",
+  "Thomas", "Nancy", "Charles", "Betty", "Daniel", "Helen", "Mark", "Sandra",
+};
+
+static const char *lastNames[] = {
+  "Wolfe", "Obama", "Romney", "Paul", "Santorum", "Gingrich", "Ross", "Cotton",
+  "Jeffress", "Hays", "Womack", "Griffin", "Crawford", "Pryor", "Boozman", "Beebe",
+  "Hutchinson", "Lincoln", "Bumpers", "Clinton", "Fulbright", "Mills", "Faubus", "Rockefeller",
+  "Bethune", "Huckabee", "Tucker", "White", "Hammerschmidt", "Purcell", "Cherry", "Laney",
+};
+
+static const char *voteTypes[] = {
+  "Election Day", "Absentee", "Early Voting", "Provisional", "Mail", "Overseas",
+};
+
+#define COUNT(a) (sizeof(a) / sizeof((a)[0]))
+
+int ParseWhitespace(const string &name, CGeneratorOptions::EWhitespace &whitespace)
+{
+  if (name == "pretty")
+    whitespace = CGeneratorOptions::Pretty;
+  else if (name == "compact")
+    whitespace = CGeneratorOptions::Compact;
+  else if (name == "tabs")
+    whitespace = CGeneratorOptions::Tabs;
+  else if (name == "crlf")
+    whitespace = CGeneratorOptions::Crlf;
+  else
+    return 1;
+  return 0;
+}
+
+static string format(const char *fmt, long long value)
+{
+  char text[64];
+  snprintf(text, sizeof(text), fmt, value);
+  return text;
+}
+
+CScytlGenerator::CScytlGenerator(const CGeneratorOptions &Options)
+  : options(Options), state(Options.Seed), out(NULL)
+{
+  // zero padded, so the names sort the way they're numbered
+  int width = (int)format("%lld", options.Regions).size();
+  for (int i = 0; i < options.Regions; ++i)
+  {
+    char name[64];
+    snprintf(name, sizeof(name), "Precinct %0*d", width, i + 1);
+    regions.push_back(name);
+
+    // between 200 and 5000 voters, a fifth to four fifths of whom turned out
+    int voters = 200 + (int)below(4801);
+    registered.push_back(voters);
+    ballots.push_back((int)((long long)voters * (20 + below(61)) / 100));
+  }
+
+  for (int i = 0; i < options.Contests; ++i)
+  {
+    string name = offices[i % COUNT(offices)];
+    name += format(" %lld - ", i / COUNT(offices) + 1);
+    name += parties[below(COUNT(parties))];
+    contests.push_back(name);
+  }
+}
+
+unsigned long long CScytlGenerator::next()
+{
+  // splitmix64: tiny, and the same everywhere, unlike <random>'s distributions
+  unsigned long long z = (state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+unsigned int CScytlGenerator::below(unsigned int n)
+{
+  return n ? (unsigned int)(next() % n) : 0;
+}
+
+void CScytlGenerator::flush()
+{
+  out->write(buffer.data(), buffer.size());
+  buffer.clear();
+}
+
+void CScytlGenerator::line(int depth, const char *text)
+{
+  switch (options.Whitespace)
+  {
+  case CGeneratorOptions::Pretty:
+  case CGeneratorOptions::Crlf:
+    buffer.append(2 * depth, ' ');
+    break;
+  case CGeneratorOptions::Tabs:
+    buffer.append(depth, '\t');
+    break;
+  case CGeneratorOptions::Compact:
+    break;
+  }
+
+  buffer += text;
+
+  switch (options.Whitespace)
+  {
+  case CGeneratorOptions::Pretty:
+  case CGeneratorOptions::Tabs:
+    buffer += '\n';
+    break;
+  case CGeneratorOptions::Crlf:
+    buffer += "\r\n";
+    break;
+  case CGeneratorOptions::Compact:
+    break;
+  }
+
+  if (buffer.size() >= 1 << 20)
+    flush();
+}
+
+void CScytlGenerator::line(int depth, const string &text)
+{
+  line(depth, text.c_str());
+}
+
+void CScytlGenerator::cell(int depth, const char *style, const char *type, const string &text)
+{
+  if (style)
+    line(depth, string("<s:Cell s:StyleID=\"") + style + "\">");
+  else
+    line(depth, "<s:Cell>");
+  if (text == "")
+    line(depth + 1, string("<s:Data s:Type=\"") + type + "\" />");
+  else
+    line(depth + 1, string("<s:Data s:Type=\"") + type + "\">" + text + "</s:Data>");
+  line(depth, "</s:Cell>");
+}
+
+void CScytlGenerator::numberCell(int depth, long long value)
+{
+  cell(depth, "VoteCount", "Number", format("%lld", value));
+}
+
+void CScytlGenerator::Write(ostream &Out)
+{
+  out = &Out;
+  buffer.clear();
+
+  writeHeader();
+  writeTableOfContents();
+  writeRegisteredVoters();
+  for (int i = 0; i < options.Contests; ++i)
+    writeContest(i);
+  line(0, "</s:Workbook>");
+
+  flush();
+  out = NULL;
+}
+
+int CScytlGenerator::Write(const string &Filename)
+{
+  ofstream fout(Filename.c_str(), ios::out | ios::binary | ios::trunc);
+  if (!fout) {
+    cout << "Error: can't create <" << Filename << ">" << endl;
+    return 1;
+  }
+  Write(fout);
+  fout.close();
+  if (!fout) {
+    cout << "Error writing <" << Filename << ">" << endl;
+    return 1;
+  }
+  return 0;
+}
+
+void CScytlGenerator::writeHeader()
+{
+  buffer += "\xEF\xBB\xBF";
+  line(0, "<?xml version='1.0'?>");
+  line(0, "<?mso-application progid='Excel.Sheet'?>");
+  line(0, "<s:Workbook xmlns:x=\"urn:schemas-microsoft-com:office:excel\" "
+          "xmlns:o=\"urn:schemas-microsoft-com:office:office\" "
+          "xmlns:s=\"urn:schemas-microsoft-com:office:spreadsheet\">");
+  line(1, "<o:DocumentProperties>");
+  line(2, "<o:Title>Election Results</o:Title>");
+  line(2, "<o:Author>SOE Software Inc.</o:Author>");
+  line(2, "<o:Created>2012-06-01T17:55:54</o:Created>");
+  line(1, "</o:DocumentProperties>");
+  line(1, "<x:ExcelWorkbook>");
+  line(2, "<x:WindowHeight>7000</x:WindowHeight>");
+  line(2, "<x:WindowTopX>100</x:WindowTopX>");
+  line(2, "<x:WindowTopY>200</x:WindowTopY>");
+  line(2, "<x:WindowWidth>8000</x:WindowWidth>");
+  line(2, "<x:ActiveSheet>0</x:ActiveSheet>");
+  line(2, "<x:ProtectStructure>False</x:ProtectStructure>");
+  line(2, "<x:ProtectWindows>False</x:ProtectWindows>");
+  line(1, "</x:ExcelWorkbook>");
+  line(1, "<s:Styles>");
+  line(2, "<s:Style s:ID=\"VoteCount\">");
+  line(3, "<s:Alignment s:Horizontal=\"Right\" />");
+  line(2, "</s:Style>");
+  line(2, "<s:Style s:ID=\"Page\">");
+  line(3, "<s:Alignment s:Horizontal=\"Left\" />");
+  line(2, "</s:Style>");
+  line(2, "<s:Style s:ID=\"headerLbl\">");
+  line(3, "<s:Alignment s:Horizontal=\"Center\" />");
+  line(3, "<s:Font s:Color=\"White\" />");
+  line(3, "<s:Interior s:Color=\"Blue\" s:Pattern=\"Solid\" />");
+  line(2, "</s:Style>");
+  line(1, "</s:Styles>");
+}
+
+void CScytlGenerator::writeTableOfContents()
+{
+  line(1, "<s:Worksheet s:Name=\"Table of Contents\">");
+  line(2, "<s:Table>");
+
+  line(3, "<s:Row>");
+  line(4, "<s:Cell s:MergeAcross=\"1\">");
+  line(5, "<s:Data s:Type=\"String\" />");
+  line(4, "</s:Cell>");
+  line(3, "</s:Row>");
+  line(3, "<s:Row />");
+  line(3, "<s:Row>");
+  line(4, "<s:Cell s:MergeAcross=\"1\">");
+  line(5, "<s:Data s:Type=\"String\">Table of Contents</s:Data>");
+  line(4, "</s:Cell>");
+  line(3, "</s:Row>");
+  line(3, "<s:Row>");
+  cell(4, NULL, "String", "Page");
+  cell(4, NULL, "String", "Contest");
+  line(3, "</s:Row>");
+
+  line(3, "<s:Row>");
+  cell(4, "Page", "Number", "1");
+  cell(4, NULL, "String", "Registered Voters");
+  line(3, "</s:Row>");
+  for (int i = 0; i < options.Contests; ++i)
+  {
+    line(3, "<s:Row>");
+    cell(4, "Page", "Number", format("%lld", i + 2));
+    cell(4, NULL, "String", contests[i]);
+    line(3, "</s:Row>");
+  }
+
+  line(2, "</s:Table>");
+  line(1, "</s:Worksheet>");
+}
+
+// "20.87 %"
+static string turnout(long long ballots, long long registered)
+{
+  long long hundredths = registered ? (ballots * 10000 + registered / 2) / registered : 0;
+  char text[64];
+  snprintf(text, sizeof(text), "%lld.%02lld %%", hundredths / 100, hundredths % 100);
+  return text;
+}
+
+void CScytlGenerator::writeRegisteredVoters()
+{
+  line(1, "<s:Worksheet s:Name=\"Registered Voters\">");
+  line(2, "<s:Table>");
+
+  line(3, "<s:Row>");
+  cell(4, NULL, "String", "County");
+  cell(4, NULL, "String", "Registered Voters");
+  cell(4, NULL, "String", "Ballots Cast");
+  cell(4, NULL, "String", "Voter Turnout");
+  line(3, "</s:Row>");
+
+  long long totalRegistered = 0, totalBallots = 0;
+  for (int i = 0; i < options.Regions; ++i)
+  {
+    line(3, "<s:Row>");
+    cell(4, NULL, "String", regions[i]);
+    numberCell(4, registered[i]);
+    numberCell(4, ballots[i]);
+    cell(4, "VoteCount", "String", turnout(ballots[i], registered[i]));
+    line(3, "</s:Row>");
+    totalRegistered += registered[i];
+    totalBallots += ballots[i];
+  }
+
+  line(3, "<s:Row>");
+  cell(4, NULL, "String", "Total:");
+  numberCell(4, totalRegistered);
+  numberCell(4, totalBallots);
+  cell(4, "VoteCount", "String", turnout(totalBallots, totalRegistered));
+  line(3, "</s:Row>");
+
+  line(2, "</s:Table>");
+  line(1, "</s:Worksheet>");
+}
+
+void CScytlGenerator::writeContest(int contest)
+{
+  int candidates = options.Candidates;
+  int types = options.VoteTypes;
+  int columns = 2 + candidates * (types + 1) + 1;
+
+  // Example (two candidates, one vote type):
+  //
+  //  | U.S. President - DEM                                                  |
+  //  |        |                   | John Wolfe             | Barack Obama           |       |
+  //  | County | Registered Voters | Election Day | Total Votes | Election Day | Total Votes | Total |
+
+  line(1, format("<s:Worksheet s:Name=\"%lld\">", contest + 2));
+  line(2, "<s:Table>");
+
+  line(3, "<s:Row>");
+  line(4, format("<s:Cell s:MergeAcross=\"%lld\" s:StyleID=\"headerLbl\">", columns - 1));
+  line(5, "<s:Data s:Type=\"String\">" + contests[contest] + "</s:Data>");
+  line(4, "</s:Cell>");
+  line(3, "</s:Row>");
+
+  // distinct names while there are enough to go around, and some candidates
+  // more popular than others
+  vector<int> weights;
+  int weightSum = 0;
+  unsigned int first = below(COUNT(firstNames));
+  unsigned int last = below(COUNT(lastNames));
+  line(3, "<s:Row>");
+  cell(4, NULL, "String", "");
+  cell(4, NULL, "String", "");
+  for (int c = 0; c < candidates; ++c)
+  {
+    string name = firstNames[(first + c) % COUNT(firstNames)];
+    name += " ";
+    name += lastNames[(last + c) % COUNT(lastNames)];
+    if (c >= (int)COUNT(lastNames))
+      name += format(" %lld", c / COUNT(lastNames) + 1);
+
+    line(4, format("<s:Cell s:MergeAcross=\"%lld\">", types));
+    line(5, "<s:Data s:Type=\"String\">" + name + "</s:Data>");
+    line(4, "</s:Cell>");
+
+    weights.push_back(1 + (int)below(4));
+    weightSum += weights.back();
+  }
+  cell(4, NULL, "String", "");
+  line(3, "</s:Row>");
+
+  line(3, "<s:Row>");
+  cell(4, NULL, "String", "County");
+  cell(4, NULL, "String", "Registered Voters");
+  for (int c = 0; c < candidates; ++c)
+  {
+    for (int t = 0; t < types; ++t)
+    {
+      if (t < (int)COUNT(voteTypes))
+        cell(4, NULL, "String", voteTypes[t]);
+      else
+        cell(4, NULL, "String", format("Vote Type %lld", t + 1));
+    }
+    cell(4, NULL, "String", "Total Votes");
+  }
+  cell(4, NULL, "String", "Total");
+  line(3, "</s:Row>");
+
+  // Registered Voters is always 0 on the contest pages
+  vector<long long> totals(columns - 1, 0);
+  vector<int> votes(columns - 1, 0);
+  for (int i = 0; i < options.Regions; ++i)
+  {
+    int column = 1;
+    int total = 0;
+    for (int c = 0; c < candidates; ++c)
+    {
+      // a candidate's share of the ballots, split over the vote types. never
+      // more than the ballots between them.
+      int share = (int)((long long)ballots[i] * weights[c] / weightSum / types);
+      int candidateTotal = 0;
+      for (int t = 0; t < types; ++t)
+      {
+        // always draw the final count, so the sequence doesn't depend on
+        // how much has been counted
+        long long counted = (long long)below(share + 1) * options.Reporting / 100;
+        votes[column++] = (int)counted;
+        candidateTotal += votes[column - 1];
+      }
+      votes[column++] = candidateTotal;
+      total += candidateTotal;
+    }
+    votes[column] = total;
+
+    line(3, "<s:Row>");
+    cell(4, NULL, "String", regions[i]);
+    for (int v = 0; v < columns - 1; ++v)
+    {
+      numberCell(4, votes[v]);
+      totals[v] += votes[v];
+    }
+    line(3, "</s:Row>");
+  }
+
+  line(3, "<s:Row>");
+  cell(4, NULL, "String", "Totals:");
+  for (int v = 0; v < columns - 1; ++v)
+    numberCell(4, totals[v]);
+  line(3, "</s:Row>");
+
+  line(2, "</s:Table>");
+  line(1, "</s:Worksheet>");
+}
@@ -0,0 +1,91 @@
+#ifndef SCYTL_GENERATE_INCLUDED
+#define SCYTL_GENERATE_INCLUDED
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+// Settings for a synthetic workbook. The defaults give something the size of
+// a statewide precinct-level export.
+class CGeneratorOptions
+{
+public:
+  enum EWhitespace
+  {
+    Pretty,     // two space indents and LF, like the Scytl exports
+    Compact,    // no whitespace between elements at all
+    Tabs,       // tab indents and LF
+    Crlf        // two space indents and CRLF
+  };
+
+  CGeneratorOptions()
+    : Regions(10000), Contests(40), Candidates(4), VoteTypes(3), Reporting(100), Whitespace(Pretty), Seed(1)
+  {}
+
+  int Regions;
+  int Contests;
+  int Candidates;     // per contest
+  int VoteTypes;      // per candidate, each followed by a "Total Votes" column
+  int Reporting;      // percent of the votes counted so far. with the same seed,
+                      // every count only grows as this goes up.
+  EWhitespace Whitespace;
+  unsigned long long Seed;
+};
+
+// "pretty", "compact", "tabs" or "crlf". returns 1 if 'name' isn't one of them.
+int ParseWhitespace(const std::string &name, CGeneratorOptions::EWhitespace &whitespace);
+
+// Writes Scytl-style SpreadsheetML workbooks for scale testing: document
+// properties, a table of contents, the Registered Voters page and one page per
+// contest with MergeAcross candidate headers, laid out like the real exports.
+//
+// Everything comes from a small PRNG seeded from the options, so the same
+// options always give the same bytes, on any platform. The numbers add up the
+// way the real ones do: each candidate's "Total Votes" is the sum of their
+// vote types, "Total" is the sum of the candidates, the "Totals:" row is the
+// sum of the regions, and no region casts more votes in a contest than it
+// has ballots.
+class CScytlGenerator
+{
+public:
+  CScytlGenerator(const CGeneratorOptions &Options);
+
+  void Write(std::ostream &out);
+  int Write(const std::string &Filename);
+
+protected:
+  void writeHeader();
+  void writeTableOfContents();
+  void writeRegisteredVoters();
+  void writeContest(int contest);
+
+  // one line of markup at the given depth, indented and ended according to
+  // the whitespace style
+  void line(int depth, const char *text);
+  void line(int depth, const std::string &text);
+
+  // <s:Cell[ s:StyleID="style"]><s:Data s:Type="type">text</s:Data></s:Cell>
+  void cell(int depth, const char *style, const char *type, const std::string &text);
+  void numberCell(int depth, long long value);
+
+  // the next number from the PRNG, and one in [0, n)
+  unsigned long long next();
+  unsigned int below(unsigned int n);
+
+  // buffered output
+  void flush();
+
+private:
+  CGeneratorOptions options;
+  unsigned long long state;
+
+  std::vector<std::string> regions;
+  std::vector<int> registered;    // per region
+  std::vector<int> ballots;       // per region, what no contest can exceed
+  std::vector<std::string> contests;
+
+  std::ostream *out;
+  std::string buffer;
+};
+
+#endif // SCYTL_GENERATE_INCLUDED
@@ -0,0 +1,142 @@
+#include <cmath>
+#include <climits>
+#include <atomic>
+
+#include "scytl-histogram.h"
+
+using namespace std;
+
+int CLatencyHistogram::bucket(unsigned long long us)
+{
+  if (us < (1ULL << SUB_BUCKET_BITS))
+    return (int)us;
+
+  // shift until 64 <= us >> shift < 128. every shift halves the resolution
+  // and adds 64 buckets.
+  int shift = 0;
+  while ((us >> shift) >= (1ULL << SUB_BUCKET_BITS))
+    ++shift;
+  return 64 * shift + (int)(us >> shift);
+}
+
+unsigned long long CLatencyHistogram::highestValue(int bucket)
+{
+  if (bucket < (1 << SUB_BUCKET_BITS))
+    return bucket;
+
+  int shift = bucket / 64 - 1;
+  unsigned long long lowest = (unsigned long long)(bucket - 64 * shift) << shift;
+  return lowest + (1ULL << shift) - 1;
+}
+
+void CLatencyHistogram::Record(double seconds)
+{
+  unsigned long long us = seconds > 0 ? (unsigned long long)(seconds * 1e6 + 0.5) : 0;
+  if (us > highestValue(BUCKETS - 1))
+    us = highestValue(BUCKETS - 1);
+
+  counts[bucket(us)].fetch_add(1, memory_order_relaxed);
+  total.fetch_add(1, memory_order_relaxed);
+  sumUs.fetch_add(us, memory_order_relaxed);
+
+  unsigned long long seen = minUs.load(memory_order_relaxed);
+  while (us < seen && !minUs.compare_exchange_weak(seen, us, memory_order_relaxed))
+    ;
+  seen = maxUs.load(memory_order_relaxed);
+  while (us > seen && !maxUs.compare_exchange_weak(seen, us, memory_order_relaxed))
+    ;
+}
+
+void CLatencyHistogram::Merge(const CLatencyHistogram &other)
+{
+  for (int i = 0; i < BUCKETS; ++i)
+  {
+    unsigned long long count = other.counts[i].load(memory_order_relaxed);
+    if (count)
+      counts[i].fetch_add(count, memory_order_relaxed);
+  }
+  total.fetch_add(other.total.load(memory_order_relaxed), memory_order_relaxed);
+  sumUs.fetch_add(other.sumUs.load(memory_order_relaxed), memory_order_relaxed);
+
+  unsigned long long value = other.minUs.load(memory_order_relaxed);
+  unsigned long long seen = minUs.load(memory_order_relaxed);
+  while (value < seen && !minUs.compare_exchange_weak(seen, value, memory_order_relaxed))
+    ;
+  value = other.maxUs.load(memory_order_relaxed);
+  seen = maxUs.load(memory_order_relaxed);
+  while (value > seen && !maxUs.compare_exchange_weak(seen, value, memory_order_relaxed))
+    ;
+}
+
+void CLatencyHistogram::Clear()
+{
+  for (int i = 0; i < BUCKETS; ++i)
+    counts[i].store(0, memory_order_relaxed);
+  total.store(0, memory_order_relaxed);
+  sumUs.store(0, memory_order_relaxed);
+  minUs.store(ULLONG_MAX, memory_order_relaxed);
+  maxUs.store(0, memory_order_relaxed);
+}
+
+unsigned long long CLatencyHistogram::Count() const
+{
+  return total.load(memory_order_relaxed);
+}
+
+double CLatencyHistogram::Min() const
+{
+  unsigned long long us = minUs.load(memory_order_relaxed);
+  return us == ULLONG_MAX ? 0 : us * 1e-6;
+}
+
+double CLatencyHistogram::Max() const
+{
+  return maxUs.load(memory_order_relaxed) * 1e-6;
+}
+
+double CLatencyHistogram::Mean() const
+{
+  unsigned long long count = Count();
+  return count ? (double)sumUs.load(memory_order_relaxed) / count * 1e-6 : 0;
+}
+
+double CLatencyHistogram::Sum() const
+{
+  return sumUs.load(memory_order_relaxed) * 1e-6;
+}
+
+unsigned long long CLatencyHistogram::CountAtOrBelow(double seconds) const
+{
+  unsigned long long us = seconds > 0 ? (unsigned long long)(seconds * 1e6 + 0.5) : 0;
+  unsigned long long count = 0;
+  for (int i = 0; i < BUCKETS && highestValue(i) <= us; ++i)
+    count += counts[i].load(memory_order_relaxed);
+  return count;
+}
+
+double CLatencyHistogram::Percentile(double percent) const
+{
+  // count over the buckets themselves, so a Record() halfway done can't send
+  // us past the end
+  unsigned long long count = 0;
+  for (int i = 0; i < BUCKETS; ++i)
+    count += counts[i].load(memory_order_relaxed);
+  if (!count)
+    return 0;
+
+  unsigned long long rank = (unsigned long long)ceil(percent / 100.0 * count);
+  if (rank < 1)
+    rank = 1;
+
+  unsigned long long max = maxUs.load(memory_order_relaxed);
+  unsigned long long seen = 0;
+  for (int i = 0; i < BUCKETS; ++i)
+  {
+    seen += counts[i].load(memory_order_relaxed);
+    if (seen >= rank) {
+      unsigned long long us = highestValue(i);
+      return (us < max ? us : max) * 1e-6;
+    }
+  }
+  return max * 1e-6;
+}
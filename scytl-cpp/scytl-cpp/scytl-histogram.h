@@ -0,0 +1,62 @@
+#ifndef SCYTL_HISTOGRAM_INCLUDED
+#define SCYTL_HISTOGRAM_INCLUDED
+
+#include <atomic>
+
+// Latencies from a microsecond to hours, bucketed HDR style: exact below
+// 128 us, and within 1/64 (1.6%) of the value above that, in a fixed 16 kB
+// of counters. Any number of threads can Record() at once without a lock;
+// one histogram per thread (or per server) can also be Merge()d into a total
+// afterwards. Percentiles are read while others keep recording, and are then
+// only as consistent as the moment allows.
+//
+// Example:
+//
+//  CLatencyHistogram reloads;
+//  reloads.Record(readSeconds);
+//  double p99 = reloads.Percentile(99.0);
+class CLatencyHistogram
+{
+public:
+  CLatencyHistogram() { Clear(); }
+
+  void Record(double seconds);
+  void Merge(const CLatencyHistogram &other);
+  void Clear();
+
+  unsigned long long Count() const;
+
+  // in seconds, 0 while empty. a percentile is the highest value its
+  // bucket stands for, so it's never below the true value.
+  double Min() const;
+  double Max() const;
+  double Mean() const;
+  double Percentile(double percent) const;
+
+  // every value recorded, added up, in seconds
+  double Sum() const;
+
+  // how many values were at most 'seconds', as far as the buckets can tell
+  unsigned long long CountAtOrBelow(double seconds) const;
+
+private:
+  CLatencyHistogram(const CLatencyHistogram &);   // not supported
+  void operator=(const CLatencyHistogram &);      // not supported
+
+  enum
+  {
+    SUB_BUCKET_BITS = 7,                    // 128 values exact, then 64 per power of two
+    BUCKETS = 64 * (37 - SUB_BUCKET_BITS) + 128   // up to 2^37 us, a day and a half
+  };
+
+  static int bucket(unsigned long long us);
+  static unsigned long long highestValue(int bucket);
+
+  std::atomic<unsigned long long> counts[BUCKETS];
+  std::atomic<unsigned long long> total;
+  std::atomic<unsigned long long> sumUs;
+  std::atomic<unsigned long long> minUs;
+  std::atomic<unsigned long long> maxUs;
+};
+
+#endif // SCYTL_HISTOGRAM_INCLUDED
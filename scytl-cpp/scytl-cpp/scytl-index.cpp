@@ -0,0 +1,173 @@
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <cstdlib>
+#include <unistd.h>
+#endif
+
+#include "scytl-index.h"
+
+using namespace std;
+
+// Layout:
+//
+//   "SCYTLIX1"
+//   u64 workbook size, i64 workbook modification time
+//   u32 worksheet count
+//   per worksheet:
+//     str name, str contest, i32 page
+//     u64 offset, u64 length, u64 hash
+//
+// where str is a u32 length followed by that many bytes, all in host byte
+// order like the snapshots.
+
+static const char signature[8] = { 'S', 'C', 'Y', 'T', 'L', 'I', 'X', '1' };
+
+template< class T >
+static void writeValue(FILE *fp, T value)
+{
+  fwrite(&value, sizeof(value), 1, fp);
+}
+
+static void writeString(FILE *fp, const string &value)
+{
+  writeValue(fp, (unsigned int)value.size());
+  fwrite(value.data(), 1, value.size(), fp);
+}
+
+template< class T >
+static bool readValue(FILE *fp, T &value)
+{
+  return fread(&value, sizeof(value), 1, fp) == 1;
+}
+
+static bool readString(FILE *fp, string &value)
+{
+  unsigned int length;
+  if (!readValue(fp, length) || length > 65536)
+    return false;
+  value.resize(length);
+  return !length || fread(&value[0], 1, length, fp) == length;
+}
+
+string IndexFilename(const string &workbook)
+{
+  return workbook + ".idx";
+}
+
+int WriteIndex(const string &Filename, const CWorkbookIndex &index)
+{
+  // write to the side and rename, so a reader never sees half an index. the
+  // temporary is ours alone, in case another process is indexing the same
+  // workbook right now.
+#ifdef __linux__
+  string temp = Filename + ".XXXXXX";
+  int fd = mkstemp(&temp[0]);
+  if (fd < 0)
+    return 1;
+  fchmod(fd, 0644);
+  FILE *fp = fdopen(fd, "wb");
+  if (!fp) {
+    close(fd);
+    remove(temp.c_str());
+    return 1;
+  }
+#else
+  string temp = Filename + ".tmp";
+  FILE *fp = fopen(temp.c_str(), "wb");
+  if (!fp)
+    return 1;
+#endif
+
+  fwrite(signature, 1, sizeof(signature), fp);
+  writeValue(fp, index.FileSize);
+  writeValue(fp, index.ModifiedTime);
+  writeValue(fp, (unsigned int)index.Entries.size());
+  for (vector<CIndexEntry>::const_iterator it = index.Entries.begin(); it != index.Entries.end(); ++it)
+  {
+    writeString(fp, it->Name);
+    writeString(fp, it->Contest);
+    writeValue(fp, it->Page);
+    writeValue(fp, it->Offset);
+    writeValue(fp, it->Length);
+    writeValue(fp, it->Hash);
+  }
+
+  bool failed = ferror(fp) != 0;
+  if (fclose(fp))
+    failed = true;
+  if (failed || rename(temp.c_str(), Filename.c_str())) {
+    remove(temp.c_str());
+    return 1;
+  }
+  return 0;
+}
+
+int ReadIndex(const string &Filename, CWorkbookIndex &index)
+{
+  FILE *fp = fopen(Filename.c_str(), "rb");
+  if (!fp)
+    return 1;
+
+  char sig[sizeof(signature)];
+  unsigned int count;
+  if (fread(sig, 1, sizeof(sig), fp) != sizeof(sig) || memcmp(sig, signature, sizeof(sig)) ||
+      !readValue(fp, index.FileSize) || !readValue(fp, index.ModifiedTime) || !readValue(fp, count))
+  {
+    fclose(fp);
+    return 1;
+  }
+
+  index.Entries.clear();
+  for (unsigned int i = 0; i < count; ++i)
+  {
+    CIndexEntry entry;
+    if (!readString(fp, entry.Name) || !readString(fp, entry.Contest) || !readValue(fp, entry.Page) ||
+        !readValue(fp, entry.Offset) || !readValue(fp, entry.Length) || !readValue(fp, entry.Hash))
+    {
+      fclose(fp);
+      return 1;
+    }
+
+    // a worksheet past the end of the workbook it describes means the index
+    // is corrupt
+    if (entry.Offset > index.FileSize || entry.Length > index.FileSize - entry.Offset) {
+      fclose(fp);
+      return 1;
+    }
+    index.Entries.push_back(entry);
+  }
+
+  fclose(fp);
+  return 0;
+}
+
+int StatWorkbook(const string &workbook, unsigned long long &size, long long &modified)
+{
+  struct stat st;
+  if (stat(workbook.c_str(), &st))
+    return 1;
+  size = (unsigned long long)st.st_size;
+#ifdef __linux__
+  // to the nanosecond where we can, so two writes in one second still differ
+  modified = (long long)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#else
+  modified = (long long)st.st_mtime;
+#endif
+  return 0;
+}
+
+bool IndexIsCurrent(const string &workbook, const CWorkbookIndex &index)
+{
+  unsigned long long size;
+  long long modified;
+  if (StatWorkbook(workbook, size, modified))
+    return false;
+  return size == index.FileSize && modified == index.ModifiedTime;
+}
@@ -0,0 +1,46 @@
+#ifndef SCYTL_INDEX_INCLUDED
+#define SCYTL_INDEX_INCLUDED
+
+#include <string>
+#include <vector>
+
+// Sidecar index written next to a workbook ("detail.xls" -> "detail.xls.idx"),
+// recording where every worksheet lives, so that later lookups can read one
+// worksheet straight from its offset instead of scanning the whole file.
+//
+// The index is stale as soon as the workbook's size or modification time
+// differs from what it records. Each worksheet's hash is checked again when
+// it's read, which catches a rewrite within the same second.
+class CIndexEntry
+{
+public:
+  std::string Name;       // s:Name of the worksheet
+  std::string Contest;    // from the table of contents, "" if not a contest
+  int Page;               // TOC page, -1 if not a contest
+  unsigned long long Offset;
+  unsigned long long Length;
+  unsigned long long Hash;
+};
+
+class CWorkbookIndex
+{
+public:
+  CWorkbookIndex() : FileSize(0), ModifiedTime(0) {}
+
+  unsigned long long FileSize;
+  long long ModifiedTime;
+  std::vector<CIndexEntry> Entries;
+};
+
+std::string IndexFilename(const std::string &workbook);
+
+int WriteIndex(const std::string &Filename, const CWorkbookIndex &index);
+int ReadIndex(const std::string &Filename, CWorkbookIndex &index);
+
+// size and modification time of 'workbook', for comparing with an index
+int StatWorkbook(const std::string &workbook, unsigned long long &size, long long &modified);
+
+// true if 'index' still describes 'workbook'
+bool IndexIsCurrent(const std::string &workbook, const CWorkbookIndex &index);
+
+#endif // SCYTL_INDEX_INCLUDED
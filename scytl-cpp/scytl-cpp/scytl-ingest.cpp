@@ -0,0 +1,93 @@
+#include <string>
+#include <iostream>
+#include <thread>
+#include <memory>
+
+#include "scytl-ingest.h"
+#include "scytl-validate.h"
+#include "scytl-trace.h"
+
+using namespace std;
+
+CScytlIngest::CScytlIngest(const string &Filename)
+  : watcher(*this), stopping(false), lazyCap(0)
+{
+  watcher.Add(Filename);
+  watcher.Metrics().AddLatency("query", &queryLatency);
+}
+
+CScytlIngest::~CScytlIngest()
+{
+  stopping = true;
+  if (ingestThread.joinable())
+    ingestThread.join();
+}
+
+void CScytlIngest::CIngestWatcher::Reloaded(const CScytlReader &reader, double changed, double readSeconds)
+{
+  if (ingest.lazyCap) {
+    // the watcher has just indexed the workbook, so this only reads the index
+    shared_ptr<CLazyWorkbook> workbook(new CLazyWorkbook(reader.Filename(), ingest.lazyCap));
+    if (workbook->Open()) {
+      cout << "Error opening <" << reader.Filename() << ">" << endl;
+      return;
+    }
+    ingest.publisher.Publish(ingest.builder.Build(workbook));
+
+    cerr << "Reloaded <" << reader.Filename() << ">: "
+         << workbook->Count() << " contests indexed in "
+         << readSeconds * 1000.0 << " ms, change to publish "
+         << (now() - changed) * 1000.0 << " ms" << endl;
+    return;
+  }
+
+  // the new model is complete before it's swapped in, and whatever readers
+  // are looking at stays alive until they let go
+  const CResultsModel *model = ingest.builder.Build(reader);
+  ingest.publisher.Publish(model);
+
+  // only this thread reclaims models, so 'model' is still alive here
+  ingest.feed.Append(model->Version, model->Elections);
+
+  for (vector<const CElection *>::const_iterator it = reader.ChangedResults().begin();
+       it != reader.ChangedResults().end();
+       ++it)
+  {
+    PrintMismatches(cerr, **it);
+  }
+
+  cerr << "Reloaded <" << reader.Filename() << ">: "
+       << reader.WorksheetsParsed() << " worksheets parsed in "
+       << readSeconds * 1000.0 << " ms, change to publish "
+       << (now() - changed) * 1000.0 << " ms" << endl;
+}
+
+int CScytlIngest::Start()
+{
+  // the initial load happens here, so servers have results from the start
+  if (watcher.Start())
+    return 1;
+  ingestThread = thread(&CScytlIngest::run, this);
+  return 0;
+}
+
+void CScytlIngest::Latencies(TLatencies &latencies) const
+{
+  watcher.Latencies(latencies);
+  latencies.push_back(make_pair(string("query"), &queryLatency));
+}
+
+void CScytlIngest::run()
+{
+  // wake up now and then to notice we're shutting down, and to free models
+  // that readers were still holding when the last one was published
+  SetTraceThreadName("ingest");
+  while (!stopping)
+  {
+    if (watcher.Poll(250)) {
+      cout << "Error watching <" << watcher.Reader(0).Filename() << ">" << endl;
+      return;
+    }
+    publisher.Reclaim();
+  }
+}
@@ -0,0 +1,87 @@
+#ifndef SCYTL_INGEST_INCLUDED
+#define SCYTL_INGEST_INCLUDED
+
+#include <string>
+#include <iostream>
+#include <thread>
+#include <atomic>
+
+#include "scytl-reader.h"
+#include "scytl-watch.h"
+#include "scytl-model.h"
+#include "scytl-publish.h"
+#include "scytl-feed.h"
+
+// Keeps one workbook loaded for the long-running server modes. The workbook is
+// watched and reloaded on a background thread, and every successful reload is
+// published as a new CResultsModel, so any number of server threads can read
+// the current results without ever waiting on ingestion.
+class CScytlIngest
+{
+public:
+  CScytlIngest(const std::string &Filename);
+  ~CScytlIngest();
+
+  // extract changed worksheets on this many threads. call before Start().
+  void SetThreads(int Threads) { watcher.SetThreads(Threads); }
+
+  // log the stats of every (re)load to cerr. call before Start().
+  void SetStats(CReadStats::EFormat Format) { watcher.SetStats(Format); }
+
+  // write a trace of every refresh to 'Filename' (see CScytlWatcher::SetTrace())
+  void SetTrace(const std::string &Filename) { watcher.SetTrace(Filename); }
+
+  // write the metrics to 'Filename' now and then (see
+  // CScytlWatcher::SetMetricsFile()). call before Start().
+  void SetMetricsFile(const std::string &Filename) { watcher.SetMetricsFile(Filename); }
+
+  // don't extract anything on (re)load, only index the workbook, and publish
+  // models that extract contests the first time they're asked for, keeping
+  // up to 'MemoryCap' bytes of them (see CLazyWorkbook). regions, aggregates
+  // and the change feed need every contest, so they go without. call before
+  // Start().
+  void SetLazy(size_t MemoryCap) { lazyCap = MemoryCap; watcher.SetIndexOnly(true); }
+
+  // do the initial load, then keep watching on the ingest thread
+  int Start();
+
+  CSnapshotPublisher<CResultsModel> &Publisher() { return publisher; }
+  CChangeFeed &Feed() { return feed; }
+
+  // servers record how long each query took to answer here, from any thread
+  CLatencyHistogram &QueryLatency() { return queryLatency; }
+
+  // the watcher's histograms (see CScytlWatcher::Latencies()), then "query"
+  void Latencies(TLatencies &latencies) const;
+
+  // the watcher's metrics, which servers add their cache hits and queues to
+  CScytlMetrics &Metrics() { return watcher.Metrics(); }
+
+private:
+  // publishes a new model after every successful reload
+  class CIngestWatcher : public CScytlWatcher
+  {
+  public:
+    CIngestWatcher(CScytlIngest &Ingest) : CScytlWatcher(std::cerr), ingest(Ingest) {}
+
+  protected:
+    virtual void Reloaded(const CScytlReader &reader, double changed, double readSeconds);
+
+  private:
+    CScytlIngest &ingest;
+  };
+
+  void run();
+
+  CIngestWatcher watcher;
+  CModelBuilder builder;
+  std::thread ingestThread;
+  std::atomic<bool> stopping;
+  size_t lazyCap;     // 0 unless SetLazy()
+
+  CSnapshotPublisher<CResultsModel> publisher;
+  CChangeFeed feed;
+  CLatencyHistogram queryLatency;
+};
+
+#endif // SCYTL_INGEST_INCLUDED
@@ -0,0 +1,71 @@
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "scytl-join.h"
+#include "scytl-simd.h"
+
+using namespace std;
+
+void CRegionIndex::Build(const vector<CRegionProfile> &profiles)
+{
+  regions.clear();
+  regions.reserve(profiles.size());
+  for (size_t i = 0; i < profiles.size(); ++i)
+  {
+    // the summary row isn't a region
+    if (!IsTotalsLabel(profiles[i].RegionName))
+      regions.insert(make_pair(profiles[i].RegionName, (int)i));
+  }
+}
+
+int CRegionIndex::Find(const string &name) const
+{
+  unordered_map<string, int>::const_iterator it = regions.find(name);
+  return it == regions.end() ? -1 : it->second;
+}
+
+void JoinRegions(const CColumnarContest &contest, const CRegionIndex &index,
+                 const vector<CRegionProfile> &profiles, CRegionJoin &join)
+{
+  join.Profiles.resize(contest.Rows);
+  join.Rows.assign(profiles.size(), -1);
+  join.RegisteredVoters.assign(contest.Rows, 0);
+  join.BallotsCast.assign(contest.Rows, 0);
+
+  for (size_t row = 0; row < contest.Rows; ++row)
+  {
+    int profile = index.Find(contest.Labels[row]);
+    join.Profiles[row] = profile;
+    if (profile < 0)
+      continue;
+    join.Rows[profile] = (int)row;
+    join.RegisteredVoters[row] = profiles[profile].RegisteredVoters;
+    join.BallotsCast[row] = profiles[profile].BallotsCast;
+  }
+}
+
+void ColumnRatios(const int *numerators, const int *denominators, size_t n, vector<double> &ratios)
+{
+  ratios.resize(n);
+  size_t i = 0;
+#ifdef SCYTL_SSE2
+  // two at a time. zero denominators are divided by one instead and masked
+  // out afterwards.
+  __m128i zero = _mm_setzero_si128();
+  __m128i one = _mm_set1_epi32(1);
+  for (; i + 2 <= n; i += 2)
+  {
+    __m128i num = _mm_loadl_epi64((const __m128i *)(numerators + i));
+    __m128i den = _mm_loadl_epi64((const __m128i *)(denominators + i));
+    __m128i isZero = _mm_cmpeq_epi32(den, zero);
+    den = _mm_or_si128(_mm_andnot_si128(isZero, den), _mm_and_si128(isZero, one));
+
+    __m128d ratio = _mm_div_pd(_mm_cvtepi32_pd(num), _mm_cvtepi32_pd(den));
+    __m128d keep = _mm_castsi128_pd(_mm_unpacklo_epi32(isZero, isZero));
+    _mm_storeu_pd(&ratios[i], _mm_andnot_pd(keep, ratio));
+  }
+#endif
+  for (; i < n; ++i)
+    ratios[i] = denominators[i] ? (double)numerators[i] / denominators[i] : 0.0;
+}
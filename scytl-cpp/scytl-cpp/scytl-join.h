@@ -0,0 +1,47 @@
+#ifndef SCYTL_JOIN_INCLUDED
+#define SCYTL_JOIN_INCLUDED
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "scytl-reader.h"
+#include "scytl-aggregate.h"
+
+// Region name -> position in the Registered Voters profiles. Built once per
+// load, so matching a contest's rows to their profiles is a hash lookup per
+// row rather than a string compare against every profile.
+class CRegionIndex
+{
+public:
+  void Build(const std::vector<CRegionProfile> &profiles);
+
+  // -1 if there's no profile for 'name'
+  int Find(const std::string &name) const;
+
+  size_t Size() const { return regions.size(); }
+
+private:
+  std::unordered_map<std::string, int> regions;
+};
+
+// one contest's rows matched up with the Registered Voters profiles. per-row
+// figures line up with the CColumnarContest rows, so they can be used as
+// just another column.
+class CRegionJoin
+{
+public:
+  std::vector<int> Profiles;            // per row, index into the profiles, -1 if none
+  std::vector<int> Rows;                // per profile, the row for it, -1 if none
+  std::vector<int> RegisteredVoters;    // per row, 0 if the region has no profile
+  std::vector<int> BallotsCast;         // per row, 0 if the region has no profile
+};
+
+void JoinRegions(const CColumnarContest &contest, const CRegionIndex &index,
+                 const std::vector<CRegionProfile> &profiles, CRegionJoin &join);
+
+// numerators[i] / denominators[i] for a whole column, 0 where the
+// denominator is 0
+void ColumnRatios(const int *numerators, const int *denominators, size_t n, std::vector<double> &ratios);
+
+#endif // SCYTL_JOIN_INCLUDED
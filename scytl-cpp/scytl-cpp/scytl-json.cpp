@@ -0,0 +1,34 @@
+#include <string>
+#include <iostream>
+#include <cstdio>
+
+#include "scytl-json.h"
+
+using namespace std;
+
+void AppendJsonString(string &out, const string &value)
+{
+  out += '"';
+  for (string::const_iterator it = value.begin(); it != value.end(); ++it)
+  {
+    unsigned char c = (unsigned char)*it;
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += (char)c;
+    } else if (c < 0x20) {
+      char buf[8];
+      snprintf(buf, sizeof(buf), "\\u%04x", c);
+      out += buf;
+    } else {
+      out += (char)c;
+    }
+  }
+  out += '"';
+}
+
+void WriteJsonString(ostream &out, const string &value)
+{
+  string quoted;
+  AppendJsonString(quoted, value);
+  out << quoted;
+}
@@ -0,0 +1,17 @@
+#ifndef SCYTL_JSON_INCLUDED
+#define SCYTL_JSON_INCLUDED
+
+#include <string>
+#include <ostream>
+
+// 'value' as a JSON string literal, quotes included: quotes and backslashes
+// escaped, control characters as \u00XX, everything else (UTF-8 included)
+// passed through as is.
+//
+// Example:
+//
+//  AppendJsonString(body, election.ElectionName);   // "U.S. President - DEM"
+void AppendJsonString(std::string &out, const std::string &value);
+void WriteJsonString(std::ostream &out, const std::string &value);
+
+#endif // SCYTL_JSON_INCLUDED
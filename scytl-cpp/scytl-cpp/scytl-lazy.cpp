@@ -0,0 +1,128 @@
+#include <string>
+#include <list>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <iostream>
+
+#include "scytl-lazy.h"
+
+using namespace std;
+
+size_t ElectionBytes(const CElection &election)
+{
+  size_t bytes = sizeof(CElection) + election.ElectionName.capacity();
+  for (size_t i = 0; i < election.Header.size(); ++i)
+  {
+    bytes += sizeof(CElectionHeader) + election.Header[i].ColumnName.capacity() +
+             election.Header[i].CandidateName.capacity();
+  }
+  for (list<CLabeledTuple>::const_iterator it = election.Results.begin(); it != election.Results.end(); ++it)
+  {
+    // list nodes carry two pointers
+    bytes += sizeof(CLabeledTuple) + 2 * sizeof(void *) + it->Label.capacity() +
+             it->Data.capacity() * sizeof(int);
+  }
+  bytes += election.Mismatches.capacity() * sizeof(CTotalsMismatch);
+  return bytes;
+}
+
+CLazyWorkbook::CLazyWorkbook(const string &Filename, size_t MemoryCap)
+  : filename(Filename), memoryCap(MemoryCap), memoryUsed(0), extractions(0)
+{
+}
+
+int CLazyWorkbook::Open()
+{
+  CScytlReader reader(filename);
+  CWorkbookIndex index;
+  if (reader.LoadIndex(index))
+    return 1;
+
+  lock_guard<mutex> guard(lock);
+  slots.clear();
+  used.clear();
+  memoryUsed = 0;
+  extractions = 0;
+  for (vector<CIndexEntry>::const_iterator it = index.Entries.begin(); it != index.Entries.end(); ++it)
+  {
+    if (it->Page < 0)
+      continue;
+    slots.push_back(unique_ptr<CSlot>(new CSlot));
+    slots.back()->Entry = *it;
+  }
+  return 0;
+}
+
+shared_ptr<const CElection> CLazyWorkbook::Contest(size_t i)
+{
+  if (i >= slots.size())
+    return shared_ptr<const CElection>();
+  CSlot &slot = *slots[i];
+
+  {
+    lock_guard<mutex> guard(lock);
+    if (slot.Election) {
+      used.splice(used.begin(), used, slot.Used);
+      return slot.Election;
+    }
+  }
+
+  // one thread extracts, anybody else asking for the same contest waits for
+  // it rather than extracting it again. other contests aren't held up.
+  lock_guard<mutex> loading(slot.Loading);
+  {
+    lock_guard<mutex> guard(lock);
+    if (slot.Election) {
+      used.splice(used.begin(), used, slot.Used);
+      return slot.Election;
+    }
+  }
+
+  // readers aren't thread safe, so every extraction gets its own
+  CScytlReader reader(filename);
+  shared_ptr<CElection> election = make_shared<CElection>();
+  int result = reader.ReadIndexedContest(slot.Entry, *election);
+  if (result) {
+    if (result == 2)
+      cout << "Error: <" << filename << "> changed since it was opened" << endl;
+    return shared_ptr<const CElection>();
+  }
+
+  lock_guard<mutex> guard(lock);
+  slot.Election = election;
+  slot.Bytes = ElectionBytes(*election);
+  used.push_front(i);
+  slot.Used = used.begin();
+  memoryUsed += slot.Bytes;
+  ++extractions;
+  evict();
+  return election;
+}
+
+void CLazyWorkbook::evict()
+{
+  // always keep the contest that was just asked for, even if it alone is
+  // over the cap
+  while (memoryUsed > memoryCap && used.size() > 1)
+  {
+    CSlot &slot = *slots[used.back()];
+    memoryUsed -= slot.Bytes;
+    slot.Election.reset();
+    slot.Bytes = 0;
+    used.pop_back();
+  }
+}
+
+size_t CLazyWorkbook::MemoryUsed()
+{
+  lock_guard<mutex> guard(lock);
+  return memoryUsed;
+}
+
+size_t CLazyWorkbook::Extractions()
+{
+  lock_guard<mutex> guard(lock);
+  return extractions;
+}
@@ -0,0 +1,74 @@
+#ifndef SCYTL_LAZY_INCLUDED
+#define SCYTL_LAZY_INCLUDED
+
+#include <string>
+#include <list>
+#include <vector>
+#include <memory>
+#include <mutex>
+
+#include "scytl-reader.h"
+#include "scytl-index.h"
+
+// A workbook opened without extracting any contests. Open() only indexes the
+// worksheets (through the sidecar index when there's a current one), and each
+// contest is parsed and extracted the first time somebody asks for it. Once
+// the extracted contests take up more than the memory cap, the least recently
+// used ones are dropped and extracted again if they're wanted later.
+//
+// Contest() can be called from any number of threads. Two threads asking for
+// the same contest share one extraction.
+class CLazyWorkbook
+{
+public:
+  CLazyWorkbook(const std::string &Filename, size_t MemoryCap = 64 * 1024 * 1024);
+
+  int Open();
+
+  const std::string &Filename() const { return filename; }
+
+  size_t Count() const { return slots.size(); }
+  const std::string &ContestName(size_t i) const { return slots[i]->Entry.Contest; }
+  int ContestPage(size_t i) const { return slots[i]->Entry.Page; }
+
+  // the contest, extracted now if it isn't in memory. NULL if it can't be
+  // read (or the workbook changed since Open()). the contest stays valid for
+  // as long as the caller holds on to it, evicted or not.
+  std::shared_ptr<const CElection> Contest(size_t i);
+
+  size_t MemoryUsed();        // approximate bytes held by extracted contests
+  size_t Extractions();       // contests extracted since Open()
+
+private:
+  CLazyWorkbook(const CLazyWorkbook &);   // not supported
+  void operator=(const CLazyWorkbook &);  // not supported
+
+  class CSlot
+  {
+  public:
+    CSlot() : Bytes(0) {}
+
+    CIndexEntry Entry;
+    std::mutex Loading;                       // held while extracting
+    std::shared_ptr<const CElection> Election;
+    size_t Bytes;
+    std::list<size_t>::iterator Used;         // position in 'used' while extracted
+  };
+
+  // drop least recently used contests until we're under the cap
+  void evict();
+
+  std::string filename;
+  size_t memoryCap;
+  std::vector<std::unique_ptr<CSlot> > slots;
+
+  std::mutex lock;          // guards everything below, and each slot's Election
+  std::list<size_t> used;   // extracted contests, most recently used first
+  size_t memoryUsed;
+  size_t extractions;
+};
+
+// rough size in memory of an extracted contest
+size_t ElectionBytes(const CElection &election);
+
+#endif // SCYTL_LAZY_INCLUDED
@@ -0,0 +1,115 @@
+#include <string>
+#include <vector>
+
+#include "scytl-leaders.h"
+#include "scytl-simd.h"
+
+using namespace std;
+
+#ifdef SCYTL_SSE2
+// a where mask is set, b elsewhere
+static inline __m128i select(__m128i mask, __m128i a, __m128i b)
+{
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+#endif
+
+// fold one more candidate's votes into the running best and second best of
+// every row
+static void rankCandidate(const int *votes, int candidate, size_t rows,
+                          int *best, int *second, int *leader, int *runnerUp)
+{
+  size_t i = 0;
+#ifdef SCYTL_SSE2
+  __m128i id = _mm_set1_epi32(candidate);
+  for (; i + 4 <= rows; i += 4)
+  {
+    __m128i v = _mm_loadu_si128((const __m128i *)(votes + i));
+    __m128i b = _mm_loadu_si128((const __m128i *)(best + i));
+    __m128i s = _mm_loadu_si128((const __m128i *)(second + i));
+    __m128i l = _mm_loadu_si128((const __m128i *)(leader + i));
+    __m128i r = _mm_loadu_si128((const __m128i *)(runnerUp + i));
+
+    __m128i aheadOfBest = _mm_cmpgt_epi32(v, b);
+    __m128i aheadOfSecond = _mm_cmpgt_epi32(v, s);
+
+    _mm_storeu_si128((__m128i *)(second + i), select(aheadOfBest, b, select(aheadOfSecond, v, s)));
+    _mm_storeu_si128((__m128i *)(runnerUp + i), select(aheadOfBest, l, select(aheadOfSecond, id, r)));
+    _mm_storeu_si128((__m128i *)(best + i), select(aheadOfBest, v, b));
+    _mm_storeu_si128((__m128i *)(leader + i), select(aheadOfBest, id, l));
+  }
+#endif
+  for (; i < rows; ++i)
+  {
+    int v = votes[i];
+    bool aheadOfBest = v > best[i];
+    bool aheadOfSecond = v > second[i];
+    second[i] = aheadOfBest ? best[i] : aheadOfSecond ? v : second[i];
+    runnerUp[i] = aheadOfBest ? leader[i] : aheadOfSecond ? candidate : runnerUp[i];
+    best[i] = aheadOfBest ? v : best[i];
+    leader[i] = aheadOfBest ? candidate : leader[i];
+  }
+}
+
+void FindLeaders(const CElection &election, const CColumnarContest &contest, CContestLeaders &leaders)
+{
+  vector<CCandidateSpan> spans;
+  CandidateSpans(election.Header, spans);
+
+  size_t rows = contest.Rows;
+  leaders.Candidates.clear();
+  leaders.Leader.assign(rows, -1);
+  leaders.RunnerUp.assign(rows, -1);
+  leaders.Margin.assign(rows, 0);
+  leaders.Tie.assign(rows, 0);
+  leaders.TotalLeader = -1;
+  leaders.TotalRunnerUp = -1;
+  leaders.TotalMargin = 0;
+  leaders.TotalTie = false;
+
+  // vote counts are never negative, so -1 loses to any candidate
+  vector<int> best(rows, -1), second(rows, -1);
+  vector<int> sum(rows);
+  long long totalBest = -1, totalSecond = -1;
+  for (size_t c = 0; c < spans.size(); ++c)
+  {
+    const CCandidateSpan &span = spans[c];
+    leaders.Candidates.push_back(span.Candidate);
+    if (!rows)
+      continue;
+
+    const int *votes;
+    if (span.TotalVotes >= 0 && (size_t)span.TotalVotes < contest.Columns) {
+      votes = contest.Column(span.TotalVotes);
+    } else {
+      sum.assign(rows, 0);
+      for (size_t col = span.First; col < span.End && col < contest.Columns; ++col)
+        AddInt32(&sum[0], contest.Column(col), rows);
+      votes = &sum[0];
+    }
+    rankCandidate(votes, (int)c, rows, &best[0], &second[0], &leaders.Leader[0], &leaders.RunnerUp[0]);
+
+    long long total = SumInt32(votes, rows);
+    if (total > totalBest) {
+      totalSecond = totalBest;
+      leaders.TotalRunnerUp = leaders.TotalLeader;
+      totalBest = total;
+      leaders.TotalLeader = (int)c;
+    } else if (total > totalSecond) {
+      totalSecond = total;
+      leaders.TotalRunnerUp = (int)c;
+    }
+  }
+
+  for (size_t i = 0; i < rows; ++i)
+  {
+    int runnerUp = second[i] < 0 ? 0 : second[i];
+    leaders.Margin[i] = best[i] < 0 ? 0 : best[i] - runnerUp;
+    leaders.Tie[i] = second[i] >= 0 && best[i] == second[i];
+  }
+
+  if (totalBest >= 0) {
+    leaders.TotalMargin = totalBest - (totalSecond < 0 ? 0 : totalSecond);
+    leaders.TotalTie = totalSecond >= 0 && totalBest == totalSecond;
+  }
+}
@@ -0,0 +1,35 @@
+#ifndef SCYTL_LEADERS_INCLUDED
+#define SCYTL_LEADERS_INCLUDED
+
+#include <string>
+#include <vector>
+
+#include "scytl-reader.h"
+#include "scytl-aggregate.h"
+
+// Who is ahead in a contest, region by region and overall, going by each
+// candidate's "Total Votes" (or the sum of their columns if there is none).
+// Candidates are indexes into Candidates; -1 means there is no such
+// candidate (no runner-up in a one-candidate race). Equal votes leave the
+// earlier candidate in front and flag the row as tied.
+class CContestLeaders
+{
+public:
+  std::vector<std::string> Candidates;
+
+  // per row of the CColumnarContest
+  std::vector<int> Leader;
+  std::vector<int> RunnerUp;
+  std::vector<int> Margin;
+  std::vector<char> Tie;
+
+  // over every region
+  int TotalLeader;
+  int TotalRunnerUp;
+  long long TotalMargin;
+  bool TotalTie;
+};
+
+void FindLeaders(const CElection &election, const CColumnarContest &contest, CContestLeaders &leaders);
+
+#endif // SCYTL_LEADERS_INCLUDED
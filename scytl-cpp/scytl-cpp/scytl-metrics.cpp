@@ -0,0 +1,190 @@
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <atomic>
+
+#include "scytl-metrics.h"
+
+using namespace std;
+
+static const char *worksheetKinds[] = {
+  "workbook", "properties", "table_of_contents", "registered_voters", "election_results"
+};
+static const char *serverNames[] = { "http", "socket" };
+static const char *poolNames[] = { "element", "attribute", "text", "comment" };
+
+// the le="..." bounds of the latency buckets, in seconds
+static const double latencyBounds[] = {
+  0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10
+};
+
+CScytlMetrics::CScytlMetrics()
+  : filesIngested(0), bytesRead(0), bytesParsed(0), worksheetsParsed(0),
+    reloadQueue(0), subscribers(0), subscribersBehind(0)
+{
+  for (int i = 0; i < WORKSHEET_KINDS; ++i)
+    parseErrors[i].store(0);
+  for (int i = 0; i < POOLS; ++i)
+  {
+    poolPeakBytes[i].store(0);
+    poolBlockBytes[i].store(0);
+  }
+  for (int i = 0; i < SERVERS; ++i)
+  {
+    cacheHits[i].store(0);
+    cacheMisses[i].store(0);
+    connections[i].store(0);
+  }
+}
+
+void CScytlMetrics::AddLatency(const string &stage, const CLatencyHistogram *histogram)
+{
+  latencies.push_back(make_pair(stage, histogram));
+}
+
+void CScytlMetrics::Ingested(unsigned long long bytes, unsigned long long parsedBytes, int worksheets)
+{
+  filesIngested.fetch_add(1, memory_order_relaxed);
+  bytesRead.fetch_add(bytes, memory_order_relaxed);
+  bytesParsed.fetch_add(parsedBytes, memory_order_relaxed);
+  worksheetsParsed.fetch_add(worksheets, memory_order_relaxed);
+}
+
+void CScytlMetrics::ParseError(EWorksheetKind kind)
+{
+  parseErrors[kind].fetch_add(1, memory_order_relaxed);
+}
+
+void CScytlMetrics::SetPools(const vector<CPoolStats> &pools)
+{
+  for (size_t i = 0; i < pools.size() && i < POOLS; ++i)
+  {
+    poolPeakBytes[i].store((long long)pools[i].Peak * pools[i].ItemSize, memory_order_relaxed);
+    poolBlockBytes[i].store(pools[i].BlockBytes, memory_order_relaxed);
+  }
+}
+
+void CScytlMetrics::CacheLookup(EServer server, bool hit)
+{
+  if (hit)
+    cacheHits[server].fetch_add(1, memory_order_relaxed);
+  else
+    cacheMisses[server].fetch_add(1, memory_order_relaxed);
+}
+
+static void writeHeader(ostream &out, const char *name, const char *type, const char *help)
+{
+  out << "# HELP " << name << " " << help << "\n"
+      << "# TYPE " << name << " " << type << "\n";
+}
+
+static void writeValue(ostream &out, const char *name, const string &labels, double value)
+{
+  char text[64];
+  snprintf(text, sizeof(text), "%.15g", value);
+  out << name;
+  if (labels != "")
+    out << "{" << labels << "}";
+  out << " " << text << "\n";
+}
+
+// Example:
+//
+//  # HELP scytl_files_ingested_total Workbooks read successfully, initial loads included.
+//  # TYPE scytl_files_ingested_total counter
+//  scytl_files_ingested_total 12
+//  ...
+//  scytl_parse_errors_total{kind="election_results"} 1
+//  ...
+//  scytl_latency_seconds_bucket{stage="reload",le="0.01"} 11
+//  scytl_latency_seconds_bucket{stage="reload",le="+Inf"} 12
+//  scytl_latency_seconds_sum{stage="reload"} 0.0913
+//  scytl_latency_seconds_count{stage="reload"} 12
+void CScytlMetrics::Write(ostream &out) const
+{
+  writeHeader(out, "scytl_files_ingested_total", "counter", "Workbooks read successfully, initial loads included.");
+  writeValue(out, "scytl_files_ingested_total", "", (double)filesIngested.load(memory_order_relaxed));
+  writeHeader(out, "scytl_bytes_read_total", "counter", "Bytes of workbook loaded by successful reads.");
+  writeValue(out, "scytl_bytes_read_total", "", (double)bytesRead.load(memory_order_relaxed));
+  writeHeader(out, "scytl_bytes_parsed_total", "counter", "Bytes of the worksheets that had changed, and were parsed.");
+  writeValue(out, "scytl_bytes_parsed_total", "", (double)bytesParsed.load(memory_order_relaxed));
+  writeHeader(out, "scytl_worksheets_parsed_total", "counter", "Worksheets that had changed, and were parsed.");
+  writeValue(out, "scytl_worksheets_parsed_total", "", (double)worksheetsParsed.load(memory_order_relaxed));
+
+  writeHeader(out, "scytl_parse_errors_total", "counter", "Reads that failed, by the part of the workbook they failed at.");
+  for (int i = 0; i < WORKSHEET_KINDS; ++i)
+    writeValue(out, "scytl_parse_errors_total", string("kind=\"") + worksheetKinds[i] + "\"",
+               (double)parseErrors[i].load(memory_order_relaxed));
+
+  if (!latencies.empty())
+    writeHeader(out, "scytl_latency_seconds", "histogram",
+                "Reload, refresh (write to output), worksheet extraction and query latencies.");
+  for (TLatencies::const_iterator it = latencies.begin(); it != latencies.end(); ++it)
+  {
+    const CLatencyHistogram &histogram = *it->second;
+    string stage = "stage=\"" + it->first + "\"";
+
+    // the count first, so no bucket can come out above +Inf
+    unsigned long long count = histogram.Count();
+    for (size_t b = 0; b < sizeof(latencyBounds) / sizeof(latencyBounds[0]); ++b)
+    {
+      char le[32];
+      snprintf(le, sizeof(le), ",le=\"%g\"", latencyBounds[b]);
+      unsigned long long below = histogram.CountAtOrBelow(latencyBounds[b]);
+      writeValue(out, "scytl_latency_seconds_bucket", stage + le, (double)(below < count ? below : count));
+    }
+    writeValue(out, "scytl_latency_seconds_bucket", stage + ",le=\"+Inf\"", (double)count);
+    writeValue(out, "scytl_latency_seconds_sum", stage, histogram.Sum());
+    writeValue(out, "scytl_latency_seconds_count", stage, (double)count);
+  }
+
+  writeHeader(out, "scytl_pool_peak_bytes", "gauge", "Most memory the DOM node pool held at once in the latest read.");
+  for (int i = 0; i < POOLS; ++i)
+    writeValue(out, "scytl_pool_peak_bytes", string("pool=\"") + poolNames[i] + "\"",
+               (double)poolPeakBytes[i].load(memory_order_relaxed));
+  writeHeader(out, "scytl_pool_block_bytes", "gauge", "Memory the DOM node pool allocated in the latest read.");
+  for (int i = 0; i < POOLS; ++i)
+    writeValue(out, "scytl_pool_block_bytes", string("pool=\"") + poolNames[i] + "\"",
+               (double)poolBlockBytes[i].load(memory_order_relaxed));
+
+  writeHeader(out, "scytl_cache_requests_total", "counter", "Queries answered from the response cache (hit) or rendered (miss).");
+  for (int i = 0; i < SERVERS; ++i)
+  {
+    writeValue(out, "scytl_cache_requests_total", string("server=\"") + serverNames[i] + "\",result=\"hit\"",
+               (double)cacheHits[i].load(memory_order_relaxed));
+    writeValue(out, "scytl_cache_requests_total", string("server=\"") + serverNames[i] + "\",result=\"miss\"",
+               (double)cacheMisses[i].load(memory_order_relaxed));
+  }
+
+  writeHeader(out, "scytl_reload_queue", "gauge", "Workbooks written that are waiting to be reloaded.");
+  writeValue(out, "scytl_reload_queue", "", (double)reloadQueue.load(memory_order_relaxed));
+  writeHeader(out, "scytl_connections", "gauge", "Open client connections.");
+  for (int i = 0; i < SERVERS; ++i)
+    writeValue(out, "scytl_connections", string("server=\"") + serverNames[i] + "\"",
+               (double)connections[i].load(memory_order_relaxed));
+  writeHeader(out, "scytl_change_subscribers", "gauge", "Clients subscribed to /changes.");
+  writeValue(out, "scytl_change_subscribers", "", (double)subscribers.load(memory_order_relaxed));
+  writeHeader(out, "scytl_change_subscribers_behind", "gauge",
+              "Subscribers still reading an older event when the latest reload was announced.");
+  writeValue(out, "scytl_change_subscribers_behind", "", (double)subscribersBehind.load(memory_order_relaxed));
+}
+
+int CScytlMetrics::WriteFile(const string &filename) const
+{
+  string temporary = filename + ".tmp";
+  ofstream out(temporary.c_str());
+  if (!out) {
+    cout << "Error: can't create <" << temporary << ">" << endl;
+    return 1;
+  }
+  Write(out);
+  out.close();
+  if (!out || rename(temporary.c_str(), filename.c_str()) != 0) {
+    cout << "Error writing <" << filename << ">" << endl;
+    remove(temporary.c_str());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,101 @@
+#ifndef SCYTL_METRICS_INCLUDED
+#define SCYTL_METRICS_INCLUDED
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include <atomic>
+
+#include "scytl-stats.h"
+#include "scytl-histogram.h"
+
+// Counters and gauges for monitoring a reader that runs for days, written in
+// the Prometheus text exposition format: what was ingested and parsed, which
+// worksheets failed, latency histograms (see CLatencyHistogram), the DOM
+// pools' watermarks, the servers' response cache hits and how much is queued
+// up. Every update is a relaxed atomic, so the readers' worker threads and
+// the server loops never wait on each other or on whoever is scraping.
+//
+// Example:
+//
+//  CScytlMetrics metrics;
+//  metrics.AddLatency("reload", &reloadLatency);
+//  reader.SetMetrics(&metrics);
+//  ...
+//  metrics.WriteFile("scytl.prom");
+class CScytlMetrics
+{
+public:
+  // the part of a workbook a failed Read() was at
+  enum EWorksheetKind
+  {
+    Workbook,           // loading it, or finding the worksheets
+    Properties,
+    TableOfContents,
+    RegisteredVoters,
+    ElectionResults,
+    WORKSHEET_KINDS
+  };
+
+  enum EServer
+  {
+    Http,
+    Socket,
+    SERVERS
+  };
+
+  CScytlMetrics();
+
+  // expose 'histogram' as scytl_latency_seconds{stage="<stage>"}. call
+  // before anything is written; the histogram must outlive us.
+  void AddLatency(const std::string &stage, const CLatencyHistogram *histogram);
+
+  // a successful Read() of 'bytes', of which 'parsedBytes' in
+  // 'worksheetsParsed' worksheets had changed and were parsed
+  void Ingested(unsigned long long bytes, unsigned long long parsedBytes, int worksheetsParsed);
+  void ParseError(EWorksheetKind kind);
+
+  // the node pools of the latest Read() (see CReadStats::ReadPools())
+  void SetPools(const std::vector<CPoolStats> &pools);
+
+  void CacheLookup(EServer server, bool hit);
+
+  // queue depths. the changes are added, so each side can count its own.
+  void AddReloadQueue(long long workbooks) { reloadQueue.fetch_add(workbooks, std::memory_order_relaxed); }
+  void AddConnections(EServer server, long long count) { connections[server].fetch_add(count, std::memory_order_relaxed); }
+  void SetSubscribers(long long count) { subscribers.store(count, std::memory_order_relaxed); }
+  void SetSubscribersBehind(long long count) { subscribersBehind.store(count, std::memory_order_relaxed); }
+
+  void Write(std::ostream &out) const;
+
+  // write to a file next to 'filename' and rename it into place, so a
+  // collector never sees half of it. returns 1 on failure.
+  int WriteFile(const std::string &filename) const;
+
+private:
+  CScytlMetrics(const CScytlMetrics &);   // not supported
+  void operator=(const CScytlMetrics &);  // not supported
+
+  enum { POOLS = 4 };
+
+  std::atomic<unsigned long long> filesIngested;
+  std::atomic<unsigned long long> bytesRead;
+  std::atomic<unsigned long long> bytesParsed;
+  std::atomic<unsigned long long> worksheetsParsed;
+  std::atomic<unsigned long long> parseErrors[WORKSHEET_KINDS];
+
+  std::atomic<long long> poolPeakBytes[POOLS];
+  std::atomic<long long> poolBlockBytes[POOLS];
+
+  std::atomic<unsigned long long> cacheHits[SERVERS];
+  std::atomic<unsigned long long> cacheMisses[SERVERS];
+
+  std::atomic<long long> reloadQueue;
+  std::atomic<long long> connections[SERVERS];
+  std::atomic<long long> subscribers;
+  std::atomic<long long> subscribersBehind;
+
+  TLatencies latencies;
+};
+
+#endif // SCYTL_METRICS_INCLUDED
@@ -0,0 +1,85 @@
+#include <string>
+#include <list>
+#include <vector>
+#include <set>
+#include <map>
+#include <memory>
+
+#include "scytl-model.h"
+
+using namespace std;
+
+CResultsModel *CModelBuilder::Build(const CScytlReader &reader)
+{
+  CResultsModel *model = new CResultsModel;
+  model->Filename = reader.Filename();
+  model->Version = ++version;
+  model->DocumentProperties = reader.DocumentProperties();
+  model->RegionProfiles.assign(reader.RegionProfiles().begin(), reader.RegionProfiles().end());
+
+  // Read() hands back the very same CElection objects for contests it didn't
+  // touch, so the reader's addresses tell us what we can share. check the
+  // changed set first: a new contest may live where a freed one used to.
+  set<const CElection *> changed(reader.ChangedResults().begin(), reader.ChangedResults().end());
+
+  // the region index is built once per load, and joins are only redone for
+  // contests that changed, unless the profiles themselves did
+  model->Regions.Build(model->RegionProfiles);
+  bool sameProfiles = profiles.size() == model->RegionProfiles.size();
+  for (size_t i = 0; sameProfiles && i < profiles.size(); ++i)
+  {
+    const CRegionProfile &a = profiles[i];
+    const CRegionProfile &b = model->RegionProfiles[i];
+    sameProfiles = a.RegionName == b.RegionName && a.RegisteredVoters == b.RegisteredVoters &&
+                   a.BallotsCast == b.BallotsCast;
+  }
+
+  map<const CElection *, CShared> next;
+  const list<CElection> &elections = reader.ElectionResults();
+  model->Elections.reserve(elections.size());
+  model->Columns.reserve(elections.size());
+  model->Joins.reserve(elections.size());
+  model->Leaders.reserve(elections.size());
+  for (list<CElection>::const_iterator it = elections.begin(); it != elections.end(); ++it)
+  {
+    CShared election;
+
+    map<const CElection *, CShared>::const_iterator itShared = shared.find(&*it);
+    if (!changed.count(&*it) && itShared != shared.end()) {
+      election = itShared->second;
+    } else {
+      election.Election = make_shared<CElection>(*it);
+      election.Columns = make_shared<CColumnarContest>(*it);
+
+      shared_ptr<CContestLeaders> leaders = make_shared<CContestLeaders>();
+      FindLeaders(*it, *election.Columns, *leaders);
+      election.Leaders = leaders;
+    }
+
+    if (!election.Join || !sameProfiles) {
+      shared_ptr<CRegionJoin> join = make_shared<CRegionJoin>();
+      JoinRegions(*election.Columns, model->Regions, model->RegionProfiles, *join);
+      election.Join = join;
+    }
+
+    next[&*it] = election;
+    model->Elections.push_back(election.Election);
+    model->Columns.push_back(election.Columns);
+    model->Joins.push_back(election.Join);
+    model->Leaders.push_back(election.Leaders);
+  }
+  shared.swap(next);
+  if (!sameProfiles)
+    profiles = model->RegionProfiles;
+
+  return model;
+}
+
+CResultsModel *CModelBuilder::Build(const shared_ptr<CLazyWorkbook> &workbook)
+{
+  CResultsModel *model = new CResultsModel;
+  model->Filename = workbook->Filename();
+  model->Version = ++version;
+  model->Workbook = workbook;
+  return model;
+}
@@ -0,0 +1,72 @@
+#ifndef SCYTL_MODEL_INCLUDED
+#define SCYTL_MODEL_INCLUDED
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+
+#include "scytl-reader.h"
+#include "scytl-aggregate.h"
+#include "scytl-join.h"
+#include "scytl-leaders.h"
+#include "scytl-lazy.h"
+
+// Read-only copy of one load of a workbook, built for long-running modes that
+// hand results to other threads while the next load is under way. Contests
+// that didn't change between loads are shared between consecutive models
+// rather than copied.
+class CResultsModel
+{
+public:
+  CResultsModel() : Version(0) {}
+
+  std::string Filename;
+  unsigned long long Version;    // goes up by one with every model built
+
+  CDocumentProperties DocumentProperties;
+  std::vector<CRegionProfile> RegionProfiles;
+  std::vector<std::shared_ptr<const CElection> > Elections;
+  std::vector<std::shared_ptr<const CColumnarContest> > Columns;   // one per contest, for aggregation
+  std::vector<std::shared_ptr<const CRegionJoin> > Joins;          // one per contest, rows to RegionProfiles
+  std::vector<std::shared_ptr<const CContestLeaders> > Leaders;    // one per contest
+
+  CRegionIndex Regions;          // RegionName -> index into RegionProfiles
+
+  // set instead of everything above but the Filename when contests are
+  // extracted as they're asked for (see CScytlIngest::SetLazy())
+  std::shared_ptr<CLazyWorkbook> Workbook;
+};
+
+// Turns successive loads from one CScytlReader into CResultsModels. Only the
+// contests that the last Read() extracted again are copied.
+class CModelBuilder
+{
+public:
+  CModelBuilder() : version(0) {}
+
+  CResultsModel *Build(const CScytlReader &reader);
+
+  // a model that only holds an opened 'workbook'
+  CResultsModel *Build(const std::shared_ptr<CLazyWorkbook> &workbook);
+
+private:
+  unsigned long long version;
+
+  class CShared
+  {
+  public:
+    std::shared_ptr<const CElection> Election;
+    std::shared_ptr<const CColumnarContest> Columns;
+    std::shared_ptr<const CRegionJoin> Join;
+    std::shared_ptr<const CContestLeaders> Leaders;
+  };
+
+  // reader's contest -> the copies handed out in the previous model
+  std::map<const CElection *, CShared> shared;
+
+  // the profiles the shared joins were made against
+  std::vector<CRegionProfile> profiles;
+};
+
+#endif // SCYTL_MODEL_INCLUDED
@@ -0,0 +1,149 @@
+#include <cstring>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include <atomic>
+
+#include "scytl-perf.h"
+
+using namespace std;
+
+CPerfSample CPerfSample::operator-(const CPerfSample &other) const
+{
+  CPerfSample difference;
+  difference.Instructions = Instructions - other.Instructions;
+  difference.Cycles = Cycles - other.Cycles;
+  difference.CacheMisses = CacheMisses - other.CacheMisses;
+  difference.BranchMisses = BranchMisses - other.BranchMisses;
+  return difference;
+}
+
+CPerfSample &CPerfSample::operator+=(const CPerfSample &other)
+{
+  Instructions += other.Instructions;
+  Cycles += other.Cycles;
+  CacheMisses += other.CacheMisses;
+  BranchMisses += other.BranchMisses;
+  return *this;
+}
+
+CPerfCounters::CPerfCounters()
+{
+  for (int i = 0; i < EVENTS; ++i)
+    fds[i] = -1;
+}
+
+CPerfCounters::~CPerfCounters()
+{
+#ifdef __linux__
+  for (int i = EVENTS - 1; i >= 0; --i)
+    if (fds[i] >= 0)
+      close(fds[i]);
+#endif
+}
+
+int CPerfCounters::Open()
+{
+#ifdef __linux__
+  if (fds[INSTRUCTIONS] >= 0)
+    return 0;
+
+  static const unsigned long long configs[EVENTS] = {
+    PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+  };
+
+  for (int i = 0; i < EVENTS; ++i)
+  {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = configs[i];
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    // this thread, any CPU. without instructions there's no group to join.
+    fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, i == INSTRUCTIONS ? -1 : fds[INSTRUCTIONS], 0);
+    if (fds[INSTRUCTIONS] < 0)
+      return 1;
+  }
+  return 0;
+#else
+  return 1;
+#endif
+}
+
+unsigned long long CPerfCounters::Instructions() const
+{
+  return Sample().Instructions;
+}
+
+CPerfSample CPerfCounters::Sample() const
+{
+  CPerfSample sample;
+#ifdef __linux__
+  if (fds[INSTRUCTIONS] < 0)
+    return sample;
+
+  // { nr, time enabled, time running, a value per member in the order they
+  // joined }
+  unsigned long long values[3 + EVENTS];
+  ssize_t length = read(fds[INSTRUCTIONS], values, sizeof(values));
+  if (length < (ssize_t)(3 * sizeof(values[0])) || values[2] == 0)
+    return sample;
+
+  double scale = (double)values[1] / values[2];
+  unsigned long long *counts[EVENTS] = {
+    &sample.Instructions, &sample.Cycles, &sample.CacheMisses, &sample.BranchMisses
+  };
+  unsigned long long n = 0;
+  for (int i = 0; i < EVENTS && n < values[0]; ++i)
+  {
+    if (fds[i] >= 0)
+      *counts[i] = (unsigned long long)(values[3 + n++] * scale);
+  }
+#endif
+  return sample;
+}
+
+static atomic<bool> counting(false);
+
+void SetPerfCounting(bool Enabled)
+{
+  counting.store(Enabled);
+}
+
+bool PerfCounting()
+{
+  return counting.load();
+}
+
+static CPerfCounters *threadCounters()
+{
+  // closed when the thread exits
+  static thread_local CPerfCounters counters;
+  static thread_local bool opened = false;
+  if (!opened) {
+    counters.Open();
+    opened = true;
+  }
+  return &counters;
+}
+
+CPerfSample ThreadPerfSample()
+{
+  if (!counting.load(memory_order_relaxed))
+    return CPerfSample();
+  return threadCounters()->Sample();
+}
+
+bool ThreadPerfAvailable()
+{
+  return counting.load(memory_order_relaxed) && threadCounters()->Available();
+}
@@ -0,0 +1,84 @@
+#ifndef SCYTL_PERF_INCLUDED
+#define SCYTL_PERF_INCLUDED
+
+// Hardware performance counters for the calling thread, user space only,
+// through perf_event_open(2): instructions retired, cycles, cache misses and
+// branch mispredictions, opened as one group so they all count over exactly
+// the same stretch of code. Counters are unavailable on anything but Linux,
+// and wherever the kernel won't hand them out (perf_event_paranoid, virtual
+// machines without a PMU, containers); Open() fails and everything reads 0.
+// A machine may have some of the events and not others, and those read 0 on
+// their own.
+//
+// Example:
+//
+//  CPerfCounters counters;
+//  counters.Open();
+//  CPerfSample before = counters.Sample();
+//  ...
+//  CPerfSample used = counters.Sample() - before;
+//  double ipc = used.Ipc();
+
+class CPerfSample
+{
+public:
+  CPerfSample() : Instructions(0), Cycles(0), CacheMisses(0), BranchMisses(0) {}
+
+  unsigned long long Instructions;
+  unsigned long long Cycles;
+  unsigned long long CacheMisses;     // last level cache
+  unsigned long long BranchMisses;
+
+  // instructions per cycle, 0 without cycles
+  double Ipc() const { return Cycles ? (double)Instructions / Cycles : 0; }
+
+  CPerfSample operator-(const CPerfSample &other) const;
+  CPerfSample &operator+=(const CPerfSample &other);
+};
+
+class CPerfCounters
+{
+public:
+  CPerfCounters();
+  ~CPerfCounters();
+
+  // returns 1 if the counters can't be used
+  int Open();
+  bool Available() const { return fds[INSTRUCTIONS] >= 0; }
+  bool HasCycles() const { return fds[CYCLES] >= 0; }
+  bool HasCacheMisses() const { return fds[CACHE_MISSES] >= 0; }
+  bool HasBranchMisses() const { return fds[BRANCH_MISSES] >= 0; }
+
+  // instructions retired since Open()
+  unsigned long long Instructions() const;
+
+  // every counter since Open(), scaled up for the time it spent multiplexed
+  // out if the PMU couldn't fit the group
+  CPerfSample Sample() const;
+
+private:
+  CPerfCounters(const CPerfCounters &);   // not supported
+  void operator=(const CPerfCounters &);  // not supported
+
+  enum
+  {
+    INSTRUCTIONS, CYCLES, CACHE_MISSES, BRANCH_MISSES,
+    EVENTS
+  };
+
+  int fds[EVENTS];    // perf event fds, -1 if not open. the first is the leader.
+};
+
+// Counters for whichever thread asks, for instrumentation spread over
+// threads that come and go (see CPhaseClock). Off until SetPerfCounting(true);
+// after that each thread opens its own group on its first sample.
+void SetPerfCounting(bool Enabled);
+bool PerfCounting();
+
+// the calling thread's counters so far, all 0 while counting is off
+CPerfSample ThreadPerfSample();
+
+// whether the calling thread got any counters
+bool ThreadPerfAvailable();
+
+#endif // SCYTL_PERF_INCLUDED
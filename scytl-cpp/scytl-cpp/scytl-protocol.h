@@ -0,0 +1,64 @@
+#ifndef SCYTL_PROTOCOL_INCLUDED
+#define SCYTL_PROTOCOL_INCLUDED
+
+/*
+  Binary query protocol spoken over the Unix domain socket (--socket). It is
+  shared by the server and the C client library, so it must stay plain C.
+
+  Both ends live on the same host, so every integer is in host byte order and
+  the arrays in a response can be used in place once the response is read into
+  an 8-byte aligned buffer.
+
+  Request:    u32 length of the rest, u8 opcode, payload
+  Response:   u32 length of the rest, then the body:
+
+    offset 0    u32 status (SCYTL_STATUS_*)
+    offset 4    u32 reserved
+    offset 8    u64 version of the results model that answered
+    offset 16   payload
+
+  Payloads, by opcode:
+
+  SCYTL_OP_INFO               request:  nothing
+                              response: u32 contests, u32 regions
+
+  SCYTL_OP_CONTEST_BY_ID      request:  u32 contest id
+  SCYTL_OP_CONTEST_BY_NAME    request:  contest name (not terminated)
+                              response: u32 id, u32 rows, u32 columns, u32 label bytes,
+                                        i32 votes[columns][rows] (column-major),
+                                        labels (rows NUL terminated strings)
+
+  SCYTL_OP_REGION             request:  region name (not terminated)
+                              response: u32 count, u32 reserved,
+                                        u32 contests[count],
+                                        u32 offsets[count + 1],
+                                        i32 votes[offsets[count]]
+                              (contest i's row is votes[offsets[i]] .. votes[offsets[i+1]])
+
+  SCYTL_OP_AGGREGATES         request:  nothing
+                              response: u32 count, u32 reserved,
+                                        u32 offsets[count + 1], padding to 8 bytes,
+                                        i64 totals[offsets[count]]
+                              (contest i's totals are totals[offsets[i]] .. totals[offsets[i+1]])
+
+  Contest ids are the contests' positions in the workbook, starting at 0.
+
+  A server started with --lazy answers SCYTL_OP_REGION and SCYTL_OP_AGGREGATES
+  with SCYTL_STATUS_NOT_FOUND, and reports 0 regions.
+*/
+
+#define SCYTL_OP_INFO             0
+#define SCYTL_OP_CONTEST_BY_ID    1
+#define SCYTL_OP_CONTEST_BY_NAME  2
+#define SCYTL_OP_REGION           3
+#define SCYTL_OP_AGGREGATES       4
+
+#define SCYTL_STATUS_OK           0
+#define SCYTL_STATUS_NOT_FOUND    1
+#define SCYTL_STATUS_BAD_REQUEST  2
+#define SCYTL_STATUS_NOT_LOADED   3
+
+#define SCYTL_RESPONSE_HEADER     16
+#define SCYTL_MAX_REQUEST         4096
+
+#endif /* SCYTL_PROTOCOL_INCLUDED */
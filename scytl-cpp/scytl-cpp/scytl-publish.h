@@ -0,0 +1,182 @@
+#ifndef SCYTL_PUBLISH_INCLUDED
+#define SCYTL_PUBLISH_INCLUDED
+
+#include <cstddef>
+#include <vector>
+#include <utility>
+#include <atomic>
+#include <new>
+
+// Publishes immutable objects to any number of reader threads without locks.
+//
+// The writer builds a new T off to the side and hands it to Publish(), which
+// swaps it in with a single atomic exchange. Readers pin whatever is current
+// with a CReadGuard, which costs two stores to the reader's own slot and never
+// waits on the writer. Replaced objects are retired along with the epoch they
+// were replaced in, and deleted by Reclaim() once every reader that might still
+// be looking at them has moved on (epoch based reclamation).
+//
+// Publish() and Reclaim() must only be called from one thread at a time.
+template< class T >
+class CSnapshotPublisher
+{
+public:
+  class CReadGuard;
+
+  CSnapshotPublisher(int MaxReaders = 256)
+    : storage(new char[MaxReaders * sizeof(CSlot) + CacheLine]), slotCount(MaxReaders),
+      current(NULL), epoch(1)
+  {
+    // new[] only lines memory up for the basic types (before C++17), so the
+    // slots are placed on a cache line boundary by hand
+    slots = (CSlot *)(((size_t)storage + CacheLine - 1) & ~(size_t)(CacheLine - 1));
+    for (int i = 0; i < slotCount; ++i)
+    {
+      new (&slots[i]) CSlot;
+      slots[i].Epoch.store(0);
+      slots[i].InUse.store(false);
+    }
+  }
+
+  ~CSnapshotPublisher()
+  {
+    delete current.load();
+    for (size_t i = 0; i < retired.size(); ++i)
+      delete retired[i].second;
+    for (int i = 0; i < slotCount; ++i)
+      slots[i].~CSlot();
+    delete [] storage;
+  }
+
+  // make 'object' the current one and take ownership of it
+  void Publish(const T *object)
+  {
+    const T *old = current.exchange(object);
+    unsigned long long retiredIn = epoch.fetch_add(1);
+    if (old)
+      retired.push_back(std::make_pair(retiredIn, old));
+    Reclaim();
+  }
+
+  // delete every retired object that no reader can still see. returns how
+  // many are still waiting on a reader.
+  size_t Reclaim()
+  {
+    // a reader announces the epoch it entered in before it loads the current
+    // pointer, so an object retired in epoch E may still be in use by any
+    // reader whose announced epoch is <= E
+    unsigned long long oldest = 0;
+    for (int i = 0; i < slotCount; ++i)
+    {
+      unsigned long long e = slots[i].Epoch.load();
+      if (e && (!oldest || e < oldest))
+        oldest = e;
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < retired.size(); ++i)
+    {
+      if (oldest && retired[i].first >= oldest)
+        retired[kept++] = retired[i];
+      else
+        delete retired[i].second;
+    }
+    retired.resize(kept);
+    return kept;
+  }
+
+  // one per reader thread, held for as long as the thread wants to read
+  class CReader
+  {
+  public:
+    CReader(CSnapshotPublisher &Publisher)
+      : publisher(Publisher), slot(-1)
+    {
+      for (int i = 0; i < publisher.slotCount; ++i)
+      {
+        bool expected = false;
+        if (publisher.slots[i].InUse.compare_exchange_strong(expected, true)) {
+          slot = i;
+          break;
+        }
+      }
+    }
+
+    ~CReader()
+    {
+      if (slot >= 0) {
+        publisher.slots[slot].Epoch.store(0);
+        publisher.slots[slot].InUse.store(false);
+      }
+    }
+
+    // false if every slot was already taken
+    bool Valid() const { return slot >= 0; }
+
+  private:
+    friend class CReadGuard;
+
+    CReader(const CReader &);           // not supported
+    void operator=(const CReader &);    // not supported
+
+    CSnapshotPublisher &publisher;
+    int slot;
+  };
+
+  // pins the current object for the lifetime of the guard. guards don't
+  // nest; take one, look things up, and let it go.
+  class CReadGuard
+  {
+  public:
+    CReadGuard(CReader &Reader)
+      : reader(Reader), object(NULL)
+    {
+      if (reader.slot < 0)
+        return;
+      CSlot &slot = reader.publisher.slots[reader.slot];
+      slot.Epoch.store(reader.publisher.epoch.load());
+      object = reader.publisher.current.load();
+    }
+
+    ~CReadGuard()
+    {
+      if (reader.slot >= 0)
+        reader.publisher.slots[reader.slot].Epoch.store(0);
+    }
+
+    // NULL until something has been published
+    const T *Get() const { return object; }
+    const T *operator->() const { return object; }
+
+  private:
+    CReadGuard(const CReadGuard &);       // not supported
+    void operator=(const CReadGuard &);   // not supported
+
+    CReader &reader;
+    const T *object;
+  };
+
+private:
+  CSnapshotPublisher(const CSnapshotPublisher &);   // not supported
+  void operator=(const CSnapshotPublisher &);       // not supported
+
+  enum { CacheLine = 64 };
+
+  // each reader gets its own cache line, so readers never contend with each other
+  struct alignas(CacheLine) CSlot
+  {
+    std::atomic<unsigned long long> Epoch;    // 0 when not reading
+    std::atomic<bool> InUse;
+  };
+
+  char *storage;
+  CSlot *slots;
+  int slotCount;
+  std::atomic<const T *> current;
+  std::atomic<unsigned long long> epoch;
+
+  // writer only
+  std::vector<std::pair<unsigned long long, const T *> > retired;
+};
+
+#endif // SCYTL_PUBLISH_INCLUDED
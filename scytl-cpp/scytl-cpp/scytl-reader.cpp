@@ -0,0 +1,1284 @@
+#include <string>
+#include <list>
+#include <vector>
+#include <map>
+#include <iostream>
+#include <sstream>
+#include <utility>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+#include "scytl-reader.h"
+#include "scytl-validate.h"
+#include "scytl-index.h"
+#include "scytl-trace.h"
+
+using namespace std;
+using namespace tinyxml2;
+
+CScytlReader::CScytlReader(const string &Filename)
+  : filename(Filename), threads(1), stats(NULL), extractLatency(NULL), metrics(NULL), worksheetsParsed(0), contestIndexHash(0), sidecarSize(0), sidecarModified(0)
+{
+}
+
+CScytlReader::~CScytlReader()
+{
+}
+
+int CScytlReader::readDocumentProperties(const XMLElement *dp, CDocumentProperties &documentProperties)
+{
+  if (!dp)
+    return 1;
+
+  const XMLElement *title = dp->FirstChildElement("o:Title");
+  if (!title) return 1;
+  documentProperties.Title = title->GetText();
+
+  const XMLElement *author = dp->FirstChildElement("o:Author");
+  if (!author) return 1;
+  documentProperties.Author = author->GetText();
+
+  const XMLElement *created = dp->FirstChildElement("o:Created");
+  if (!created) return 1;
+  documentProperties.Created = created->GetText();
+
+  return 0;
+}
+
+int CScytlReader::readTableOfContentsWorksheet(const XMLElement *ws, list<TTocEntry> &toc)
+{
+  const XMLElement *table = ws->FirstChildElement("s:Table");
+  if (!table)
+    return 1;
+
+  const XMLElement *row;
+  for (row = table->FirstChildElement("s:Row"); row; row = row->NextSiblingElement())
+  {
+    // the Table of Contents entries we're interested in will have two cells on the same row,
+    // the first will be a Number and the second will be a String. anything else is not
+    // important to us and can be ignored.
+
+    // Example:
+    //
+    //  <s:Row>
+    //    <s:Cell s:StyleID="Page">
+    //      <s:Data s:Type="Number">1</s:Data>
+    //    </s:Cell>
+    //    <s:Cell>
+    //      <s:Data s:Type="String">Registered Voters</s:Data>
+    //    </s:Cell>
+    //  </s:Row>
+
+    const XMLElement *cell1 = row->FirstChildElement("s:Cell");
+    const XMLElement *cell2 = cell1 ? cell1->NextSiblingElement() : NULL;
+    if (!cell1 || !cell2)
+      continue;
+    {
+      const char *cellstyle = cell1->Attribute("s:StyleID");
+      if (!cellstyle || strcmp(cellstyle, "Page"))
+        continue;
+    }
+
+    const XMLElement *data1 = cell1->FirstChildElement("s:Data");
+    const XMLElement *data2 = cell2->FirstChildElement("s:Data");
+    if (!data1 || !data2)
+      continue;
+
+    if (strcmp(data1->Attribute("s:Type"), "Number") || 
+        strcmp(data2->Attribute("s:Type"), "String"))
+      continue;
+
+    int page;
+    if (data1->QueryIntText(&page) != XML_SUCCESS)
+      continue;
+
+    string contest = data2->GetText();
+
+    toc.push_back(TTocEntry(page, contest));
+  }
+
+  return 0;
+}
+
+int CScytlReader::readRegisteredVotersWorksheet(const XMLElement *ws, list<CRegionProfile> &regionProfiles)
+{
+  const XMLElement *table = ws->FirstChildElement("s:Table");
+  if (!table)
+    return 1;
+
+  // the first row contains our header
+
+  // Example:
+  //
+  //  <s:Row>
+  //    <s:Cell>
+  //      <s:Data s:Type="String">County</s:Data>
+  //    </s:Cell>
+  //    <s:Cell>
+  //      <s:Data s:Type="String">Registered Voters</s:Data>
+  //    </s:Cell>
+  //    <s:Cell>
+  //      <s:Data s:Type="String">Ballots Cast</s:Data>
+  //    </s:Cell>
+  //    <s:Cell>
+  //      <s:Data s:Type="String">Voter Turnout</s:Data>
+  //    </s:Cell>
+  //  </s:Row>
+
+  list<string> header;
+  const XMLElement *row = table->FirstChildElement("s:Row");
+  if (row)
+  {
+    for (const XMLElement *cell = row->FirstChildElement("s:Cell");
+         cell;
+         cell = cell->NextSiblingElement())
+    {
+      const XMLElement *data = cell->FirstChildElement("s:Data");
+      if (data)
+      {
+        const char *type = data->Attribute("s:Type");
+        if (!strcmp(type, "String"))
+          header.push_back(data->GetText());
+      }
+    }
+    row = row->NextSiblingElement();
+  }
+
+  // now, read in voter data one row at a time. because this is the
+  // registered voters page, we know what columns we should expect.
+
+  // Example:
+  //
+  //  <s:Row>
+  //    <s:Cell>
+  //      <s:Data s:Type="String">Arkansas</s:Data>
+  //    </s:Cell>
+  //    <s:Cell s:StyleID="VoteCount">
+  //      <s:Data s:Type="Number">9095</s:Data>
+  //    </s:Cell>
+  //    <s:Cell s:StyleID="VoteCount">
+  //      <s:Data s:Type="Number">1898</s:Data>
+  //    </s:Cell>
+  //    <s:Cell s:StyleID="VoteCount">
+  //      <s:Data s:Type="String">20.87 %</s:Data>
+  //    </s:Cell>
+  //  </s:Row>
+
+  for (;
+       row;
+       row = row->NextSiblingElement())
+  {
+    CRegionProfile profile;
+
+    const XMLElement *cell = row->FirstChildElement("s:Cell");
+
+    // read the region name (aka county/precinct name)
+    if (cell)
+    {
+      const XMLElement *data = cell->FirstChildElement("s:Data");
+      const char *type = data ? data->Attribute("s:Type") : NULL;
+      if (type && !strcmp(type, "String"))
+        profile.RegionName = data->GetText();
+      cell = cell->NextSiblingElement();
+    }
+
+    // Use header to determine remaining columns
+    list<string>::iterator itHeader = header.begin();
+    // ignore first header entry (County) because it may differ for precinct-level files
+    if (itHeader != header.end()) ++itHeader;
+
+    for (;
+         cell && itHeader != header.end();
+         cell = cell->NextSiblingElement(), ++itHeader)
+    {
+      const char *style = cell->Attribute("s:StyleID");
+      const XMLElement *data = cell->FirstChildElement("s:Data");
+      const char *type = data ? data->Attribute("s:Type") : NULL;
+
+      // we'll use the header name, the cell style, and the data type to verify file integrity
+      // and make sure we're reading from the correct column.
+      if (*itHeader == "Registered Voters"
+          && style && !strcmp(style, "VoteCount")
+          && type && !strcmp(type, "Number"))
+      {
+        if (data->QueryIntText(&profile.RegisteredVoters) != XML_SUCCESS)
+          return 1;
+      }
+      else if (*itHeader == "Ballots Cast"
+               && style && !strcmp(style, "VoteCount")
+               && type && !strcmp(type, "Number"))
+      {
+        if (data->QueryIntText(&profile.BallotsCast) != XML_SUCCESS)
+          return 1;
+      }
+      else if (*itHeader == "Voter Turnout"
+               && style && !strcmp(style, "VoteCount")
+               && type && !strcmp(type, "String"))
+      {
+        string turnout_str = data->GetText();
+        // truncate to remove the appended percent sign
+        istringstream buf(turnout_str.substr(0, turnout_str.length()-2));
+
+        // convert to double, and make sure we read the WHOLE string
+        buf >> profile.VoterTurnout;
+        if (buf.fail()) return 1;
+        buf.peek();
+        if (!buf.eof()) return 1;
+      }
+      else
+      {
+        cout << "Error: unrecognized column name in Registered Voters worksheet (header says '" << *itHeader << "')" << endl;
+        return 1;
+      }
+    }
+
+    // make sure we have the same number of headers and columns
+    if (cell || itHeader != header.end())
+      return 1;
+
+    regionProfiles.push_back(profile);
+  }
+
+  return 0;
+}
+
+int CScytlReader::readElectionResultsWorksheet(const XMLElement *ws, CElection &election)
+{
+  const XMLElement *table = ws->FirstChildElement("s:Table");
+  if (!table)
+    return 1;
+
+  // first row should contain our election name
+
+  // Example:
+  //
+  //  <s:Row>
+  //    <s:Cell s:MergeAcross="6" s:StyleID="headerLbl">
+  //      <s:Data s:Type="String">U.S. President - DEM</s:Data>
+  //    </s:Cell>
+  //  </s:Row>
+
+  const XMLElement *row = table->FirstChildElement("s:Row");
+  {
+    const XMLElement *cell = row ? row->FirstChildElement("s:Cell") : NULL;
+    const XMLElement *data = cell ? cell->FirstChildElement("s:Data") : NULL;
+    const char *style = cell ? cell->Attribute("s:StyleID") : NULL;
+    const char *type = data ? data->Attribute("s:Type") : NULL;
+    if (style && !strcmp(style, "headerLbl") &&
+        type && !strcmp(type, "String"))
+    {
+      election.ElectionName = data->GetText();
+
+      // use MergeAcross to determine how many columns there are
+      // so we can allocate the header's vector
+      int mergeacross = 0;
+      cell->QueryIntAttribute("s:MergeAcross", &mergeacross);
+      election.Header.resize(mergeacross + 1);
+
+      row = row->NextSiblingElement();
+    }
+    else return 1;
+  }
+
+  // next row has candidate names. be careful about the "MergeAcross" attribute.
+
+  // Example:
+  //
+  //  <s:Row>
+  //    <s:Cell>
+  //      <s:Data s:Type="String"/>
+  //    </s:Cell>
+  //    <s:Cell>
+  //      <s:Data s:Type="String"/>
+  //    </s:Cell>
+  //    <s:Cell s:MergeAcross="1">
+  //      <s:Data s:Type="String">John Wolfe</s:Data>
+  //    </s:Cell>
+  //    <s:Cell s:MergeAcross="1">
+  //      <s:Data s:Type="String">Barack Obama</s:Data>
+  //    </s:Cell>
+  //    <s:Cell>
+  //      <s:Data s:Type="String"/>
+  //    </s:Cell>
+  //  </s:Row>
+
+  {
+    vector<CElectionHeader>::iterator itHeader = election.Header.begin();
+    const XMLElement *cell = row ? row->FirstChildElement("s:Cell") : NULL;
+    for (;
+         cell && itHeader != election.Header.end();
+         cell = cell->NextSiblingElement())
+    {
+      const XMLElement *data = cell ? cell->FirstChildElement("s:Data") : NULL;
+      int mergeacross = 0;
+      cell->QueryIntAttribute("s:MergeAcross", &mergeacross);
+
+      for (int i = 0;
+           i <= mergeacross && itHeader != election.Header.end();
+           ++i, ++itHeader)
+      {
+        if (data && data->GetText())
+          itHeader->CandidateName = data->GetText();
+      }
+    }
+
+    // make sure we used the right number of columns
+    if (cell || itHeader != election.Header.end())
+      return 1;
+
+    row = row->NextSiblingElement();
+  }
+
+  // the next row has column names
+
+  // Example:
+  //
+  //  <s:Row>
+  //    <s:Cell>
+  //      <s:Data s:Type="String">County</s:Data>
+  //    </s:Cell>
+  //    <s:Cell>
+  //      <s:Data s:Type="String">Registered Voters</s:Data>
+  //    </s:Cell>
+  //    <s:Cell>
+  //      <s:Data s:Type="String">Election Day</s:Data>
+  //    </s:Cell>
+  //    <s:Cell>
+  //      <s:Data s:Type="String">Total Votes</s:Data>
+  //    </s:Cell>
+  //    <s:Cell>
+  //      <s:Data s:Type="String">Election Day</s:Data>
+  //    </s:Cell>
+  //    <s:Cell>
+  //      <s:Data s:Type="String">Total Votes</s:Data>
+  //    </s:Cell>
+  //    <s:Cell>
+  //      <s:Data s:Type="String">Total</s:Data>
+  //    </s:Cell>
+  //  </s:Row>
+
+  {
+    vector<CElectionHeader>::iterator itHeader = election.Header.begin();
+    const XMLElement *cell = row ? row->FirstChildElement("s:Cell") : NULL;
+    for (;
+         cell && itHeader != election.Header.end();
+         cell = cell->NextSiblingElement(), ++itHeader)
+    {
+      const XMLElement *data = cell->FirstChildElement("s:Data");
+      const char *type = data ? data->Attribute("s:Type") : NULL;
+
+      if (type && !strcmp(type, "String") && data->GetText())
+        itHeader->ColumnName = data->GetText();
+      else
+        return 1;
+    }
+
+    // make sure we used the right number of columns
+    if (cell || itHeader != election.Header.end())
+      return 1;
+
+    row = row->NextSiblingElement();
+  }
+
+  // the rest of the rows are voter data
+
+  // Example:
+  //
+  //  <s:Row>
+  //    <s:Cell>
+  //      <s:Data s:Type="String">Arkansas</s:Data>
+  //    </s:Cell>
+  //    <s:Cell s:StyleID="VoteCount">
+  //      <s:Data s:Type="Number">0</s:Data>
+  //    </s:Cell>
+  //    <s:Cell s:StyleID="VoteCount">
+  //      <s:Data s:Type="Number">508</s:Data>
+  //    </s:Cell>
+  //    <s:Cell s:StyleID="VoteCount">
+  //      <s:Data s:Type="Number">508</s:Data>
+  //    </s:Cell>
+  //    <s:Cell s:StyleID="VoteCount">
+  //      <s:Data s:Type="Number">599</s:Data>
+  //    </s:Cell>
+  //    <s:Cell s:StyleID="VoteCount">
+  //      <s:Data s:Type="Number">599</s:Data>
+  //    </s:Cell>
+  //    <s:Cell s:StyleID="VoteCount">
+  //      <s:Data s:Type="Number">1107</s:Data>
+  //    </s:Cell>
+  //  </s:Row>
+
+  for (;
+       row;
+       row = row->NextSiblingElement())
+  {
+    CLabeledTuple tuple;
+
+    // the first cell is the label (a string)
+    const XMLElement *cell = row->FirstChildElement("s:Cell");
+    {
+      const XMLElement *data = cell ? cell->FirstChildElement("s:Data") : NULL;
+      const char *type = data ? data->Attribute("s:Type") : NULL;
+      if (type && !strcmp(type, "String"))
+        tuple.Label = data->GetText();
+      else return 1;
+
+      cell = cell->NextSiblingElement();
+    }
+
+    // the remaining cells are vote counts (integers)
+    for (;
+         cell;
+         cell = cell->NextSiblingElement())
+    {
+      const XMLElement *data = cell ? cell->FirstChildElement("s:Data") : NULL;
+      const char *style = cell ? cell->Attribute("s:StyleID") : NULL;
+      const char *type = data ? data->Attribute("s:Type") : NULL;
+      if (style && !strcmp(style, "VoteCount") && type && !strcmp(type, "Number"))
+      {
+        int value;
+        if (data->QueryIntText(&value) != XML_SUCCESS)
+          return 1;
+        tuple.Data.push_back(value);
+      } else return 1;
+    }
+
+    // make sure our tuple has the right length
+    if (tuple.Data.size() + 1 != election.Header.size())
+      return 1;
+
+    election.Results.push_back(tuple);
+  }
+
+  return 0;
+}
+
+unsigned long long CScytlReader::hashRange(const char *p, size_t length)
+{
+  // 64-bit FNV-1a. we only need to notice that a worksheet changed between two
+  // loads of the same file, so there's no need for anything stronger.
+  unsigned long long hash = 14695981039346656037ULL;
+  for (const char *end = p + length; p != end; ++p)
+  {
+    hash ^= (unsigned char)*p;
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+int CScytlReader::loadFile(vector<char> &buffer)
+{
+  FILE *fp = fopen(filename.c_str(), "rb");
+  if (!fp)
+    return 1;
+
+  fseek(fp, 0, SEEK_END);
+  long size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  if (size <= 0) {
+    fclose(fp);
+    return 1;
+  }
+
+  // keep the buffer null terminated so we can search it with strstr()
+  buffer.resize(size + 1);
+  size_t read = fread(&buffer[0], 1, size, fp);
+  fclose(fp);
+  if (read != (size_t)size)
+    return 1;
+  buffer[size] = 0;
+
+  return 0;
+}
+
+int CScytlReader::scanWorksheets(const vector<char> &buffer, vector<CWorksheetRange> &worksheets)
+{
+  // find the byte range of every <s:Worksheet> element without building a DOM.
+  // Scytl exports don't use CDATA or comments, so a plain text search is enough
+  // to find the element boundaries.
+
+  // Example:
+  //
+  //  <s:Worksheet s:Name="2">
+  //    <s:Table>
+  //      ...
+  //    </s:Table>
+  //  </s:Worksheet>
+
+  static const char startTag[] = "<s:Worksheet";
+  static const char endTag[] = "</s:Worksheet>";
+
+  const char *base = &buffer[0];
+  const char *p = base;
+  while ((p = strstr(p, startTag)) != NULL)
+  {
+    const char *tagEnd = p + strlen(startTag);
+
+    // make sure we didn't match a longer element name
+    if (*tagEnd != '>' && *tagEnd != '/' && !XMLUtil::IsWhiteSpace(*tagEnd)) {
+      p = tagEnd;
+      continue;
+    }
+
+    const char *gt = strchr(tagEnd, '>');
+    if (!gt)
+      return 1;
+
+    CWorksheetRange range;
+    range.Offset = p - base;
+
+    // pull the name out of the start tag
+    const char *name = strstr(tagEnd, "s:Name=");
+    if (name && name < gt) {
+      name += strlen("s:Name=");
+      char quote = *name++;
+      const char *nameEnd = strchr(name, quote);
+      if (!nameEnd || nameEnd > gt)
+        return 1;
+      range.Name.assign(name, nameEnd);
+    }
+
+    const char *end;
+    if (gt[-1] == '/') {
+      end = gt + 1;
+    } else {
+      end = strstr(gt, endTag);
+      // a missing end tag means the file is truncated (or still being written)
+      if (!end)
+        return 1;
+      end += strlen(endTag);
+    }
+
+    range.Length = end - p;
+    range.Hash = hashRange(p, range.Length);
+    worksheets.push_back(range);
+
+    p = end;
+  }
+
+  return 0;
+}
+
+const XMLElement *CScytlReader::parseRange(const vector<char> &buffer, size_t offset, size_t length, const char *element)
+{
+  return parseRange(doc, buffer, offset, length, element);
+}
+
+const XMLElement *CScytlReader::parseRange(XMLDocument &document, const vector<char> &buffer,
+                                           size_t offset, size_t length, const char *element)
+{
+  document.Parse(&buffer[offset], length);
+  if (document.Error()) {
+    document.PrintError();
+    return NULL;
+  }
+  return document.FirstChildElement(element);
+}
+
+void CScytlReader::describeWorksheet(const CWorksheetRange &sheet, const XMLElement *ws,
+                                     const CWorksheetMark &start, const CWorksheetMark &parsed, CWorksheetStats &sheetStats)
+{
+  CWorksheetMark extracted;
+  sheetStats.Name = sheet.Name;
+  sheetStats.Bytes = sheet.Length;
+  sheetStats.ParseSeconds = parsed.Seconds - start.Seconds;
+  sheetStats.ExtractSeconds = extracted.Seconds - parsed.Seconds;
+  sheetStats.ParseAllocs = parsed.Allocs - start.Allocs;
+  sheetStats.ExtractAllocs = extracted.Allocs - parsed.Allocs;
+  sheetStats.ParseCounters = parsed.Counters - start.Counters;
+  sheetStats.ExtractCounters = extracted.Counters - parsed.Counters;
+  sheetStats.Rows = 0;
+  sheetStats.Cells = 0;
+
+  const XMLElement *table = ws ? ws->FirstChildElement("s:Table") : NULL;
+  for (const XMLElement *row = table ? table->FirstChildElement("s:Row") : NULL; row; row = row->NextSiblingElement("s:Row"))
+  {
+    ++sheetStats.Rows;
+    for (const XMLElement *cell = row->FirstChildElement("s:Cell"); cell; cell = cell->NextSiblingElement("s:Cell"))
+      ++sheetStats.Cells;
+  }
+}
+
+int CScytlReader::extractContest(XMLDocument &document, const vector<char> &buffer,
+                                 const CWorksheetRange &sheet, CElection &election, CWorksheetStats *sheetStats)
+{
+  CWorksheetMark start;
+  CTraceSpan parsing("parse", sheet.Name);
+  const XMLElement *ws = parseRange(document, buffer, sheet.Offset, sheet.Length, "s:Worksheet");
+  parsing.End();
+  CWorksheetMark parsed;
+  CTraceSpan extracting("extract", sheet.Name);
+  if (!ws || readElectionResultsWorksheet(ws, election))
+    return 1;
+  ValidateTotals(election, election.Mismatches);
+  extracting.End();
+  if (extractLatency)
+    extractLatency->Record(CPhaseClock::WallNow() - parsed.Seconds);
+
+  if (sheetStats)
+    describeWorksheet(sheet, ws, start, parsed, *sheetStats);
+  return 0;
+}
+
+int CScytlReader::extractContests(const vector<char> &buffer, const vector<CWorksheetRange> &sheets,
+                                  const vector<size_t> &indices, const vector<CElection *> &elections)
+{
+  vector<CWorksheetStats> sheetStats(stats ? indices.size() : 0);
+
+  if (threads <= 1 || indices.size() <= 1)
+  {
+    for (size_t i = 0; i < indices.size(); ++i)
+      if (extractContest(doc, buffer, sheets[indices[i]], *elections[i], stats ? &sheetStats[i] : NULL))
+        return 1;
+    if (stats)
+      stats->Worksheets.insert(stats->Worksheets.end(), sheetStats.begin(), sheetStats.end());
+    return 0;
+  }
+
+  // worksheets are handed out one at a time, so a few big contests don't end
+  // up queued behind each other on one thread. every thread needs a DOM of
+  // its own; the buffer is only ever read.
+  atomic<size_t> next(0);
+  atomic<bool> failed(false);
+  vector<thread> workers;
+  size_t count = min((size_t)threads, indices.size());
+  vector<vector<CPoolStats> > pools(count);
+  vector<CAllocCounts> allocs(count);
+  vector<CPerfSample> counters(count);
+  for (size_t w = 0; w < count; ++w)
+  {
+    workers.push_back(thread([&, w]() {
+      SetTraceThreadName("contests");
+
+      // the DOM is gone before the count is taken, so freeing its blocks counts too
+      CAllocCounts before = ThreadAllocCounts();
+      CPerfSample countersBefore = ThreadPerfSample();
+      {
+        XMLDocument document;
+        for (size_t i = next++; i < indices.size() && !failed; i = next++)
+        {
+          if (extractContest(document, buffer, sheets[indices[i]], *elections[i], stats ? &sheetStats[i] : NULL)) {
+            failed = true;
+            break;
+          }
+        }
+        if (stats)
+          CReadStats::ReadPools(document, pools[w]);
+      }
+      allocs[w] = ThreadAllocCounts() - before;
+      counters[w] = ThreadPerfSample() - countersBefore;
+    }));
+  }
+  for (size_t w = 0; w < workers.size(); ++w)
+    workers[w].join();
+
+  if (failed)
+    return 1;
+  if (stats) {
+    stats->Worksheets.insert(stats->Worksheets.end(), sheetStats.begin(), sheetStats.end());
+    for (size_t w = 0; w < pools.size(); ++w)
+    {
+      stats->AddPools(pools[w]);
+      stats->AddWorkerAllocs(allocs[w]);
+      stats->AddWorkerCounters(counters[w]);
+    }
+  }
+  return 0;
+}
+
+int CScytlReader::Read()
+{
+  // the member DOM's pools count up over every Read(); the stats want just
+  // this one
+  vector<CPoolStats> poolsBefore;
+  if (stats) {
+    stats->Clear();
+    stats->Filename = filename;
+    stats->Threads = threads;
+    CReadStats::ReadPools(doc, poolsBefore);
+  }
+  CPhaseClock clock;
+  CTraceSpan reading("read", filename);
+
+  // stat first: if the file changes under us, the sidecar index is written
+  // with an older time and gets replaced next time round
+  unsigned long long fileSize = 0;
+  long long modified = 0;
+  StatWorkbook(filename, fileSize, modified);
+
+  vector<char> buffer;
+  CTraceSpan loading("load");
+  if (loadFile(buffer)) {
+    cout << "Error loading <" << filename << ">" << endl;
+    countError(CScytlMetrics::Workbook);
+    return 1;
+  }
+  loading.End();
+  if (stats) {
+    stats->Bytes = buffer.size() - 1;
+    stats->AddPhase("load", clock);
+    clock.Restart();
+  }
+
+  // locate root node
+  if (!strstr(&buffer[0], "<s:Workbook")) {
+    cout << "Couldn't find root s:Workbook node" << endl;
+    countError(CScytlMetrics::Workbook);
+    return 1;
+  }
+
+  vector<CWorksheetRange> sheets;
+  CTraceSpan scanning("scan");
+  if (scanWorksheets(buffer, sheets)) {
+    cout << "Error locating worksheets in <" << filename << ">" << endl;
+    countError(CScytlMetrics::Workbook);
+    return 1;
+  }
+  scanning.End();
+  if (stats) {
+    stats->AddPhase("scan", clock);
+    clock.Restart();
+  }
+
+  // read document properties. they're tiny, so we always read them again.
+  CDocumentProperties properties;
+  {
+    CTraceSpan span("properties");
+    static const char startTag[] = "<o:DocumentProperties";
+    static const char endTag[] = "</o:DocumentProperties>";
+    const char *begin = strstr(&buffer[0], startTag);
+    const char *end = begin ? strstr(begin, endTag) : NULL;
+    const XMLElement *dp = NULL;
+    if (end)
+      dp = parseRange(buffer, begin - &buffer[0], end + strlen(endTag) - begin, "o:DocumentProperties");
+    if (readDocumentProperties(dp, properties)) {
+      cout << "Error reading document properties" << endl;
+      countError(CScytlMetrics::Properties);
+      return 1;
+    }
+  }
+  if (stats) {
+    stats->AddPhase("properties", clock);
+    clock.Restart();
+  }
+
+  // match worksheets up with the ones from the previous load. a worksheet whose
+  // bytes hash the same as last time doesn't need to be parsed again.
+  map<string, size_t> previous;
+  for (size_t i = 0; i < worksheets.size(); ++i)
+    previous[worksheets[i].Name] = i;
+
+  vector<size_t> previousIndex(sheets.size(), worksheets.size());
+  for (size_t i = 0; i < sheets.size(); ++i)
+  {
+    map<string, size_t>::const_iterator it = previous.find(sheets[i].Name);
+    if (it != previous.end() &&
+        worksheets[it->second].Hash == sheets[i].Hash &&
+        worksheets[it->second].Length == sheets[i].Length)
+      previousIndex[i] = it->second;
+  }
+
+  int parsed = 0;
+
+  // build table of contents
+  size_t toc = 0;
+  while (toc < sheets.size() && sheets[toc].Name != "Table of Contents")
+    ++toc;
+  if (toc == sheets.size()) {
+    cout << "Error reading table of contents" << endl;
+    countError(CScytlMetrics::TableOfContents);
+    return 1;
+  }
+
+  list<TTocEntry> contents;
+  bool tocChanged = previousIndex[toc] == worksheets.size();
+  if (tocChanged)
+  {
+    CWorksheetMark start;
+    CTraceSpan parsing("parse", sheets[toc].Name);
+    const XMLElement *ws = parseRange(buffer, sheets[toc].Offset, sheets[toc].Length, "s:Worksheet");
+    parsing.End();
+    CWorksheetMark parsedAt;
+    CTraceSpan extracting("extract", sheets[toc].Name);
+    if (!ws || readTableOfContentsWorksheet(ws, contents)) {
+      cout << "Error reading table of contents" << endl;
+      countError(CScytlMetrics::TableOfContents);
+      return 1;
+    }
+    extracting.End();
+    if (extractLatency)
+      extractLatency->Record(CPhaseClock::WallNow() - parsedAt.Seconds);
+    ++parsed;
+    if (stats) {
+      stats->Worksheets.push_back(CWorksheetStats());
+      describeWorksheet(sheets[toc], ws, start, parsedAt, stats->Worksheets.back());
+    }
+  }
+  if (stats) {
+    stats->AddPhase("toc", clock);
+    clock.Restart();
+  }
+
+  // read registered voter info
+  size_t rv = toc;
+  while (rv < sheets.size() && sheets[rv].Name != "Registered Voters")
+    ++rv;
+  if (rv == sheets.size()) {
+    cout << "Error reading registered voters worksheet" << endl;
+    countError(CScytlMetrics::RegisteredVoters);
+    return 1;
+  }
+
+  list<CRegionProfile> profiles;
+  bool rvChanged = previousIndex[rv] == worksheets.size();
+  if (rvChanged)
+  {
+    CWorksheetMark start;
+    CTraceSpan parsing("parse", sheets[rv].Name);
+    const XMLElement *ws = parseRange(buffer, sheets[rv].Offset, sheets[rv].Length, "s:Worksheet");
+    parsing.End();
+    CWorksheetMark parsedAt;
+    CTraceSpan extracting("extract", sheets[rv].Name);
+    if (!ws || readRegisteredVotersWorksheet(ws, profiles)) {
+      cout << "Error reading registered voters worksheet" << endl;
+      countError(CScytlMetrics::RegisteredVoters);
+      return 1;
+    }
+    extracting.End();
+    if (extractLatency)
+      extractLatency->Record(CPhaseClock::WallNow() - parsedAt.Seconds);
+    ++parsed;
+    if (stats) {
+      stats->Worksheets.push_back(CWorksheetStats());
+      describeWorksheet(sheets[rv], ws, start, parsedAt, stats->Worksheets.back());
+    }
+  }
+  if (stats) {
+    stats->AddPhase("voters", clock);
+    clock.Restart();
+  }
+
+  // every worksheet after registered voters is a contest. the contests from the
+  // previous load line up with the worksheets after its registered voters page.
+  size_t firstContest = 0;
+  while (firstContest < worksheets.size() && worksheets[firstContest].Name != "Registered Voters")
+    ++firstContest;
+  ++firstContest;
+
+  vector<list<CElection>::iterator> previousContests;
+  for (list<CElection>::iterator it = electionResults.begin(); it != electionResults.end(); ++it)
+    previousContests.push_back(it);
+
+  // read election info. changed worksheets are extracted into 'fresh'; nothing
+  // from the previous load is touched until every worksheet has been read.
+  list<CElection> fresh;
+  vector<list<CElection>::iterator> contests;
+  vector<bool> reused;
+  vector<bool> claimed(previousContests.size(), false);
+  vector<size_t> changedSheets;
+  vector<CElection *> changedContests;
+  for (size_t i = rv + 1; i < sheets.size(); ++i)
+  {
+    size_t prev = previousIndex[i];
+    if (prev < worksheets.size() && prev >= firstContest &&
+        prev - firstContest < previousContests.size() &&
+        !claimed[prev - firstContest])
+    {
+      claimed[prev - firstContest] = true;
+      contests.push_back(previousContests[prev - firstContest]);
+      reused.push_back(true);
+      continue;
+    }
+
+    fresh.push_back(CElection());
+    changedSheets.push_back(i);
+    changedContests.push_back(&fresh.back());
+    contests.push_back(--fresh.end());
+    reused.push_back(false);
+  }
+
+  if (extractContests(buffer, sheets, changedSheets, changedContests)) {
+    cout << "Error reading election results worksheet" << endl;
+    countError(CScytlMetrics::ElectionResults);
+    return 1;
+  }
+  parsed += (int)changedSheets.size();
+
+  if (metrics) {
+    unsigned long long parsedBytes = 0;
+    if (tocChanged)
+      parsedBytes += sheets[toc].Length;
+    if (rvChanged)
+      parsedBytes += sheets[rv].Length;
+    for (size_t i = 0; i < changedSheets.size(); ++i)
+      parsedBytes += sheets[changedSheets[i]].Length;
+    metrics->Ingested(buffer.size() - 1, parsedBytes, parsed);
+  }
+  if (stats) {
+    stats->AddPhase("contests", clock);
+    clock.Restart();
+  }
+
+  // everything was read successfully, so commit the new state. unchanged
+  // contests are moved over from the previous load without being copied.
+  CTraceSpan committing("commit");
+  list<CElection> results;
+  vector<const CElection *> changed;
+  for (size_t i = 0; i < contests.size(); ++i)
+  {
+    if (!reused[i])
+      changed.push_back(&*contests[i]);
+    results.splice(results.end(), reused[i] ? electionResults : fresh, contests[i]);
+  }
+
+  documentProperties = properties;
+  if (tocChanged)
+    tableOfContents.swap(contents);
+  if (rvChanged)
+    regionProfiles.swap(profiles);
+  electionResults.swap(results);
+  worksheets.swap(sheets);
+  worksheetsParsed = parsed;
+
+  // whatever is left of the previous results was replaced or removed. hang
+  // on to it until the next Read() so callers can see what changed.
+  replacedResults.swap(results);
+  changedResults.swap(changed);
+
+  map<int, string> pages;
+  for (list<TTocEntry>::const_iterator it = tableOfContents.begin(); it != tableOfContents.end(); ++it)
+    pages[it->first] = it->second;
+  updateSidecar(worksheets, pages, fileSize, modified);
+
+  if (stats) {
+    stats->AddPhase("commit", clock);
+    vector<CPoolStats> pools;
+    CReadStats::ReadPools(doc, pools);
+    stats->AddPools(pools, &poolsBefore);
+    stats->Finish();
+  }
+
+  return 0;
+}
+
+int CScytlReader::readContestIndex(const vector<char> &buffer, const vector<CWorksheetRange> &sheets)
+{
+  size_t toc = 0;
+  while (toc < sheets.size() && sheets[toc].Name != "Table of Contents")
+    ++toc;
+  if (toc == sheets.size())
+    return 1;
+
+  if (!contestIndex.empty() && sheets[toc].Hash == contestIndexHash)
+    return 0;
+
+  list<TTocEntry> contents;
+  const XMLElement *ws = parseRange(buffer, sheets[toc].Offset, sheets[toc].Length, "s:Worksheet");
+  if (!ws || readTableOfContentsWorksheet(ws, contents))
+    return 1;
+
+  contestIndex.clear();
+  for (list<TTocEntry>::const_iterator it = contents.begin(); it != contents.end(); ++it)
+    contestIndex.insert(make_pair(it->second, it->first));
+  contestIndexHash = sheets[toc].Hash;
+  return 0;
+}
+
+int CScytlReader::LoadIndex(CWorkbookIndex &index, bool rebuild)
+{
+  string indexFile = IndexFilename(filename);
+  if (!rebuild && ReadIndex(indexFile, index) == 0 && IndexIsCurrent(filename, index))
+    return 0;
+
+  // stat first: if the file changes under us, the index is written with an
+  // older time and gets replaced next time round
+  unsigned long long fileSize = 0;
+  long long modified = 0;
+  StatWorkbook(filename, fileSize, modified);
+
+  vector<char> buffer;
+  vector<CWorksheetRange> sheets;
+  if (loadFile(buffer) || scanWorksheets(buffer, sheets) || readContestIndex(buffer, sheets)) {
+    cout << "Error reading table of contents of <" << filename << ">" << endl;
+    return 1;
+  }
+
+  map<int, string> pages;
+  for (map<string, int>::const_iterator it = contestIndex.begin(); it != contestIndex.end(); ++it)
+    pages[it->second] = it->first;
+  buildIndex(sheets, pages, fileSize, modified, index);
+
+  // not being able to write next to the workbook only costs us speed
+  if (WriteIndex(indexFile, index) == 0) {
+    sidecarSize = fileSize;
+    sidecarModified = modified;
+  }
+  return 0;
+}
+
+int CScytlReader::FindContests(const string &prefix, vector<pair<int,string> > &matches)
+{
+  CWorkbookIndex index;
+  if (LoadIndex(index))
+    return 1;
+
+  map<string, int> contests;
+  for (vector<CIndexEntry>::const_iterator it = index.Entries.begin(); it != index.Entries.end(); ++it)
+    if (it->Page >= 0)
+      contests.insert(make_pair(it->Contest, it->Page));
+
+  matches.clear();
+  for (map<string, int>::const_iterator it = contests.lower_bound(prefix);
+       it != contests.end() && it->first.compare(0, prefix.size(), prefix) == 0;
+       ++it)
+  {
+    matches.push_back(make_pair(it->second, it->first));
+  }
+  return 0;
+}
+
+int CScytlReader::lookupContest(const map<string, int> &contests, const string &contest, int &page)
+{
+  // a page number, an exact name, or the start of exactly one name
+  page = -1;
+  if (contest != "" && contest.find_first_not_of("0123456789") == string::npos) {
+    page = atoi(contest.c_str());
+    return 0;
+  }
+
+  map<string, int>::const_iterator it = contests.lower_bound(contest);
+  if (it == contests.end() || it->first.compare(0, contest.size(), contest) != 0) {
+    cout << "Couldn't find contest <" << contest << "> in <" << filename << ">" << endl;
+    return 1;
+  }
+
+  map<string, int>::const_iterator next = it;
+  ++next;
+  if (it->first != contest &&
+      next != contests.end() && next->first.compare(0, contest.size(), contest) == 0)
+  {
+    cout << "Contest <" << contest << "> is ambiguous" << endl;
+    return 1;
+  }
+
+  page = it->second;
+  return 0;
+}
+
+int CScytlReader::loadRange(unsigned long long offset, unsigned long long length, vector<char> &buffer)
+{
+  FILE *fp = fopen(filename.c_str(), "rb");
+  if (!fp)
+    return 1;
+
+  // check the range against the file before allocating for it: a bad index
+  // isn't allowed to ask for gigabytes
+  long size = fseek(fp, 0, SEEK_END) == 0 ? ftell(fp) : -1;
+  if (size < 0 || offset > (unsigned long long)size || length > (unsigned long long)size - offset) {
+    fclose(fp);
+    return 1;
+  }
+
+  buffer.resize((size_t)length + 1);
+  bool ok = fseek(fp, (long)offset, SEEK_SET) == 0 &&
+            fread(&buffer[0], 1, (size_t)length, fp) == (size_t)length;
+  fclose(fp);
+  buffer[(size_t)length] = 0;
+  return ok ? 0 : 1;
+}
+
+int CScytlReader::ReadIndexedContest(const CIndexEntry &entry, CElection &election)
+{
+  // the bytes have to hash the same as when the index was written, or the
+  // file was rewritten without its size or time changing
+  vector<char> buffer;
+  CTraceSpan loading("load", entry.Name);
+  if (loadRange(entry.Offset, entry.Length, buffer) ||
+      hashRange(&buffer[0], (size_t)entry.Length) != entry.Hash)
+    return 2;
+  loading.End();
+
+  CElection result;
+  CTraceSpan parsing("parse", entry.Name);
+  const XMLElement *ws = parseRange(buffer, 0, (size_t)entry.Length, "s:Worksheet");
+  parsing.End();
+  CTraceSpan extracting("extract", entry.Name);
+  if (!ws || readElectionResultsWorksheet(ws, result)) {
+    cout << "Error reading election results worksheet" << endl;
+    return 1;
+  }
+  ValidateTotals(result, result.Mismatches);
+  extracting.End();
+
+  election = result;
+  return 0;
+}
+
+int CScytlReader::ReadContest(const string &contest, CElection &election)
+{
+  // a stale index is rebuilt and tried once more
+  for (int attempt = 0; attempt < 2; ++attempt)
+  {
+    CWorkbookIndex index;
+    if (LoadIndex(index, attempt > 0))
+      return 1;
+
+    map<string, int> contests;
+    for (vector<CIndexEntry>::const_iterator it = index.Entries.begin(); it != index.Entries.end(); ++it)
+      if (it->Page >= 0)
+        contests.insert(make_pair(it->Contest, it->Page));
+
+    int page;
+    if (lookupContest(contests, contest, page))
+      return 1;
+
+    const CIndexEntry *entry = NULL;
+    for (vector<CIndexEntry>::const_iterator it = index.Entries.begin(); it != index.Entries.end() && !entry; ++it)
+      if (it->Page == page)
+        entry = &*it;
+    if (!entry) {
+      cout << "Couldn't find contest <" << contest << "> in <" << filename << ">" << endl;
+      return 1;
+    }
+
+    int result = ReadIndexedContest(*entry, election);
+    if (result != 2)
+      return result;
+  }
+
+  cout << "Error reading <" << filename << ">: it keeps changing" << endl;
+  return 1;
+}
+
+void CScytlReader::buildIndex(const vector<CWorksheetRange> &sheets, const map<int, string> &pages,
+                              unsigned long long size, long long modified, CWorkbookIndex &index)
+{
+  index.FileSize = size;
+  index.ModifiedTime = modified;
+  index.Entries.clear();
+  for (vector<CWorksheetRange>::const_iterator it = sheets.begin(); it != sheets.end(); ++it)
+  {
+    CIndexEntry entry;
+    entry.Name = it->Name;
+    entry.Page = -1;
+    entry.Offset = it->Offset;
+    entry.Length = it->Length;
+    entry.Hash = it->Hash;
+
+    // contest worksheets are named after their TOC page
+    if (it->Name != "" && it->Name.find_first_not_of("0123456789") == string::npos) {
+      map<int, string>::const_iterator itPage = pages.find(atoi(it->Name.c_str()));
+      if (itPage != pages.end()) {
+        entry.Page = itPage->first;
+        entry.Contest = itPage->second;
+      }
+    }
+    index.Entries.push_back(entry);
+  }
+}
+
+void CScytlReader::updateSidecar(const vector<CWorksheetRange> &sheets, const map<int, string> &pages,
+                                 unsigned long long size, long long modified)
+{
+  if (!size || (size == sidecarSize && modified == sidecarModified))
+    return;
+
+  string indexFile = IndexFilename(filename);
+  CWorkbookIndex index;
+  if (ReadIndex(indexFile, index) || index.FileSize != size || index.ModifiedTime != modified ||
+      index.Entries.size() != sheets.size())
+  {
+    buildIndex(sheets, pages, size, modified, index);
+
+    // not being able to write next to the workbook only costs us speed
+    if (WriteIndex(indexFile, index))
+      return;
+  }
+
+  sidecarSize = size;
+  sidecarModified = modified;
+}
+
+void CScytlReader::Print(ostream &out) const
+{
+  // document properties
+  out << "Title;" << documentProperties.Title << endl
+      << "Author;" << documentProperties.Author << endl
+      << "Created;" << documentProperties.Created << endl;
+
+  // table of contents
+  for (list<TTocEntry>::const_iterator tocIt = tableOfContents.begin();
+       tocIt != tableOfContents.end();
+       ++tocIt)
+  {
+    out << tocIt->first << ";" << tocIt->second << endl;
+  }
+
+  // registered voters
+  out << "County;Registered Voters;Ballots Cast;Voter Turnout" << endl;
+  for (list<CRegionProfile>::const_iterator itRegion = regionProfiles.begin();
+       itRegion != regionProfiles.end();
+       ++itRegion)
+  {
+    out << "  " << itRegion->RegionName << ";"
+                << itRegion->RegisteredVoters << ";"
+                << itRegion->BallotsCast << ";"
+                << itRegion->VoterTurnout << endl;
+  }
+
+  // election results
+  for (list<CElection>::const_iterator itElection = electionResults.begin();
+       itElection != electionResults.end();
+       ++itElection)
+  {
+    PrintElection(out, *itElection);
+  }
+}
+
+void CScytlReader::PrintElection(ostream &out, const CElection &election)
+{
+  out << election.ElectionName << endl;
+
+  PrintHeader(out, election.Header);
+
+  for (list<CLabeledTuple>::const_iterator itTuple = election.Results.begin();
+       itTuple != election.Results.end();
+       ++itTuple)
+  {
+    PrintTuple(out, *itTuple);
+  }
+}
+
+void CScytlReader::PrintHeader(ostream &out, const vector<CElectionHeader> &header)
+{
+  for (vector<CElectionHeader>::const_iterator itHeader = header.begin();
+       itHeader != header.end();
+       ++itHeader)
+  {
+    if (itHeader != header.begin())
+      out << ";";
+
+    if (itHeader->CandidateName != "")
+      out << itHeader->CandidateName << " - ";
+    out << itHeader->ColumnName;
+  }
+  out << endl;
+}
+
+void CScytlReader::PrintTuple(ostream &out, const CLabeledTuple &tuple)
+{
+  out << tuple.Label << ";";
+  for (vector<int>::const_iterator itData = tuple.Data.begin();
+       itData != tuple.Data.end();
+       ++itData)
+  {
+    if (itData != tuple.Data.begin())
+      out << ";";
+    out << *itData;
+  }
+  out << endl;
+}
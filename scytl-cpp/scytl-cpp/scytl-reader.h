@@ -0,0 +1,248 @@
+#ifndef SCYTL_READER_INCLUDED
+#define SCYTL_READER_INCLUDED
+
+#include <string>
+#include <list>
+#include <vector>
+#include <map>
+#include <iostream>
+#include <utility>
+
+#include "tinyxml2.h"
+#include "scytl-index.h"
+#include "scytl-stats.h"
+#include "scytl-metrics.h"
+
+class CDocumentProperties
+{
+public:
+  std::string Title;
+  std::string Author;
+  std::string Created;
+};
+
+class CRegionProfile
+{
+public:
+  std::string RegionName;
+  int RegisteredVoters;
+  int BallotsCast;
+  double VoterTurnout;
+};
+
+class CLabeledTuple
+{
+public:
+  std::string Label;
+  std::vector<int> Data;
+};
+
+class CElectionHeader
+{
+public:
+  std::string ColumnName;
+  std::string CandidateName;
+};
+
+// Scytl closes every worksheet with a summary row ("Total:" on the registered
+// voters page, "Totals:" on contest pages). it isn't a region.
+inline bool IsTotalsLabel(const std::string &label)
+{
+  return label == "Totals:" || label == "Total:";
+}
+
+// a row whose redundant totals don't add up. Column is the CElectionHeader
+// index of the total that is wrong.
+class CTotalsMismatch
+{
+public:
+  std::string Region;
+  int Column;
+  int Expected;
+  int Actual;
+};
+
+class CElection
+{
+public:
+  std::string ElectionName;
+  std::vector<CElectionHeader> Header;
+  std::list<CLabeledTuple> Results;
+
+  // filled in by CScytlReader as the contest is extracted
+  std::vector<CTotalsMismatch> Mismatches;
+};
+
+// location of one <s:Worksheet> element inside the raw workbook, along with a
+// hash of its bytes so that a reload can tell which worksheets actually changed.
+class CWorksheetRange
+{
+public:
+  std::string Name;
+  size_t Offset;
+  size_t Length;
+  unsigned long long Hash;
+};
+
+class CScytlReader
+{
+public:
+  CScytlReader(const std::string &Filename);
+  ~CScytlReader();
+
+  // (re)load the workbook. on a reload, only worksheets whose bytes changed since
+  // the last successful Read() are parsed again; everything else is kept as-is.
+  // on failure the results of the previous successful Read() are left untouched.
+  int Read();
+
+  // extract a single contest, found through the table of contents, without
+  // touching any other contest worksheet. with an up to date sidecar index
+  // (see scytl-index.h) only that worksheet is read from disk at all. 'contest' is either a TOC page
+  // number or a contest name; a name that isn't an exact match may be the
+  // start of exactly one contest's name. independent of Read().
+  //
+  // Example:
+  //
+  //  fin.ReadContest("3", election);
+  //  fin.ReadContest("U.S. President - REP", election);
+  //  fin.ReadContest("U.S. President - R", election);
+  int ReadContest(const std::string &contest, CElection &election);
+
+  // (page, name) of every contest whose name starts with 'prefix', in name
+  // order. only the table of contents is parsed.
+  int FindContests(const std::string &prefix, std::vector<std::pair<int,std::string> > &matches);
+
+  // the sidecar index for the workbook, built and written first if there
+  // isn't a current one (or 'rebuild' says not to trust it)
+  int LoadIndex(CWorkbookIndex &index, bool rebuild = false);
+
+  // extract the contest worksheet an index entry points at. returns 2 if the
+  // bytes there aren't the ones that were indexed.
+  int ReadIndexedContest(const CIndexEntry &entry, CElection &election);
+
+  // extract the contest worksheets a Read() finds changed on up to 'Threads'
+  // threads, each with its own DOM. 1 (the default) extracts them one after
+  // another on the calling thread.
+  void SetThreads(int Threads) { threads = Threads < 1 ? 1 : Threads; }
+  int Threads() const { return threads; }
+
+  // fill in 'Stats' on every Read() from now on (NULL to stop). the stats are
+  // cleared at the start of each Read().
+  void SetStats(CReadStats *Stats) { stats = Stats; }
+
+  // record how long every worksheet parsed from now on took to extract
+  // (NULL to stop). recorded from the extracting threads as they go, so the
+  // histogram can be shared with other readers.
+  void SetExtractLatency(CLatencyHistogram *Histogram) { extractLatency = Histogram; }
+
+  // count what every Read() from now on ingests, and where it fails (NULL to
+  // stop)
+  void SetMetrics(CScytlMetrics *Metrics) { metrics = Metrics; }
+
+  // the state of the DOM node pools (see CReadStats::ReadPools()). worksheets
+  // extracted on other threads had DOMs of their own.
+  void ReadPools(std::vector<CPoolStats> &pools) const { CReadStats::ReadPools(doc, pools); }
+
+  // dump everything we've read as semicolon separated text
+  void Print(std::ostream &out) const;
+
+  // one line of Print() output: a contest's column headings, or one region's row
+  static void PrintHeader(std::ostream &out, const std::vector<CElectionHeader> &header);
+  static void PrintTuple(std::ostream &out, const CLabeledTuple &tuple);
+  static void PrintElection(std::ostream &out, const CElection &election);
+
+  const std::string &Filename() const { return filename; }
+  const CDocumentProperties &DocumentProperties() const { return documentProperties; }
+  const std::list<CRegionProfile> &RegionProfiles() const { return regionProfiles; }
+  const std::list<CElection> &ElectionResults() const { return electionResults; }
+
+  // number of worksheets that were parsed (rather than reused) by the last Read()
+  int WorksheetsParsed() const { return worksheetsParsed; }
+
+  // contests that were extracted again by the last Read(), and the previous
+  // versions of every contest that was replaced or dropped from the workbook
+  const std::vector<const CElection *> &ChangedResults() const { return changedResults; }
+  const std::list<CElection> &ReplacedResults() const { return replacedResults; }
+
+protected:
+  typedef std::pair<int,std::string> TTocEntry;
+
+  int readDocumentProperties(const tinyxml2::XMLElement *dp, CDocumentProperties &documentProperties);
+  int readTableOfContentsWorksheet(const tinyxml2::XMLElement *ws, std::list<TTocEntry> &toc);
+  int readRegisteredVotersWorksheet(const tinyxml2::XMLElement *ws, std::list<CRegionProfile> &regionProfiles);
+  int readElectionResultsWorksheet(const tinyxml2::XMLElement *ws, CElection &election);
+
+  int loadFile(std::vector<char> &buffer);
+  int scanWorksheets(const std::vector<char> &buffer, std::vector<CWorksheetRange> &worksheets);
+  const tinyxml2::XMLElement *parseRange(const std::vector<char> &buffer, size_t offset, size_t length, const char *element);
+  static const tinyxml2::XMLElement *parseRange(tinyxml2::XMLDocument &document, const std::vector<char> &buffer,
+                                                size_t offset, size_t length, const char *element);
+
+  // parse, extract and validate sheets[indices[i]] into *elections[i], on up
+  // to 'threads' threads
+  int extractContests(const std::vector<char> &buffer, const std::vector<CWorksheetRange> &sheets,
+                      const std::vector<size_t> &indices, const std::vector<CElection *> &elections);
+
+  // one of those, timed into 'sheetStats' if it isn't NULL
+  int extractContest(tinyxml2::XMLDocument &document, const std::vector<char> &buffer,
+                     const CWorksheetRange &sheet, CElection &election, CWorksheetStats *sheetStats);
+
+  // the stats of a worksheet that has just been extracted, parsing it having
+  // started at 'start' and finished at 'parsed'
+  static void describeWorksheet(const CWorksheetRange &sheet, const tinyxml2::XMLElement *ws,
+                                const CWorksheetMark &start, const CWorksheetMark &parsed, CWorksheetStats &sheetStats);
+
+  // a Read() that failed at 'kind', with SetMetrics()
+  void countError(CScytlMetrics::EWorksheetKind kind) { if (metrics) metrics->ParseError(kind); }
+
+  static unsigned long long hashRange(const char *p, size_t length);
+
+  // bring contestIndex up to date with the workbook's table of contents
+  int readContestIndex(const std::vector<char> &buffer, const std::vector<CWorksheetRange> &sheets);
+
+  // find 'contest' (a page number, or a name or unique prefix) in a name -> page map
+  int lookupContest(const std::map<std::string, int> &contests, const std::string &contest, int &page);
+
+  // read just [offset, offset + length) of the workbook, null terminated
+  int loadRange(unsigned long long offset, unsigned long long length, std::vector<char> &buffer);
+
+  // describe 'sheets' as a sidecar index. pages maps TOC pages to contest names.
+  static void buildIndex(const std::vector<CWorksheetRange> &sheets, const std::map<int, std::string> &pages,
+                         unsigned long long size, long long modified, CWorkbookIndex &index);
+
+  // (re)write the sidecar index unless it already describes this version of
+  // the workbook
+  void updateSidecar(const std::vector<CWorksheetRange> &sheets, const std::map<int, std::string> &pages,
+                     unsigned long long size, long long modified);
+
+private:
+  std::string filename;
+  tinyxml2::XMLDocument doc;
+  int threads;
+  CReadStats *stats;
+  CLatencyHistogram *extractLatency;
+  CScytlMetrics *metrics;
+
+  CDocumentProperties documentProperties;
+  std::list<TTocEntry> tableOfContents;
+  std::list<CRegionProfile> regionProfiles;
+  std::list<CElection> electionResults;
+
+  // worksheets seen by the last successful Read(), in file order. contest
+  // worksheets map onto electionResults in the same order.
+  std::vector<CWorksheetRange> worksheets;
+  int worksheetsParsed;
+  std::vector<const CElection *> changedResults;
+  std::list<CElection> replacedResults;
+
+  // contest name -> TOC page, for ReadContest(). rebuilt whenever the table of
+  // contents worksheet hashes differently.
+  std::map<std::string, int> contestIndex;
+  unsigned long long contestIndexHash;
+
+  // size and modification time the sidecar index is known to describe
+  unsigned long long sidecarSize;
+  long long sidecarModified;
+};
+
+#endif // SCYTL_READER_INCLUDED
@@ -0,0 +1,1035 @@
+#include <string>
+#include <list>
+#include <vector>
+#include <map>
+#include <memory>
+#include <iostream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <cerrno>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#endif
+
+#include "scytl-server.h"
+#include "scytl-json.h"
+
+using namespace std;
+
+// largest request head, and largest body, we're willing to buffer for one
+// connection
+static const size_t maxRequestSize = 64 * 1024;
+
+static void appendCsvField(string &out, const string &value)
+{
+  if (value.find_first_of(",\"\r\n") == string::npos) {
+    out += value;
+    return;
+  }
+
+  out += '"';
+  for (string::const_iterator it = value.begin(); it != value.end(); ++it)
+  {
+    if (*it == '"')
+      out += '"';
+    out += *it;
+  }
+  out += '"';
+}
+
+static void appendNumber(string &out, long long value)
+{
+  char buf[24];
+  sprintf(buf, "%lld", value);
+  out += buf;
+}
+
+static void appendRatio(string &out, double value)
+{
+  char buf[32];
+  sprintf(buf, "%.6g", value);
+  out += buf;
+}
+
+static void appendGroups(string &out, const vector<CGroupTotal> &groups)
+{
+  out += '[';
+  for (size_t i = 0; i < groups.size(); ++i)
+  {
+    if (i)
+      out += ',';
+    out += "{\"name\":";
+    AppendJsonString(out, groups[i].Name);
+    out += ",\"total\":";
+    appendNumber(out, groups[i].Total);
+    out += '}';
+  }
+  out += ']';
+}
+
+static string decodeUrl(const string &value)
+{
+  string result;
+  for (size_t i = 0; i < value.size(); ++i)
+  {
+    if (value[i] == '%' && i + 2 < value.size() &&
+        isxdigit((unsigned char)value[i+1]) && isxdigit((unsigned char)value[i+2]))
+    {
+      result += (char)strtol(value.substr(i + 1, 2).c_str(), NULL, 16);
+      i += 2;
+    }
+    else if (value[i] == '+')
+      result += ' ';
+    else
+      result += value[i];
+  }
+  return result;
+}
+
+static const char *reasonPhrase(int status)
+{
+  switch (status)
+  {
+  case 200: return "OK";
+  case 400: return "Bad Request";
+  case 404: return "Not Found";
+  case 405: return "Method Not Allowed";
+  case 431: return "Request Header Fields Too Large";
+  case 503: return "Service Unavailable";
+  }
+  return "Error";
+}
+
+// only the one spelling of each id ("3", not "03", "+3" or " 3"), since every
+// path that answers gets a cache entry of its own
+static bool parseContestId(const string &id, size_t count, int &index)
+{
+  if (id == "" || id.size() > 9 || id.find_first_not_of("0123456789") != string::npos ||
+      (id[0] == '0' && id.size() > 1))
+    return false;
+
+  long n = strtol(id.c_str(), NULL, 10);
+  if (n >= (long)count)
+    return false;
+
+  index = (int)n;
+  return true;
+}
+
+static const CElection *findContest(const CResultsModel &model, const string &id, int &index)
+{
+  if (!parseContestId(id, model.Elections.size(), index))
+    return NULL;
+  return model.Elections[index].get();
+}
+
+CScytlServer::CScytlServer(CScytlIngest &Ingest, int Port)
+  : port(Port), ingest(Ingest), reader(Ingest.Publisher()), cacheVersion(0), feed(Ingest.Feed()), eventsVersion(0)
+{
+}
+
+int CScytlServer::Start()
+{
+#ifdef __linux__
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    cout << "Error creating socket: " << strerror(errno) << endl;
+    return 1;
+  }
+
+  int on = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+  // this is meant for consumers on the same host, so only listen on loopback
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) || listen(fd, SOMAXCONN)) {
+    cout << "Error listening on port " << port << ": " << strerror(errno) << endl;
+    ::close(fd);
+    return 1;
+  }
+
+  if (!reader.Valid())
+    return 1;
+
+  if (listenOn(fd) || watch(feed.Fd()))
+    return 1;
+  return 0;
+#else
+  cout << "Server mode requires epoll, which isn't available on this platform" << endl;
+  return 1;
+#endif
+}
+
+void CScytlServer::accepted(int fd)
+{
+#ifdef __linux__
+  // responses go out in one write, so don't let Nagle hold them back
+  int on = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+#endif
+  ingest.Metrics().AddConnections(CScytlMetrics::Http, 1);
+}
+
+void CScytlServer::process(CConnection &connection)
+{
+  // handle every complete request in the buffer, so pipelined requests are
+  // answered in one go
+
+  // Example:
+  //
+  //  GET /contests/3?format=csv HTTP/1.1
+  //  Host: localhost:8080
+  //  Connection: keep-alive
+
+  // a subscriber's connection only carries events from here on; anything it
+  // sends is dropped rather than answered in the middle of the stream
+  if (subscribers.count(connection.Fd)) {
+    connection.In.clear();
+    return;
+  }
+
+  // pin the current model for this batch of requests. responses cached from an
+  // older model are no good any more.
+  CSnapshotPublisher<CResultsModel>::CReadGuard guard(reader);
+  const CResultsModel *model = guard.Get();
+  if (model && model->Version != cacheVersion) {
+    cache.clear();
+    cacheVersion = model->Version;
+  }
+
+  while (!connection.Close && !outputFull(connection))
+  {
+    size_t end = connection.In.find("\r\n\r\n");
+    if (end == string::npos) {
+      if (connection.In.size() > maxRequestSize) {
+        connection.Out += "HTTP/1.1 431 Request Header Fields Too Large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        connection.Close = true;
+      }
+      break;
+    }
+
+    // request line
+    size_t eol = connection.In.find("\r\n");
+    string line = connection.In.substr(0, eol);
+    size_t sp1 = line.find(' ');
+    size_t sp2 = sp1 == string::npos ? string::npos : line.find(' ', sp1 + 1);
+    if (sp2 == string::npos) {
+      connection.Out += "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+      connection.Close = true;
+      break;
+    }
+    string method = line.substr(0, sp1);
+    string target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+    string version = line.substr(sp2 + 1);
+
+    // headers. we only care about a couple of them.
+    bool keepAlive = version == "HTTP/1.1";
+    size_t contentLength = 0;
+    string lastEventId;
+    for (size_t pos = eol + 2; pos < end; )
+    {
+      size_t next = connection.In.find("\r\n", pos);
+      string header = connection.In.substr(pos, next - pos);
+      pos = next + 2;
+
+      size_t colon = header.find(':');
+      if (colon == string::npos)
+        continue;
+      string name = header.substr(0, colon);
+      for (size_t i = 0; i < name.size(); ++i)
+        name[i] = (char)tolower((unsigned char)name[i]);
+      string value = header.substr(colon + 1);
+      value.erase(0, value.find_first_not_of(" \t"));
+      for (size_t i = 0; i < value.size(); ++i)
+        value[i] = (char)tolower((unsigned char)value[i]);
+
+      if (name == "content-length")
+        contentLength = strtoul(value.c_str(), NULL, 10);
+      else if (name == "connection")
+        keepAlive = value == "keep-alive" || (keepAlive && value != "close");
+      else if (name == "last-event-id")
+        lastEventId = value;
+    }
+
+    // a body we'd never buffer is refused before we wait for any of it
+    if (contentLength > maxRequestSize) {
+      connection.Out += "HTTP/1.1 413 Payload Too Large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+      connection.Close = true;
+      break;
+    }
+
+    // wait for the whole body (which we then ignore)
+    if (connection.In.size() < end + 4 + contentLength)
+      break;
+    connection.In.erase(0, end + 4 + contentLength);
+    double started = CPhaseClock::WallNow();
+
+    CResponse uncached;
+    const CResponse *response = &uncached;
+    bool head = method == "HEAD";
+    if (method != "GET" && !head) {
+      uncached.Status = 405;
+      uncached.ContentType = "text/plain";
+      uncached.Body = "Only GET is supported\n";
+    } else {
+      string path = target, query;
+      size_t q = target.find('?');
+      if (q != string::npos) {
+        path = target.substr(0, q);
+        query = target.substr(q + 1);
+      }
+      bool csv = ("&" + query + "&").find("&format=csv&") != string::npos;
+
+      // a lazy workbook's reloads aren't fed to the change feed, so handle()
+      // turns /changes away with the rest
+      if (path == "/changes" && !head && !(model && model->Workbook)) {
+        size_t since = ("&" + query).find("&since=");
+        if (since != string::npos)
+          lastEventId = query.substr(since + 6, query.find('&', since + 6) - since - 6);
+        subscribe(connection, lastEventId);
+        return;
+      }
+
+      // cached by what the path decodes to, so "%33" and "3" share an entry
+      string decoded = decodeUrl(path);
+      string key = csv ? decoded + "?csv" : decoded;
+      map<string, CResponse>::const_iterator it = cache.find(key);
+      if (path == "/latency") {
+        // changes with every query, so it's never cached
+        renderLatency(uncached);
+      } else if (path == "/metrics") {
+        renderMetrics(uncached);
+      } else if (it != cache.end()) {
+        response = &it->second;
+        ingest.Metrics().CacheLookup(CScytlMetrics::Http, true);
+      } else {
+        ingest.Metrics().CacheLookup(CScytlMetrics::Http, false);
+        handle(model, decoded, csv, uncached);
+        if (uncached.Status == 200 && !model->Workbook)
+          response = &(cache[key] = uncached);
+      }
+    }
+
+    char header[256];
+    sprintf(header, "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %lu\r\n",
+            response->Status, reasonPhrase(response->Status), response->ContentType,
+            (unsigned long)response->Body.size());
+    connection.Out += header;
+    if (response->Status == 200) {
+      sprintf(header, "X-Results-Version: %llu\r\n", cacheVersion);
+      connection.Out += header;
+    }
+    connection.Out += keepAlive ? "\r\n" : "Connection: close\r\n\r\n";
+    if (!head)
+      connection.Out += response->Body;
+
+    if (!keepAlive)
+      connection.Close = true;
+    ingest.QueryLatency().Record(CPhaseClock::WallNow() - started);
+  }
+}
+
+void CScytlServer::handle(const CResultsModel *model, const string &path, bool csv, CResponse &response)
+{
+  response.Status = 200;
+  response.ContentType = csv ? "text/csv" : "application/json";
+  response.Body = "";
+
+  if (!model) {
+    response.Status = 503;
+    response.ContentType = "text/plain";
+    response.Body = "No results loaded yet\n";
+    return;
+  }
+
+  if (path == "/contests" || path == "/contests/")
+    renderContests(*model, csv, response);
+  else if (model->Workbook && path.compare(0, 10, "/contests/") == 0)
+    renderContest(*model, path.substr(10), csv, response);
+  else if (model->Workbook)
+    response.Status = 404;
+  else if (path.compare(0, 10, "/contests/") == 0) {
+    string id = path.substr(10), view;
+    size_t slash = id.find('/');
+    if (slash != string::npos) {
+      view = id.substr(slash + 1);
+      id.erase(slash);
+    }
+
+    if (slash == string::npos)
+      renderContest(*model, id, csv, response);
+    else if (view == "turnout")
+      renderTurnout(*model, id, csv, response);
+    else if (view == "leaders")
+      renderLeaders(*model, id, csv, response);
+    else
+      response.Status = 404;
+  }
+  else if (path.compare(0, 9, "/regions/") == 0)
+    renderRegion(*model, path.substr(9), csv, response);
+  else if (path == "/aggregates")
+    renderAggregates(*model, csv, response);
+  else
+    response.Status = 404;
+
+  if (response.Status == 404) {
+    response.ContentType = "text/plain";
+    response.Body = "Not found\n";
+  }
+}
+
+void CScytlServer::renderContests(const CResultsModel &model, bool csv, CResponse &response)
+{
+  // Example:
+  //
+  //  {"contests":[{"id":0,"name":"U.S. President - DEM","columns":7,"regions":75},...]}
+  //
+  // or, with a lazy workbook, without extracting anything
+  //
+  //  {"contests":[{"id":0,"name":"U.S. President - DEM","page":1},...]}
+
+  string &out = response.Body;
+  if (model.Workbook) {
+    const CLazyWorkbook &workbook = *model.Workbook;
+    out = csv ? "id,name,page\r\n" : "{\"contests\":[";
+    for (size_t id = 0; id < workbook.Count(); ++id)
+    {
+      if (csv) {
+        appendNumber(out, id);
+        out += ',';
+        appendCsvField(out, workbook.ContestName(id));
+        out += ',';
+        appendNumber(out, workbook.ContestPage(id));
+        out += "\r\n";
+      } else {
+        if (id)
+          out += ',';
+        out += "{\"id\":";
+        appendNumber(out, id);
+        out += ",\"name\":";
+        AppendJsonString(out, workbook.ContestName(id));
+        out += ",\"page\":";
+        appendNumber(out, workbook.ContestPage(id));
+        out += '}';
+      }
+    }
+    if (!csv)
+      out += "]}";
+    return;
+  }
+
+
+  if (csv)
+    out = "id,name,columns,regions\r\n";
+  else
+    out = "{\"contests\":[";
+
+  for (size_t id = 0; id < model.Elections.size(); ++id)
+  {
+    const CElection &election = *model.Elections[id];
+    if (csv) {
+      appendNumber(out, id);
+      out += ',';
+      appendCsvField(out, election.ElectionName);
+      out += ',';
+      appendNumber(out, (long long)election.Header.size());
+      out += ',';
+      appendNumber(out, (long long)election.Results.size());
+      out += "\r\n";
+    } else {
+      if (id)
+        out += ',';
+      out += "{\"id\":";
+      appendNumber(out, id);
+      out += ",\"name\":";
+      AppendJsonString(out, election.ElectionName);
+      out += ",\"columns\":";
+      appendNumber(out, (long long)election.Header.size());
+      out += ",\"regions\":";
+      appendNumber(out, (long long)election.Results.size());
+      out += '}';
+    }
+  }
+
+  if (!csv)
+    out += "]}";
+}
+
+void CScytlServer::renderContest(const CResultsModel &model, const string &id, bool csv, CResponse &response)
+{
+  // Example:
+  //
+  //  {"id":0,"name":"U.S. President - DEM",
+  //   "columns":[{"candidate":"","column":"County"},...],
+  //   "rows":[{"region":"Arkansas","votes":[0,508,508,599,599,1107]},...]}
+
+  // a lazy workbook's contest only stays in memory for as long as we hold it
+  int index;
+  shared_ptr<const CElection> held;
+  const CElection *election = NULL;
+  if (!model.Workbook)
+    election = findContest(model, id, index);
+  else if (parseContestId(id, model.Workbook->Count(), index)) {
+    held = model.Workbook->Contest(index);
+    election = held.get();
+  }
+  if (!election) {
+    response.Status = 404;
+    return;
+  }
+
+  string &out = response.Body;
+  if (csv)
+  {
+    for (size_t i = 0; i < election->Header.size(); ++i)
+    {
+      if (i)
+        out += ',';
+      const CElectionHeader &header = election->Header[i];
+      appendCsvField(out, header.CandidateName == "" ? header.ColumnName : header.CandidateName + " - " + header.ColumnName);
+    }
+    out += "\r\n";
+
+    for (list<CLabeledTuple>::const_iterator it = election->Results.begin(); it != election->Results.end(); ++it)
+    {
+      appendCsvField(out, it->Label);
+      for (size_t i = 0; i < it->Data.size(); ++i)
+      {
+        out += ',';
+        appendNumber(out, it->Data[i]);
+      }
+      out += "\r\n";
+    }
+    return;
+  }
+
+  out = "{\"id\":";
+  appendNumber(out, index);
+  out += ",\"name\":";
+  AppendJsonString(out, election->ElectionName);
+  out += ",\"columns\":[";
+  for (size_t i = 0; i < election->Header.size(); ++i)
+  {
+    if (i)
+      out += ',';
+    out += "{\"candidate\":";
+    AppendJsonString(out, election->Header[i].CandidateName);
+    out += ",\"column\":";
+    AppendJsonString(out, election->Header[i].ColumnName);
+    out += '}';
+  }
+  out += "],\"rows\":[";
+  for (list<CLabeledTuple>::const_iterator it = election->Results.begin(); it != election->Results.end(); ++it)
+  {
+    if (it != election->Results.begin())
+      out += ',';
+    out += "{\"region\":";
+    AppendJsonString(out, it->Label);
+    out += ",\"votes\":[";
+    for (size_t i = 0; i < it->Data.size(); ++i)
+    {
+      if (i)
+        out += ',';
+      appendNumber(out, it->Data[i]);
+    }
+    out += "]}";
+  }
+  out += "]}";
+}
+
+void CScytlServer::renderRegion(const CResultsModel &model, const string &name, bool csv, CResponse &response)
+{
+  // Example:
+  //
+  //  {"region":"Arkansas","registeredVoters":9095,"ballotsCast":1898,
+  //   "contests":[{"id":0,"name":"U.S. President - DEM","votes":[0,508,508,599,599,1107]},...]}
+
+  int index = model.Regions.Find(name);
+  const CRegionProfile *profile = index < 0 ? NULL : &model.RegionProfiles[index];
+
+  string &out = response.Body;
+  if (csv) {
+    out = "id,contest,votes\r\n";
+  } else {
+    out = "{\"region\":";
+    AppendJsonString(out, name);
+    if (profile) {
+      out += ",\"registeredVoters\":";
+      appendNumber(out, profile->RegisteredVoters);
+      out += ",\"ballotsCast\":";
+      appendNumber(out, profile->BallotsCast);
+    }
+    out += ",\"contests\":[";
+  }
+
+  bool found = profile != NULL;
+  for (size_t id = 0; id < model.Elections.size(); ++id)
+  {
+    const CElection &election = *model.Elections[id];
+    const CColumnarContest &contest = *model.Columns[id];
+
+    // regions with a profile were matched to their rows when the model was
+    // built. anything else has to be looked for.
+    int row = -1;
+    if (profile) {
+      row = model.Joins[id]->Rows[index];
+    } else {
+      for (size_t r = 0; r < contest.Labels.size() && row < 0; ++r)
+        if (contest.Labels[r] == name)
+          row = (int)r;
+    }
+    if (row < 0)
+      continue;
+
+    vector<int> votes(contest.Columns);
+    for (size_t c = 0; c < contest.Columns; ++c)
+      votes[c] = contest.Column(c)[row];
+
+    if (csv) {
+      appendNumber(out, id);
+      out += ',';
+      appendCsvField(out, election.ElectionName);
+      for (size_t i = 0; i < votes.size(); ++i)
+      {
+        out += ',';
+        appendNumber(out, votes[i]);
+      }
+      out += "\r\n";
+    } else {
+      if (out[out.size() - 1] != '[')
+        out += ',';
+      out += "{\"id\":";
+      appendNumber(out, id);
+      out += ",\"name\":";
+      AppendJsonString(out, election.ElectionName);
+      out += ",\"votes\":[";
+      for (size_t i = 0; i < votes.size(); ++i)
+      {
+        if (i)
+          out += ',';
+        appendNumber(out, votes[i]);
+      }
+      out += "]}";
+    }
+    found = true;
+  }
+
+  if (!found) {
+    response.Status = 404;
+    return;
+  }
+
+  if (!csv)
+    out += "]}";
+}
+
+void CScytlServer::renderTurnout(const CResultsModel &model, const string &id, bool csv, CResponse &response)
+{
+  // Example:
+  //
+  //  {"id":0,"name":"U.S. President - DEM",
+  //   "rows":[{"region":"Arkansas","registeredVoters":9095,"ballotsCast":1898,"votes":1107,
+  //            "turnout":0.208686,"votesPerRegistered":0.121715},...]}
+
+  int index;
+  if (!findContest(model, id, index)) {
+    response.Status = 404;
+    return;
+  }
+  const CElection &election = *model.Elections[index];
+  const CColumnarContest &contest = *model.Columns[index];
+  const CRegionJoin &join = *model.Joins[index];
+
+  // the closing Total column holds each region's votes in this contest
+  vector<int> votes(contest.Rows, 0);
+  if (contest.Columns && contest.Rows)
+    votes.assign(contest.Column(contest.Columns - 1), contest.Column(contest.Columns - 1) + contest.Rows);
+
+  vector<double> turnout, perRegistered;
+  if (contest.Rows) {
+    ColumnRatios(&join.BallotsCast[0], &join.RegisteredVoters[0], contest.Rows, turnout);
+    ColumnRatios(&votes[0], &join.RegisteredVoters[0], contest.Rows, perRegistered);
+  }
+
+  string &out = response.Body;
+  if (csv) {
+    out = "region,registeredVoters,ballotsCast,votes,turnout,votesPerRegistered\r\n";
+  } else {
+    out = "{\"id\":";
+    appendNumber(out, index);
+    out += ",\"name\":";
+    AppendJsonString(out, election.ElectionName);
+    out += ",\"rows\":[";
+  }
+
+  for (size_t row = 0; row < contest.Rows; ++row)
+  {
+    if (csv) {
+      appendCsvField(out, contest.Labels[row]);
+      out += ',';
+      appendNumber(out, join.RegisteredVoters[row]);
+      out += ',';
+      appendNumber(out, join.BallotsCast[row]);
+      out += ',';
+      appendNumber(out, votes[row]);
+      out += ',';
+      appendRatio(out, turnout[row]);
+      out += ',';
+      appendRatio(out, perRegistered[row]);
+      out += "\r\n";
+    } else {
+      if (row)
+        out += ',';
+      out += "{\"region\":";
+      AppendJsonString(out, contest.Labels[row]);
+      out += ",\"registeredVoters\":";
+      appendNumber(out, join.RegisteredVoters[row]);
+      out += ",\"ballotsCast\":";
+      appendNumber(out, join.BallotsCast[row]);
+      out += ",\"votes\":";
+      appendNumber(out, votes[row]);
+      out += ",\"turnout\":";
+      appendRatio(out, turnout[row]);
+      out += ",\"votesPerRegistered\":";
+      appendRatio(out, perRegistered[row]);
+      out += '}';
+    }
+  }
+
+  if (!csv)
+    out += "]}";
+}
+
+void CScytlServer::renderLeaders(const CResultsModel &model, const string &id, bool csv, CResponse &response)
+{
+  // Example:
+  //
+  //  {"id":0,"name":"U.S. President - DEM",
+  //   "total":{"leader":"Barack Obama","runnerUp":"John Wolfe","margin":27225,"tie":false},
+  //   "rows":[{"region":"Arkansas","leader":"Barack Obama","runnerUp":"John Wolfe","margin":91,"tie":false},...]}
+
+  int index;
+  if (!findContest(model, id, index)) {
+    response.Status = 404;
+    return;
+  }
+  const CElection &election = *model.Elections[index];
+  const CColumnarContest &contest = *model.Columns[index];
+  const CContestLeaders &leaders = *model.Leaders[index];
+
+  string &out = response.Body;
+  if (csv) {
+    out = "region,leader,runnerUp,margin,tie\r\n";
+  } else {
+    out = "{\"id\":";
+    appendNumber(out, index);
+    out += ",\"name\":";
+    AppendJsonString(out, election.ElectionName);
+    out += ",\"total\":{\"leader\":";
+    AppendJsonString(out, leaders.TotalLeader < 0 ? "" : leaders.Candidates[leaders.TotalLeader]);
+    out += ",\"runnerUp\":";
+    AppendJsonString(out, leaders.TotalRunnerUp < 0 ? "" : leaders.Candidates[leaders.TotalRunnerUp]);
+    out += ",\"margin\":";
+    appendNumber(out, leaders.TotalMargin);
+    out += leaders.TotalTie ? ",\"tie\":true}" : ",\"tie\":false}";
+    out += ",\"rows\":[";
+  }
+
+  for (size_t row = 0; row < contest.Rows; ++row)
+  {
+    const string &leader = leaders.Leader[row] < 0 ? "" : leaders.Candidates[leaders.Leader[row]];
+    const string &runnerUp = leaders.RunnerUp[row] < 0 ? "" : leaders.Candidates[leaders.RunnerUp[row]];
+    if (csv) {
+      appendCsvField(out, contest.Labels[row]);
+      out += ',';
+      appendCsvField(out, leader);
+      out += ',';
+      appendCsvField(out, runnerUp);
+      out += ',';
+      appendNumber(out, leaders.Margin[row]);
+      out += leaders.Tie[row] ? ",1\r\n" : ",0\r\n";
+    } else {
+      if (row)
+        out += ',';
+      out += "{\"region\":";
+      AppendJsonString(out, contest.Labels[row]);
+      out += ",\"leader\":";
+      AppendJsonString(out, leader);
+      out += ",\"runnerUp\":";
+      AppendJsonString(out, runnerUp);
+      out += ",\"margin\":";
+      appendNumber(out, leaders.Margin[row]);
+      out += leaders.Tie[row] ? ",\"tie\":true}" : ",\"tie\":false}";
+    }
+  }
+
+  if (!csv)
+    out += "]}";
+}
+
+void CScytlServer::renderAggregates(const CResultsModel &model, bool csv, CResponse &response)
+{
+  // Example:
+  //
+  //  {"contests":[{"id":0,"name":"U.S. President - DEM","totals":[0,67711,67711,94936,94936,162647],
+  //                "candidates":[{"name":"Barack Obama","total":67711},...],
+  //                "voteTypes":[{"name":"Election Day","total":162647},{"name":"Total Votes","total":162647}]},...]}
+
+  string &out = response.Body;
+  out = csv ? "id,contest,totals\r\n" : "{\"contests\":[";
+
+  CContestTotals totals;
+  for (size_t id = 0; id < model.Elections.size(); ++id)
+  {
+    const CElection &election = *model.Elections[id];
+    AggregateContest(election, *model.Columns[id], totals);
+
+    if (csv) {
+      appendNumber(out, id);
+      out += ',';
+      appendCsvField(out, election.ElectionName);
+      for (size_t i = 0; i < totals.Columns.size(); ++i)
+      {
+        out += ',';
+        appendNumber(out, totals.Columns[i]);
+      }
+      out += "\r\n";
+    } else {
+      if (id)
+        out += ',';
+      out += "{\"id\":";
+      appendNumber(out, id);
+      out += ",\"name\":";
+      AppendJsonString(out, election.ElectionName);
+      out += ",\"totals\":[";
+      for (size_t i = 0; i < totals.Columns.size(); ++i)
+      {
+        if (i)
+          out += ',';
+        appendNumber(out, totals.Columns[i]);
+      }
+      out += "],\"candidates\":";
+      appendGroups(out, totals.Candidates);
+      out += ",\"voteTypes\":";
+      appendGroups(out, totals.VoteTypes);
+      out += '}';
+    }
+  }
+
+  if (!csv)
+    out += "]}";
+}
+
+void CScytlServer::renderLatency(CResponse &response)
+{
+  // Example:
+  //
+  //  {"latencies":[{"name":"reload","count":42,"meanMs":8.512,"minMs":7.905,"p50Ms":8.431,...},...]}
+
+  TLatencies latencies;
+  ingest.Latencies(latencies);
+  ostringstream out;
+  PrintLatencies(out, latencies, CReadStats::Json);
+
+  response.Status = 200;
+  response.ContentType = "application/json";
+  response.Body = out.str();
+}
+
+void CScytlServer::renderMetrics(CResponse &response)
+{
+  ostringstream out;
+  ingest.Metrics().Write(out);
+
+  response.Status = 200;
+  response.ContentType = "text/plain; version=0.0.4";
+  response.Body = out.str();
+}
+
+void CScytlServer::subscribe(CConnection &connection, const string &since)
+{
+  connection.Out += "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\n\r\n";
+
+  // nothing else is read from a subscriber
+  connection.In.clear();
+
+  unsigned long long latest = feed.Latest();
+  unsigned long long &seen = subscribers[connection.Fd];
+  ingest.Metrics().SetSubscribers((long long)subscribers.size());
+  if (since != "") {
+    seen = strtoull(since.c_str(), NULL, 10);
+  } else {
+    // a new subscriber starts from whatever is current
+    char event[96];
+    sprintf(event, "id: %llu\nevent: version\ndata: {\"version\":%llu}\n\n", latest, latest);
+    connection.Out += event;
+    seen = latest;
+  }
+
+  notify(connection, seen);
+}
+
+void CScytlServer::ready(int fd)
+{
+  if (fd != feed.Fd())
+    return;
+  feed.Acknowledge();
+
+  // subscribers that are still busy with their last event are caught up from
+  // drained() instead, with everything they missed in one event
+  long long behind = 0;
+  for (map<int, unsigned long long>::iterator it = subscribers.begin(); it != subscribers.end(); ++it)
+  {
+    CConnection *connection = find(it->first);
+    if (!connection || !connection->Out.empty()) {
+      ++behind;
+      continue;
+    }
+    notify(*connection, it->second);
+    push(*connection);
+  }
+  ingest.Metrics().SetSubscribersBehind(behind);
+}
+
+void CScytlServer::drained(CConnection &connection)
+{
+  map<int, unsigned long long>::iterator it = subscribers.find(connection.Fd);
+  if (it != subscribers.end())
+    notify(connection, it->second);
+}
+
+void CScytlServer::closed(int fd)
+{
+  subscribers.erase(fd);
+  ingest.Metrics().SetSubscribers((long long)subscribers.size());
+  ingest.Metrics().AddConnections(CScytlMetrics::Http, -1);
+}
+
+void CScytlServer::notify(CConnection &connection, unsigned long long &seen)
+{
+  unsigned long long latest = feed.Latest();
+  if (seen == latest)
+    return;
+
+  // subscribers that saw the same version get the same event, so only render
+  // it once per reload
+  if (latest != eventsVersion) {
+    events.clear();
+    eventsVersion = latest;
+  }
+  map<unsigned long long, string>::iterator it = events.find(seen);
+  if (it == events.end()) {
+    string event;
+    renderEvent(seen, event, latest);
+    if (latest != eventsVersion) {
+      // another reload landed while rendering
+      events.clear();
+      eventsVersion = latest;
+    }
+    it = events.insert(make_pair(seen, event)).first;
+  }
+
+  connection.Out += it->second;
+  seen = latest;
+}
+
+void CScytlServer::renderEvent(unsigned long long seen, string &event, unsigned long long &latest)
+{
+  // Example:
+  //
+  //  id: 7
+  //  event: delta
+  //  data: {"from":6,"version":7,"contests":[{"name":"U.S. President - DEM","status":"changed","cells":[{"region":"Arkansas","column":2,"old":508,"new":512}],"removedRegions":[],"rows":[]}]}
+
+  CElectionDelta delta;
+  char buf[64];
+  if (feed.Since(seen, delta, latest)) {
+    sprintf(buf, "id: %llu\nevent: resync\ndata: {\"version\":%llu}\n\n", latest, latest);
+    event = buf;
+    return;
+  }
+
+  sprintf(buf, "id: %llu\nevent: delta\ndata: {\"from\":%llu,\"version\":%llu,\"contests\":[", latest, seen, latest);
+  event = buf;
+  for (size_t i = 0; i < delta.Contests.size(); ++i)
+  {
+    const CContestDelta &contest = delta.Contests[i];
+    if (i)
+      event += ',';
+    event += "{\"name\":";
+    AppendJsonString(event, contest.ElectionName);
+    event += ",\"status\":";
+    event += contest.Removed ? "\"removed\"" : contest.Added ? "\"added\"" : "\"changed\"";
+
+    if (contest.Added) {
+      event += ",\"columns\":[";
+      for (size_t c = 0; c < contest.Header.size(); ++c)
+      {
+        if (c)
+          event += ',';
+        event += "{\"candidate\":";
+        AppendJsonString(event, contest.Header[c].CandidateName);
+        event += ",\"column\":";
+        AppendJsonString(event, contest.Header[c].ColumnName);
+        event += '}';
+      }
+      event += ']';
+    }
+
+    event += ",\"cells\":[";
+    for (size_t c = 0; c < contest.Changed.size(); ++c)
+    {
+      const CCellChange &change = contest.Changed[c];
+      if (c)
+        event += ',';
+      event += "{\"region\":";
+      AppendJsonString(event, change.Region);
+      event += ",\"column\":";
+      appendNumber(event, change.Column);
+      event += ",\"old\":";
+      appendNumber(event, change.OldValue);
+      event += ",\"new\":";
+      appendNumber(event, change.NewValue);
+      event += '}';
+    }
+
+    event += "],\"removedRegions\":[";
+    for (size_t r = 0; r < contest.RemovedRegions.size(); ++r)
+    {
+      if (r)
+        event += ',';
+      AppendJsonString(event, contest.RemovedRegions[r]);
+    }
+
+    event += "],\"rows\":[";
+    for (list<CLabeledTuple>::const_iterator it = contest.AddedRegions.begin(); it != contest.AddedRegions.end(); ++it)
+    {
+      if (it != contest.AddedRegions.begin())
+        event += ',';
+      event += "{\"region\":";
+      AppendJsonString(event, it->Label);
+      event += ",\"votes\":[";
+      for (size_t v = 0; v < it->Data.size(); ++v)
+      {
+        if (v)
+          event += ',';
+        appendNumber(event, it->Data[v]);
+      }
+      event += "]}";
+    }
+    event += "]}";
+  }
+  event += "]}\n\n";
+}
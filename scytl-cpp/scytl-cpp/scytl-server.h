@@ -0,0 +1,101 @@
+#ifndef SCYTL_SERVER_INCLUDED
+#define SCYTL_SERVER_INCLUDED
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include "scytl-model.h"
+#include "scytl-publish.h"
+#include "scytl-ingest.h"
+#include "scytl-epoll.h"
+#include "scytl-feed.h"
+
+// Minimal HTTP/1.1 server answering queries against the results published by a
+// CScytlIngest. Client connections are handled on a single epoll loop, which
+// is never held up by a reload.
+//
+//   GET /contests                 contest ids, names and sizes
+//   GET /contests/<id>            one contest, every region
+//   GET /contests/<id>/turnout    one contest joined with Registered Voters, with ratios
+//   GET /contests/<id>/leaders    leader, runner-up and margin, per region and overall
+//   GET /regions/<name>           one region across every contest
+//   GET /aggregates               per-column totals for every contest
+//   GET /changes                  server-sent events, one per reload
+//   GET /latency                  reload, refresh, extraction and query latency percentiles
+//   GET /metrics                  everything ingested and served, for Prometheus to scrape
+//
+// Add ?format=csv to any of them but /changes, /latency and /metrics for CSV
+// instead of JSON.
+// Rendered responses are cached until the next reload, and carry the version
+// of the results they came from in X-Results-Version.
+//
+// With CScytlIngest::SetLazy() only /contests (ids, names and TOC pages) and
+// /contests/<id> are served, besides /latency and /metrics. Each contest is
+// extracted the first time it's asked for, and nothing is cached here on top
+// of what the workbook keeps under its memory cap.
+//
+// Each /changes event has the version as its id, and says which version it
+// starts from. A subscriber that is still reading the last event when the
+// next reload comes along gets a single event covering both, so slow
+// subscribers only ever have one event queued. One that misses more reloads
+// than the feed remembers gets a resync event instead, and should fetch what
+// it needs again. Reconnect with Last-Event-ID (or ?since=<version>) to pick
+// up where you left off.
+class CScytlServer : public CEpollServer
+{
+public:
+  CScytlServer(CScytlIngest &Ingest, int Port);
+
+  // bind the port
+  int Start();
+
+protected:
+  class CResponse
+  {
+  public:
+    int Status;
+    const char *ContentType;
+    std::string Body;
+  };
+
+  // render the answer for a GET of 'path'
+  void handle(const CResultsModel *model, const std::string &path, bool csv, CResponse &response);
+
+  void renderContests(const CResultsModel &model, bool csv, CResponse &response);
+  void renderContest(const CResultsModel &model, const std::string &id, bool csv, CResponse &response);
+  void renderRegion(const CResultsModel &model, const std::string &name, bool csv, CResponse &response);
+  void renderTurnout(const CResultsModel &model, const std::string &id, bool csv, CResponse &response);
+  void renderLeaders(const CResultsModel &model, const std::string &id, bool csv, CResponse &response);
+  void renderAggregates(const CResultsModel &model, bool csv, CResponse &response);
+  void renderLatency(CResponse &response);
+  void renderMetrics(CResponse &response);
+
+  // turn 'connection' into a /changes subscriber
+  void subscribe(CConnection &connection, const std::string &since);
+
+  // queue the event taking a subscriber from 'seen' to the latest version
+  void notify(CConnection &connection, unsigned long long &seen);
+  void renderEvent(unsigned long long seen, std::string &event, unsigned long long &latest);
+
+  virtual void process(CConnection &connection);
+  virtual void accepted(int fd);
+  virtual void drained(CConnection &connection);
+  virtual void closed(int fd);
+  virtual void ready(int fd);
+
+private:
+  int port;
+  CScytlIngest &ingest;
+
+  CSnapshotPublisher<CResultsModel>::CReader reader;
+  std::map<std::string, CResponse> cache;
+  unsigned long long cacheVersion;
+
+  CChangeFeed &feed;
+  std::map<int, unsigned long long> subscribers;    // fd -> last version sent
+  std::map<unsigned long long, std::string> events; // rendered for eventsVersion, by starting version
+  unsigned long long eventsVersion;
+};
+
+#endif // SCYTL_SERVER_INCLUDED
@@ -0,0 +1,77 @@
+#ifndef SCYTL_SIMD_INCLUDED
+#define SCYTL_SIMD_INCLUDED
+
+#include <cstddef>
+
+// SSE2 is part of every x86-64 target, and MSVC tells us about it for 32-bit
+// builds with /arch:SSE2. everything here has a plain C++ fallback.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SCYTL_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// index of the first element at or after 'start' where a and b differ, or n
+// if they're identical from there on
+inline size_t FirstDifference(const int *a, const int *b, size_t n, size_t start = 0)
+{
+  size_t i = start;
+#ifdef SCYTL_SSE2
+  for (; i + 4 <= n; i += 4)
+  {
+    __m128i eq = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(a + i)),
+                                 _mm_loadu_si128((const __m128i *)(b + i)));
+    if (_mm_movemask_epi8(eq) != 0xffff)
+      break;
+  }
+#endif
+  for (; i < n; ++i)
+    if (a[i] != b[i])
+      return i;
+  return n;
+}
+
+// sum of n ints, added up in 64 bits so that it can't overflow
+inline long long SumInt32(const int *p, size_t n)
+{
+  size_t i = 0;
+  long long sum = 0;
+#ifdef SCYTL_SSE2
+  // SSE2 has no sign extending load, so widen each int against a mask of its
+  // sign bits. two accumulators keep the adds from waiting on each other.
+  __m128i zero = _mm_setzero_si128();
+  __m128i acc0 = zero, acc1 = zero;
+  for (; i + 4 <= n; i += 4)
+  {
+    __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+    __m128i sign = _mm_cmpgt_epi32(zero, v);
+    acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(v, sign));
+    acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(v, sign));
+  }
+  long long lanes[2];
+  _mm_storeu_si128((__m128i *)lanes, _mm_add_epi64(acc0, acc1));
+  sum = lanes[0] + lanes[1];
+#endif
+  for (; i < n; ++i)
+    sum += p[i];
+  return sum;
+}
+
+// acc[i] += p[i] for n ints. a sum that doesn't fit wraps around, the same
+// with or without SSE2
+inline void AddInt32(int *acc, const int *p, size_t n)
+{
+  size_t i = 0;
+#ifdef SCYTL_SSE2
+  for (; i + 4 <= n; i += 4)
+  {
+    __m128i sum = _mm_add_epi32(_mm_loadu_si128((const __m128i *)(acc + i)),
+                                _mm_loadu_si128((const __m128i *)(p + i)));
+    _mm_storeu_si128((__m128i *)(acc + i), sum);
+  }
+#endif
+  // signed overflow is undefined, so add them as unsigned like _mm_add_epi32
+  for (; i < n; ++i)
+    acc[i] = (int)((unsigned int)acc[i] + (unsigned int)p[i]);
+}
+
+#endif // SCYTL_SIMD_INCLUDED
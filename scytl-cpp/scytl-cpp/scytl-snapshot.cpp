@@ -0,0 +1,188 @@
+#include <string>
+#include <list>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+
+#include "scytl-snapshot.h"
+
+using namespace std;
+
+// Layout:
+//
+//   "SCYTLSN1"
+//   u32 contest count
+//   per contest:
+//     str election name
+//     u32 column count, then per column: str candidate name, str column name
+//     u32 row count, then per row: str label, u32 n, n x i32 data
+//
+// where str is a u32 length followed by that many bytes.
+
+static const char signature[8] = { 'S', 'C', 'Y', 'T', 'L', 'S', 'N', '1' };
+
+static void writeU32(FILE *fp, unsigned int value)
+{
+  fwrite(&value, sizeof(value), 1, fp);
+}
+
+static void writeString(FILE *fp, const string &value)
+{
+  writeU32(fp, (unsigned int)value.size());
+  fwrite(value.data(), 1, value.size(), fp);
+}
+
+static bool readU32(FILE *fp, unsigned int &value)
+{
+  return fread(&value, sizeof(value), 1, fp) == 1;
+}
+
+// bytes between the read position and the end of the file
+static unsigned long long bytesLeft(FILE *fp, unsigned long long size)
+{
+  long pos = ftell(fp);
+  return pos < 0 || (unsigned long long)pos > size ? 0 : size - (unsigned long long)pos;
+}
+
+static bool readString(FILE *fp, unsigned long long size, string &value)
+{
+  unsigned int length;
+  if (!readU32(fp, length) || length > 65536 || length > bytesLeft(fp, size))
+    return false;
+  value.resize(length);
+  return !length || fread(&value[0], 1, length, fp) == length;
+}
+
+int WriteSnapshot(const string &Filename, const list<CElection> &elections)
+{
+  FILE *fp = fopen(Filename.c_str(), "wb");
+  if (!fp)
+    return 1;
+
+  fwrite(signature, 1, sizeof(signature), fp);
+  writeU32(fp, (unsigned int)elections.size());
+  for (list<CElection>::const_iterator itElection = elections.begin();
+       itElection != elections.end();
+       ++itElection)
+  {
+    writeString(fp, itElection->ElectionName);
+
+    writeU32(fp, (unsigned int)itElection->Header.size());
+    for (vector<CElectionHeader>::const_iterator itHeader = itElection->Header.begin();
+         itHeader != itElection->Header.end();
+         ++itHeader)
+    {
+      writeString(fp, itHeader->CandidateName);
+      writeString(fp, itHeader->ColumnName);
+    }
+
+    writeU32(fp, (unsigned int)itElection->Results.size());
+    for (list<CLabeledTuple>::const_iterator itTuple = itElection->Results.begin();
+         itTuple != itElection->Results.end();
+         ++itTuple)
+    {
+      writeString(fp, itTuple->Label);
+      writeU32(fp, (unsigned int)itTuple->Data.size());
+      if (!itTuple->Data.empty())
+        fwrite(&itTuple->Data[0], sizeof(int), itTuple->Data.size(), fp);
+    }
+  }
+
+  bool failed = ferror(fp) != 0;
+  if (fclose(fp))
+    failed = true;
+  return failed ? 1 : 0;
+}
+
+int ReadSnapshot(const string &Filename, list<CElection> &elections)
+{
+  FILE *fp = fopen(Filename.c_str(), "rb");
+  if (!fp)
+    return 1;
+
+  // counts and lengths are checked against what's left of the file before
+  // anything is allocated for them, so a corrupt snapshot just fails to read
+  unsigned long long size = 0;
+  if (fseek(fp, 0, SEEK_END) == 0) {
+    long end = ftell(fp);
+    size = end < 0 ? 0 : (unsigned long long)end;
+  }
+  rewind(fp);
+
+  char sig[sizeof(signature)];
+  unsigned int count;
+  if (fread(sig, 1, sizeof(sig), fp) != sizeof(sig) || memcmp(sig, signature, sizeof(sig)) ||
+      !readU32(fp, count))
+  {
+    fclose(fp);
+    return 1;
+  }
+
+  for (unsigned int i = 0; i < count; ++i)
+  {
+    elections.push_back(CElection());
+    CElection &election = elections.back();
+
+    unsigned int columns, rows;
+
+    // every column takes at least its two string lengths
+    if (!readString(fp, size, election.ElectionName) || !readU32(fp, columns) ||
+        (unsigned long long)columns * 2 * sizeof(unsigned int) > bytesLeft(fp, size))
+    {
+      fclose(fp);
+      return 1;
+    }
+
+    election.Header.resize(columns);
+    for (unsigned int c = 0; c < columns; ++c)
+    {
+      if (!readString(fp, size, election.Header[c].CandidateName) ||
+          !readString(fp, size, election.Header[c].ColumnName))
+      {
+        fclose(fp);
+        return 1;
+      }
+    }
+
+    // and every row at least its label length and value count
+    if (!readU32(fp, rows) || (unsigned long long)rows * 2 * sizeof(unsigned int) > bytesLeft(fp, size)) {
+      fclose(fp);
+      return 1;
+    }
+
+    for (unsigned int r = 0; r < rows; ++r)
+    {
+      election.Results.push_back(CLabeledTuple());
+      CLabeledTuple &tuple = election.Results.back();
+
+      unsigned int n;
+      if (!readString(fp, size, tuple.Label) || !readU32(fp, n) ||
+          (unsigned long long)n * sizeof(int) > bytesLeft(fp, size))
+      {
+        fclose(fp);
+        return 1;
+      }
+      tuple.Data.resize(n);
+      if (n && fread(&tuple.Data[0], sizeof(int), n, fp) != n) {
+        fclose(fp);
+        return 1;
+      }
+    }
+  }
+
+  fclose(fp);
+  return 0;
+}
+
+bool IsSnapshot(const string &Filename)
+{
+  FILE *fp = fopen(Filename.c_str(), "rb");
+  if (!fp)
+    return false;
+
+  char sig[sizeof(signature)];
+  bool result = fread(sig, 1, sizeof(sig), fp) == sizeof(sig) &&
+                !memcmp(sig, signature, sizeof(sig));
+  fclose(fp);
+  return result;
+}
@@ -0,0 +1,18 @@
+#ifndef SCYTL_SNAPSHOT_INCLUDED
+#define SCYTL_SNAPSHOT_INCLUDED
+
+#include <string>
+#include <list>
+
+#include "scytl-reader.h"
+
+// Binary snapshot of extracted contests, so that two refreshes can be compared
+// without keeping the workbooks around. Integers are written in host byte
+// order; snapshots are meant to be read back on the machine that wrote them.
+int WriteSnapshot(const std::string &Filename, const std::list<CElection> &elections);
+int ReadSnapshot(const std::string &Filename, std::list<CElection> &elections);
+
+// true if the file starts with the snapshot signature
+bool IsSnapshot(const std::string &Filename);
+
+#endif // SCYTL_SNAPSHOT_INCLUDED
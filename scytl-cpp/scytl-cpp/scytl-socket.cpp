@@ -0,0 +1,326 @@
+#include <string>
+#include <list>
+#include <vector>
+#include <map>
+#include <memory>
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+#include "scytl-socket.h"
+#include "scytl-protocol.h"
+
+using namespace std;
+
+static void appendU32(string &out, unsigned int value)
+{
+  out.append((const char *)&value, sizeof(value));
+}
+
+static void setStatus(string &body, unsigned int status)
+{
+  memcpy(&body[0], &status, sizeof(status));
+}
+
+CScytlSocketServer::CScytlSocketServer(CScytlIngest &Ingest, const string &Path)
+  : path(Path), bound(false), queryLatency(Ingest.QueryLatency()), metrics(Ingest.Metrics()),
+    reader(Ingest.Publisher()), cacheVersion(0)
+{
+}
+
+CScytlSocketServer::~CScytlSocketServer()
+{
+#ifdef __linux__
+  if (bound)
+    unlink(path.c_str());
+#endif
+}
+
+int CScytlSocketServer::Start()
+{
+#ifdef __linux__
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path)) {
+    cout << "Socket path <" << path << "> is too long" << endl;
+    return 1;
+  }
+  strcpy(addr.sun_path, path.c_str());
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    cout << "Error creating socket: " << strerror(errno) << endl;
+    return 1;
+  }
+
+  unlink(path.c_str());
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) || listen(fd, SOMAXCONN)) {
+    cout << "Error listening on <" << path << ">: " << strerror(errno) << endl;
+    ::close(fd);
+    return 1;
+  }
+  bound = true;
+
+  if (!reader.Valid())
+    return 1;
+
+  return listenOn(fd);
+#else
+  cout << "Socket mode requires Unix domain sockets, which aren't available on this platform" << endl;
+  return 1;
+#endif
+}
+
+void CScytlSocketServer::accepted(int /* fd */)
+{
+  metrics.AddConnections(CScytlMetrics::Socket, 1);
+}
+
+void CScytlSocketServer::closed(int /* fd */)
+{
+  metrics.AddConnections(CScytlMetrics::Socket, -1);
+}
+
+void CScytlSocketServer::process(CConnection &connection)
+{
+  // pin the current model for this batch of requests. responses cached from
+  // an older model are no good any more.
+  CSnapshotPublisher<CResultsModel>::CReadGuard guard(reader);
+  const CResultsModel *model = guard.Get();
+  if (model && model->Version != cacheVersion) {
+    cache.clear();
+    contestIds.clear();
+    if (model->Workbook) {
+      for (size_t i = 0; i < model->Workbook->Count(); ++i)
+        contestIds.insert(make_pair(model->Workbook->ContestName(i), i));
+    }
+    for (size_t i = 0; i < model->Elections.size(); ++i)
+      contestIds.insert(make_pair(model->Elections[i]->ElectionName, i));
+    cacheVersion = model->Version;
+  }
+
+  // requests are only erased from In once the batch is done; erasing each one
+  // would move everything behind it every time
+  size_t used = 0;
+  while (!connection.Close && !outputFull(connection) && connection.In.size() - used >= sizeof(unsigned int))
+  {
+    unsigned int length;
+    memcpy(&length, connection.In.data() + used, sizeof(length));
+    if (length == 0 || length > SCYTL_MAX_REQUEST) {
+      // we can't find the next request, so give up on this connection
+      string body(SCYTL_RESPONSE_HEADER, '\0');
+      setStatus(body, SCYTL_STATUS_BAD_REQUEST);
+      appendU32(connection.Out, (unsigned int)body.size());
+      connection.Out += body;
+      connection.Close = true;
+      break;
+    }
+    if (connection.In.size() - used < sizeof(length) + length)
+      break;
+
+    unsigned char opcode = (unsigned char)connection.In[used + sizeof(length)];
+    string payload = connection.In.substr(used + sizeof(length) + 1, length - 1);
+    used += sizeof(length) + length;
+    double started = CPhaseClock::WallNow();
+
+    // the opcode and payload together identify the request
+    string key = (char)opcode + payload;
+    map<string, string>::const_iterator it = cache.find(key);
+    metrics.CacheLookup(CScytlMetrics::Socket, it != cache.end());
+    if (it == cache.end()) {
+      string body;
+      handle(model, opcode, payload, body);
+      unsigned int status;
+      memcpy(&status, body.data(), sizeof(status));
+      if (status != SCYTL_STATUS_OK || model->Workbook) {
+        appendU32(connection.Out, (unsigned int)body.size());
+        connection.Out += body;
+        queryLatency.Record(CPhaseClock::WallNow() - started);
+        continue;
+      }
+      it = cache.insert(make_pair(key, body)).first;
+    }
+
+    appendU32(connection.Out, (unsigned int)it->second.size());
+    connection.Out += it->second;
+    queryLatency.Record(CPhaseClock::WallNow() - started);
+  }
+  connection.In.erase(0, used);
+}
+
+void CScytlSocketServer::handle(const CResultsModel *model, unsigned char opcode, const string &payload, string &body)
+{
+  body.assign(SCYTL_RESPONSE_HEADER, '\0');
+  if (!model) {
+    setStatus(body, SCYTL_STATUS_NOT_LOADED);
+    return;
+  }
+  memcpy(&body[8], &model->Version, sizeof(model->Version));
+
+  // responses are cached by opcode and payload, so a payload where none
+  // belongs would cache the same answer over and over
+  if ((opcode == SCYTL_OP_INFO || opcode == SCYTL_OP_AGGREGATES) && !payload.empty()) {
+    setStatus(body, SCYTL_STATUS_BAD_REQUEST);
+    return;
+  }
+
+  switch (opcode)
+  {
+  case SCYTL_OP_INFO:
+    appendU32(body, (unsigned int)(model->Workbook ? model->Workbook->Count() : model->Elections.size()));
+    appendU32(body, (unsigned int)model->RegionProfiles.size());
+    break;
+
+  case SCYTL_OP_CONTEST_BY_ID:
+    {
+      unsigned int id;
+      if (payload.size() != sizeof(id)) {
+        setStatus(body, SCYTL_STATUS_BAD_REQUEST);
+        return;
+      }
+      memcpy(&id, payload.data(), sizeof(id));
+      if (id >= (model->Workbook ? model->Workbook->Count() : model->Elections.size())) {
+        setStatus(body, SCYTL_STATUS_NOT_FOUND);
+        return;
+      }
+      encodeContest(*model, id, body);
+    }
+    break;
+
+  case SCYTL_OP_CONTEST_BY_NAME:
+    {
+      map<string, size_t>::const_iterator it = contestIds.find(payload);
+      if (it == contestIds.end()) {
+        setStatus(body, SCYTL_STATUS_NOT_FOUND);
+        return;
+      }
+      encodeContest(*model, it->second, body);
+    }
+    break;
+
+  case SCYTL_OP_REGION:
+    if (model->Workbook)
+      setStatus(body, SCYTL_STATUS_NOT_FOUND);
+    else
+      encodeRegion(*model, payload, body);
+    break;
+
+  case SCYTL_OP_AGGREGATES:
+    if (model->Workbook)
+      setStatus(body, SCYTL_STATUS_NOT_FOUND);
+    else
+      encodeAggregates(*model, body);
+    break;
+
+  default:
+    setStatus(body, SCYTL_STATUS_BAD_REQUEST);
+    break;
+  }
+}
+
+void CScytlSocketServer::encodeContest(const CResultsModel &model, size_t id, string &body)
+{
+  // a lazy workbook's contest only stays in memory for as long as we hold it
+  shared_ptr<const CElection> held = model.Workbook ? model.Workbook->Contest(id) : model.Elections[id];
+  if (!held) {
+    setStatus(body, SCYTL_STATUS_NOT_FOUND);
+    return;
+  }
+  const CElection &election = *held;
+  unsigned int rows = (unsigned int)election.Results.size();
+  unsigned int columns = election.Header.size() ? (unsigned int)election.Header.size() - 1 : 0;
+
+  string labels;
+  for (list<CLabeledTuple>::const_iterator it = election.Results.begin(); it != election.Results.end(); ++it)
+    labels.append(it->Label.c_str(), it->Label.size() + 1);
+
+  appendU32(body, (unsigned int)id);
+  appendU32(body, rows);
+  appendU32(body, columns);
+  appendU32(body, (unsigned int)labels.size());
+
+  // transpose into columns, so a client can pick up one candidate's votes as
+  // a single array
+  size_t votes = body.size();
+  body.resize(votes + (size_t)rows * columns * sizeof(int));
+  int *data = (int *)&body[votes];
+  unsigned int row = 0;
+  for (list<CLabeledTuple>::const_iterator it = election.Results.begin(); it != election.Results.end(); ++it, ++row)
+  {
+    for (unsigned int c = 0; c < columns; ++c)
+      data[(size_t)c * rows + row] = c < it->Data.size() ? it->Data[c] : 0;
+  }
+
+  body += labels;
+}
+
+void CScytlSocketServer::encodeRegion(const CResultsModel &model, const string &name, string &body)
+{
+  vector<unsigned int> contests;
+  vector<unsigned int> offsets(1, 0);
+  vector<int> votes;
+
+  int index = model.Regions.Find(name);
+  for (size_t id = 0; id < model.Elections.size(); ++id)
+  {
+    const CColumnarContest &contest = *model.Columns[id];
+
+    // regions with a profile were matched to their rows when the model was
+    // built. anything else has to be looked for.
+    int row = -1;
+    if (index >= 0) {
+      row = model.Joins[id]->Rows[index];
+    } else {
+      for (size_t r = 0; r < contest.Labels.size() && row < 0; ++r)
+        if (contest.Labels[r] == name)
+          row = (int)r;
+    }
+    if (row < 0)
+      continue;
+
+    contests.push_back((unsigned int)id);
+    for (size_t c = 0; c < contest.Columns; ++c)
+      votes.push_back(contest.Column(c)[row]);
+    offsets.push_back((unsigned int)votes.size());
+  }
+
+  if (contests.empty()) {
+    setStatus(body, SCYTL_STATUS_NOT_FOUND);
+    return;
+  }
+
+  appendU32(body, (unsigned int)contests.size());
+  appendU32(body, 0);
+  body.append((const char *)&contests[0], contests.size() * sizeof(unsigned int));
+  body.append((const char *)&offsets[0], offsets.size() * sizeof(unsigned int));
+  if (!votes.empty())
+    body.append((const char *)&votes[0], votes.size() * sizeof(int));
+}
+
+void CScytlSocketServer::encodeAggregates(const CResultsModel &model, string &body)
+{
+  vector<unsigned int> offsets(1, 0);
+  vector<long long> totals;
+  vector<long long> columns;
+  for (size_t id = 0; id < model.Elections.size(); ++id)
+  {
+    ColumnTotals(*model.Columns[id], columns);
+    totals.insert(totals.end(), columns.begin(), columns.end());
+    offsets.push_back((unsigned int)totals.size());
+  }
+
+  appendU32(body, (unsigned int)model.Elections.size());
+  appendU32(body, 0);
+  body.append((const char *)&offsets[0], offsets.size() * sizeof(unsigned int));
+  while (body.size() % sizeof(long long))
+    body += '\0';
+  if (!totals.empty())
+    body.append((const char *)&totals[0], totals.size() * sizeof(long long));
+}
@@ -0,0 +1,51 @@
+#ifndef SCYTL_SOCKET_INCLUDED
+#define SCYTL_SOCKET_INCLUDED
+
+#include <string>
+#include <map>
+
+#include "scytl-model.h"
+#include "scytl-publish.h"
+#include "scytl-ingest.h"
+#include "scytl-epoll.h"
+
+// Answers the binary protocol described in scytl-protocol.h on a Unix domain
+// socket, for consumers on the same host that only want the numbers. Like the
+// HTTP server it reads whatever CScytlIngest last published, and caches each
+// encoded response until the next reload. With CScytlIngest::SetLazy() it
+// only answers SCYTL_OP_INFO and the contest queries, which extract contests
+// through the workbook, and caches nothing itself.
+class CScytlSocketServer : public CEpollServer
+{
+public:
+  CScytlSocketServer(CScytlIngest &Ingest, const std::string &Path);
+  ~CScytlSocketServer();
+
+  // bind the socket, replacing a stale one left behind by an earlier run
+  int Start();
+
+protected:
+  virtual void process(CConnection &connection);
+  virtual void accepted(int fd);
+  virtual void closed(int fd);
+
+  // encode the response body for one request
+  void handle(const CResultsModel *model, unsigned char opcode, const std::string &payload, std::string &body);
+
+  void encodeContest(const CResultsModel &model, size_t id, std::string &body);
+  void encodeRegion(const CResultsModel &model, const std::string &name, std::string &body);
+  void encodeAggregates(const CResultsModel &model, std::string &body);
+
+private:
+  std::string path;
+  bool bound;
+  CLatencyHistogram &queryLatency;
+  CScytlMetrics &metrics;
+
+  CSnapshotPublisher<CResultsModel>::CReader reader;
+  std::map<std::string, std::string> cache;
+  std::map<std::string, size_t> contestIds;
+  unsigned long long cacheVersion;
+};
+
+#endif // SCYTL_SOCKET_INCLUDED
@@ -0,0 +1,438 @@
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cstdio>
+#include <cctype>
+#include <ctime>
+#include <chrono>
+
+#ifdef __linux__
+#include <sys/time.h>
+#include <sys/resource.h>
+#endif
+
+#include "scytl-stats.h"
+#include "scytl-json.h"
+
+using namespace std;
+using namespace tinyxml2;
+
+void CPhaseClock::Restart()
+{
+  wall = WallNow();
+  cpu = CpuNow();
+  allocs = ThreadAllocCounts();
+  counters = ThreadPerfSample();
+}
+
+double CPhaseClock::Wall() const
+{
+  return WallNow() - wall;
+}
+
+double CPhaseClock::Cpu() const
+{
+  return CpuNow() - cpu;
+}
+
+double CPhaseClock::WallNow()
+{
+  return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+double CPhaseClock::CpuNow()
+{
+#ifdef __linux__
+  struct timespec ts;
+  if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts) == 0)
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+  return (double)clock() / CLOCKS_PER_SEC;
+}
+
+void CReadStats::Clear()
+{
+  Filename = "";
+  Bytes = 0;
+  Threads = 1;
+  Phases.clear();
+  Worksheets.clear();
+  Pools.clear();
+  PeakRssKb = 0;
+  Allocations = AllocCounting();
+  HardwareCounters = PerfCounting() && ThreadPerfAvailable();
+  workerAllocs = CAllocCounts();
+  workerCounters = CPerfSample();
+}
+
+void CReadStats::AddPhase(const string &name, const CPhaseClock &clock)
+{
+  CPhaseStats phase;
+  phase.Name = name;
+  phase.Wall = clock.Wall();
+  phase.Cpu = clock.Cpu();
+  phase.Allocs = clock.Allocs();
+  phase.Allocs += workerAllocs;
+  workerAllocs = CAllocCounts();
+  phase.Counters = clock.Counters();
+  phase.Counters += workerCounters;
+  workerCounters = CPerfSample();
+  Phases.push_back(phase);
+}
+
+void CReadStats::ReadPools(const XMLDocument &document, vector<CPoolStats> &pools)
+{
+  static const char *names[] = { "element", "attribute", "text", "comment" };
+  const MemPool *sources[] = { &document.ElementPool(), &document.AttributePool(),
+                               &document.TextPool(), &document.CommentPool() };
+
+  pools.resize(4);
+  for (int i = 0; i < 4; ++i)
+  {
+    pools[i].Name = names[i];
+    pools[i].ItemSize = sources[i]->ItemSize();
+    pools[i].Peak = sources[i]->MaxAllocs();
+    pools[i].Allocs = sources[i]->TotalAllocs();
+    pools[i].Blocks = sources[i]->Blocks();
+    pools[i].BlockBytes = (long long)sources[i]->Blocks() * sources[i]->BlockSize();
+  }
+}
+
+void CReadStats::AddPools(const vector<CPoolStats> &pools, const vector<CPoolStats> *before)
+{
+  if (Pools.empty())
+  {
+    Pools = pools;
+    for (size_t i = 0; i < Pools.size(); ++i)
+    {
+      Pools[i].Allocs = 0;
+      Pools[i].Blocks = 0;
+      Pools[i].BlockBytes = 0;
+    }
+  }
+
+  for (size_t i = 0; i < pools.size() && i < Pools.size(); ++i)
+  {
+    if (pools[i].Peak > Pools[i].Peak)
+      Pools[i].Peak = pools[i].Peak;
+    Pools[i].Allocs += pools[i].Allocs;
+    if (before && i < before->size())
+      Pools[i].Allocs -= (*before)[i].Allocs;
+    Pools[i].Blocks += pools[i].Blocks;
+    Pools[i].BlockBytes += pools[i].BlockBytes;
+  }
+}
+
+void CReadStats::Finish()
+{
+  PeakRssKb = ::PeakRssKb();
+}
+
+long long CReadStats::Rows() const
+{
+  long long rows = 0;
+  for (vector<CWorksheetStats>::const_iterator it = Worksheets.begin(); it != Worksheets.end(); ++it)
+    rows += it->Rows;
+  return rows;
+}
+
+long long CReadStats::Cells() const
+{
+  long long cells = 0;
+  for (vector<CWorksheetStats>::const_iterator it = Worksheets.begin(); it != Worksheets.end(); ++it)
+    cells += it->Cells;
+  return cells;
+}
+
+double CReadStats::Seconds() const
+{
+  double seconds = 0;
+  for (vector<CPhaseStats>::const_iterator it = Phases.begin(); it != Phases.end(); ++it)
+    seconds += it->Wall;
+  return seconds;
+}
+
+void CReadStats::Print(ostream &out, EFormat format) const
+{
+  if (format == Json)
+    printJson(out);
+  else
+    printText(out);
+}
+
+static double megabytesPerSecond(unsigned long long bytes, double seconds)
+{
+  return seconds > 0 ? bytes / seconds / 1e6 : 0;
+}
+
+static double perUnit(long long count, long long per)
+{
+  return per > 0 ? (double)count / per : 0;
+}
+
+// ";instructions;IPC;cache misses;branch misses"
+static string counterColumns(const CPerfSample &sample)
+{
+  char text[128];
+  snprintf(text, sizeof(text), ";%llu;%.2f;%llu;%llu", sample.Instructions, sample.Ipc(),
+           sample.CacheMisses, sample.BranchMisses);
+  return text;
+}
+
+// Example:
+//
+//  Stats for <detail.xls>: 583154 bytes in 9.371 ms (62.23 MB/s) on 1 threads, peak RSS 5428 kB
+//  Phase;Wall ms;CPU ms
+//  load;0.365;0.363
+//  ...
+//  Worksheet;Bytes;Rows;Cells;Parse ms;Extract ms;Parse MB/s
+//  Table of Contents;13403;57;110;0.108;0.031;124.43
+//  ...
+//
+// with allocations counted, the phase and worksheet lines go on with
+//
+//  Phase;...;Allocs;Frees;Alloc bytes;Allocs/row;Allocs/cell
+//  Worksheet;...;Parse allocs;Extract allocs;Alloc bytes;Allocs/row;Allocs/cell
+//
+// and with hardware counters, after those
+//
+//  Phase;...;Instructions;IPC;Cache misses;Branch misses
+//  Worksheet;...;Parse instructions;Parse IPC;Parse cache misses;Parse branch misses;Extract instructions;...
+//
+// and the pools come last:
+//
+//  Pool;Item bytes;Peak;Peak kB;Allocs;Blocks;Block kB
+//  element;104;1792;182.0;23696;200;182.8
+//  ...
+void CReadStats::printText(ostream &out) const
+{
+  char line[512];
+  double seconds = Seconds();
+  snprintf(line, sizeof(line), "%llu bytes in %.3f ms (%.2f MB/s) on %d threads, peak RSS %lld kB",
+           Bytes, seconds * 1000.0, megabytesPerSecond(Bytes, seconds), Threads, PeakRssKb);
+  out << "Stats for <" << Filename << ">: " << line << endl;
+
+  long long rows = Rows(), cells = Cells();
+  out << "Phase;Wall ms;CPU ms" << (Allocations ? ";Allocs;Frees;Alloc bytes;Allocs/row;Allocs/cell" : "")
+      << (HardwareCounters ? ";Instructions;IPC;Cache misses;Branch misses" : "") << endl;
+  for (vector<CPhaseStats>::const_iterator it = Phases.begin(); it != Phases.end(); ++it)
+  {
+    snprintf(line, sizeof(line), ";%.3f;%.3f", it->Wall * 1000.0, it->Cpu * 1000.0);
+    out << it->Name << line;
+    if (Allocations) {
+      snprintf(line, sizeof(line), ";%lld;%lld;%lld;%.2f;%.2f", it->Allocs.Allocs, it->Allocs.Frees,
+               it->Allocs.Bytes, perUnit(it->Allocs.Allocs, rows), perUnit(it->Allocs.Allocs, cells));
+      out << line;
+    }
+    if (HardwareCounters)
+      out << counterColumns(it->Counters);
+    out << endl;
+  }
+
+  out << "Worksheet;Bytes;Rows;Cells;Parse ms;Extract ms;Parse MB/s"
+      << (Allocations ? ";Parse allocs;Extract allocs;Alloc bytes;Allocs/row;Allocs/cell" : "")
+      << (HardwareCounters ? ";Parse instructions;Parse IPC;Parse cache misses;Parse branch misses"
+                             ";Extract instructions;Extract IPC;Extract cache misses;Extract branch misses" : "")
+      << endl;
+  for (vector<CWorksheetStats>::const_iterator it = Worksheets.begin(); it != Worksheets.end(); ++it)
+  {
+    snprintf(line, sizeof(line), ";%llu;%d;%d;%.3f;%.3f;%.2f", it->Bytes, it->Rows, it->Cells,
+             it->ParseSeconds * 1000.0, it->ExtractSeconds * 1000.0,
+             megabytesPerSecond(it->Bytes, it->ParseSeconds));
+    out << it->Name << line;
+    if (Allocations) {
+      long long allocs = it->ParseAllocs.Allocs + it->ExtractAllocs.Allocs;
+      snprintf(line, sizeof(line), ";%lld;%lld;%lld;%.2f;%.2f", it->ParseAllocs.Allocs, it->ExtractAllocs.Allocs,
+               it->ParseAllocs.Bytes + it->ExtractAllocs.Bytes, perUnit(allocs, it->Rows), perUnit(allocs, it->Cells));
+      out << line;
+    }
+    if (HardwareCounters)
+      out << counterColumns(it->ParseCounters) << counterColumns(it->ExtractCounters);
+    out << endl;
+  }
+
+  out << "Pool;Item bytes;Peak;Peak kB;Allocs;Blocks;Block kB" << endl;
+  for (vector<CPoolStats>::const_iterator it = Pools.begin(); it != Pools.end(); ++it)
+  {
+    snprintf(line, sizeof(line), ";%d;%d;%.1f;%lld;%d;%.1f", it->ItemSize, it->Peak,
+             it->Peak * it->ItemSize / 1024.0, it->Allocs, it->Blocks, it->BlockBytes / 1024.0);
+    out << it->Name << line << endl;
+  }
+}
+
+// ,"key":value
+static void writeJsonNumber(ostream &out, const char *key, double value, const char *fmt)
+{
+  char text[64];
+  snprintf(text, sizeof(text), fmt, value);
+  out << ",\"" << key << "\":" << text;
+}
+
+// ,"instructions":...,"cycles":...,"ipc":...,"cacheMisses":...,"branchMisses":...
+// with every key after 'prefix', capitalized, if there is one
+static void writeJsonCounters(ostream &out, const string &prefix, const CPerfSample &sample)
+{
+  static const char *names[] = { "instructions", "cycles", "ipc", "cacheMisses", "branchMisses" };
+  double values[] = { (double)sample.Instructions, (double)sample.Cycles, sample.Ipc(),
+                      (double)sample.CacheMisses, (double)sample.BranchMisses };
+  for (int i = 0; i < 5; ++i)
+  {
+    string key = names[i];
+    if (!prefix.empty())
+      key = prefix + (char)toupper(key[0]) + key.substr(1);
+    writeJsonNumber(out, key.c_str(), values[i], i == 2 ? "%.2f" : "%.0f");
+  }
+}
+
+// Example (on one line):
+//
+//  {"file":"detail.xls","bytes":583154,"ms":9.371,"mbPerSecond":62.23,"threads":1,"peakRssKb":5428,
+//   "phases":[{"name":"load","wallMs":0.365,"cpuMs":0.363},...],
+//   "worksheets":[{"name":"Table of Contents","bytes":13403,"rows":57,"cells":110,"parseMs":0.108,"extractMs":0.031},...],
+//   "pools":[{"name":"element","itemSize":104,"peak":1792,"allocs":23696,"blocks":200,"blockBytes":187200},...]}
+//
+// with allocations counted, phases also have "allocs", "frees", "allocBytes",
+// "allocsPerRow" and "allocsPerCell", and worksheets "parseAllocs",
+// "extractAllocs", "allocBytes", "allocsPerRow" and "allocsPerCell". with
+// hardware counters phases have "instructions", "cycles", "ipc", "cacheMisses"
+// and "branchMisses", and worksheets the same for the parse ("parseIpc", ...)
+// and the extraction ("extractIpc", ...).
+void CReadStats::printJson(ostream &out) const
+{
+  double seconds = Seconds();
+  out << "{\"file\":";
+  WriteJsonString(out, Filename);
+  writeJsonNumber(out, "bytes", (double)Bytes, "%.0f");
+  writeJsonNumber(out, "ms", seconds * 1000.0, "%.3f");
+  writeJsonNumber(out, "mbPerSecond", megabytesPerSecond(Bytes, seconds), "%.2f");
+  writeJsonNumber(out, "threads", Threads, "%.0f");
+  writeJsonNumber(out, "peakRssKb", (double)PeakRssKb, "%.0f");
+
+  out << ",\"phases\":[";
+  for (size_t i = 0; i < Phases.size(); ++i)
+  {
+    out << (i ? ",{\"name\":" : "{\"name\":");
+    WriteJsonString(out, Phases[i].Name);
+    writeJsonNumber(out, "wallMs", Phases[i].Wall * 1000.0, "%.3f");
+    writeJsonNumber(out, "cpuMs", Phases[i].Cpu * 1000.0, "%.3f");
+    if (Allocations) {
+      const CAllocCounts &allocs = Phases[i].Allocs;
+      writeJsonNumber(out, "allocs", (double)allocs.Allocs, "%.0f");
+      writeJsonNumber(out, "frees", (double)allocs.Frees, "%.0f");
+      writeJsonNumber(out, "allocBytes", (double)allocs.Bytes, "%.0f");
+      writeJsonNumber(out, "allocsPerRow", perUnit(allocs.Allocs, Rows()), "%.2f");
+      writeJsonNumber(out, "allocsPerCell", perUnit(allocs.Allocs, Cells()), "%.2f");
+    }
+    if (HardwareCounters)
+      writeJsonCounters(out, "", Phases[i].Counters);
+    out << "}";
+  }
+
+  out << "],\"worksheets\":[";
+  for (size_t i = 0; i < Worksheets.size(); ++i)
+  {
+    const CWorksheetStats &sheet = Worksheets[i];
+    out << (i ? ",{\"name\":" : "{\"name\":");
+    WriteJsonString(out, sheet.Name);
+    writeJsonNumber(out, "bytes", (double)sheet.Bytes, "%.0f");
+    writeJsonNumber(out, "rows", sheet.Rows, "%.0f");
+    writeJsonNumber(out, "cells", sheet.Cells, "%.0f");
+    writeJsonNumber(out, "parseMs", sheet.ParseSeconds * 1000.0, "%.3f");
+    writeJsonNumber(out, "extractMs", sheet.ExtractSeconds * 1000.0, "%.3f");
+    if (Allocations) {
+      long long allocs = sheet.ParseAllocs.Allocs + sheet.ExtractAllocs.Allocs;
+      writeJsonNumber(out, "parseAllocs", (double)sheet.ParseAllocs.Allocs, "%.0f");
+      writeJsonNumber(out, "extractAllocs", (double)sheet.ExtractAllocs.Allocs, "%.0f");
+      writeJsonNumber(out, "allocBytes", (double)(sheet.ParseAllocs.Bytes + sheet.ExtractAllocs.Bytes), "%.0f");
+      writeJsonNumber(out, "allocsPerRow", perUnit(allocs, sheet.Rows), "%.2f");
+      writeJsonNumber(out, "allocsPerCell", perUnit(allocs, sheet.Cells), "%.2f");
+    }
+    if (HardwareCounters) {
+      writeJsonCounters(out, "parse", sheet.ParseCounters);
+      writeJsonCounters(out, "extract", sheet.ExtractCounters);
+    }
+    out << "}";
+  }
+
+  out << "],\"pools\":[";
+  for (size_t i = 0; i < Pools.size(); ++i)
+  {
+    const CPoolStats &pool = Pools[i];
+    out << (i ? ",{\"name\":" : "{\"name\":");
+    WriteJsonString(out, pool.Name);
+    writeJsonNumber(out, "itemSize", pool.ItemSize, "%.0f");
+    writeJsonNumber(out, "peak", pool.Peak, "%.0f");
+    writeJsonNumber(out, "allocs", (double)pool.Allocs, "%.0f");
+    writeJsonNumber(out, "blocks", pool.Blocks, "%.0f");
+    writeJsonNumber(out, "blockBytes", (double)pool.BlockBytes, "%.0f");
+    out << "}";
+  }
+  out << "]}" << endl;
+}
+
+// Example (on one line):
+//
+//  {"latencies":[{"name":"reload","count":42,"meanMs":8.512,"minMs":7.905,"p50Ms":8.431,
+//   "p90Ms":9.120,"p99Ms":11.002,"p999Ms":11.002,"maxMs":11.002},...]}
+void PrintLatencies(ostream &out, const TLatencies &latencies, CReadStats::EFormat format)
+{
+  static const double percents[] = { 50, 90, 99, 99.9 };
+  static const char *keys[] = { "p50Ms", "p90Ms", "p99Ms", "p999Ms" };
+
+  if (format == CReadStats::Text)
+    out << "Latency;Count;Mean ms;Min ms;P50 ms;P90 ms;P99 ms;P99.9 ms;Max ms" << endl;
+  else
+    out << "{\"latencies\":[";
+
+  for (size_t i = 0; i < latencies.size(); ++i)
+  {
+    const CLatencyHistogram &histogram = *latencies[i].second;
+    if (format == CReadStats::Text) {
+      char line[256];
+      snprintf(line, sizeof(line), ";%llu;%.3f;%.3f", histogram.Count(), histogram.Mean() * 1000.0,
+               histogram.Min() * 1000.0);
+      out << latencies[i].first << line;
+      for (int p = 0; p < 4; ++p)
+      {
+        snprintf(line, sizeof(line), ";%.3f", histogram.Percentile(percents[p]) * 1000.0);
+        out << line;
+      }
+      snprintf(line, sizeof(line), ";%.3f", histogram.Max() * 1000.0);
+      out << line << endl;
+    } else {
+      out << (i ? ",{\"name\":" : "{\"name\":");
+      WriteJsonString(out, latencies[i].first);
+      writeJsonNumber(out, "count", (double)histogram.Count(), "%.0f");
+      writeJsonNumber(out, "meanMs", histogram.Mean() * 1000.0, "%.3f");
+      writeJsonNumber(out, "minMs", histogram.Min() * 1000.0, "%.3f");
+      for (int p = 0; p < 4; ++p)
+        writeJsonNumber(out, keys[p], histogram.Percentile(percents[p]) * 1000.0, "%.3f");
+      writeJsonNumber(out, "maxMs", histogram.Max() * 1000.0, "%.3f");
+      out << "}";
+    }
+  }
+
+  if (format == CReadStats::Json)
+    out << "]}" << endl;
+}
+
+int ParseStatsFormat(const string &name, CReadStats::EFormat &format)
+{
+  if (name == "text")
+    format = CReadStats::Text;
+  else if (name == "json")
+    format = CReadStats::Json;
+  else
+    return 1;
+  return 0;
+}
+
+long long PeakRssKb()
+{
+#ifdef __linux__
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0)
+    return usage.ru_maxrss;
+#endif
+  return 0;
+}
@@ -0,0 +1,183 @@
+#ifndef SCYTL_STATS_INCLUDED
+#define SCYTL_STATS_INCLUDED
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <ostream>
+
+#include "tinyxml2.h"
+#include "scytl-alloc.h"
+#include "scytl-perf.h"
+#include "scytl-histogram.h"
+
+// wall and CPU time since the clock was started, and the heap allocations
+// (see scytl-alloc.h) and hardware counters (see scytl-perf.h) of this thread.
+// CPU time is the whole process's, so it runs faster than the wall clock while
+// several threads are busy; outside Linux it's whatever clock() counts.
+class CPhaseClock
+{
+public:
+  CPhaseClock() { Restart(); }
+
+  void Restart();
+  double Wall() const;
+  double Cpu() const;
+  CAllocCounts Allocs() const { return ThreadAllocCounts() - allocs; }
+  CPerfSample Counters() const { return ThreadPerfSample() - counters; }
+
+  static double WallNow();
+  static double CpuNow();
+
+private:
+  double wall;
+  double cpu;
+  CAllocCounts allocs;
+  CPerfSample counters;
+};
+
+class CPhaseStats
+{
+public:
+  std::string Name;
+  double Wall;
+  double Cpu;
+  CAllocCounts Allocs;    // on every thread that worked on the phase
+  CPerfSample Counters;   // likewise
+};
+
+// one worksheet that was parsed, rather than reused from the previous Read()
+class CWorksheetStats
+{
+public:
+  CWorksheetStats() : Bytes(0), Rows(0), Cells(0), ParseSeconds(0), ExtractSeconds(0) {}
+
+  std::string Name;
+  unsigned long long Bytes;
+  int Rows;
+  int Cells;
+  double ParseSeconds;      // building the DOM
+  double ExtractSeconds;    // walking it into results, and validating them
+  CAllocCounts ParseAllocs;
+  CAllocCounts ExtractAllocs;
+  CPerfSample ParseCounters;
+  CPerfSample ExtractCounters;
+};
+
+// a moment in a worksheet's parse and extract, on the thread doing it. cheap
+// enough to take whether or not anybody wants the stats.
+class CWorksheetMark
+{
+public:
+  CWorksheetMark() : Seconds(CPhaseClock::WallNow()), Allocs(ThreadAllocCounts()), Counters(ThreadPerfSample()) {}
+
+  double Seconds;
+  CAllocCounts Allocs;
+  CPerfSample Counters;
+};
+
+// a tinyxml2 node pool. added up over every DOM a Read() used, except Peak,
+// which is the largest any one of them held.
+class CPoolStats
+{
+public:
+  CPoolStats() : ItemSize(0), Peak(0), Allocs(0), Blocks(0), BlockBytes(0) {}
+
+  std::string Name;
+  int ItemSize;
+  int Peak;
+  long long Allocs;
+  int Blocks;
+  long long BlockBytes;
+};
+
+// Where the time and memory went in one CScytlReader::Read(): wall and CPU
+// time per phase, every worksheet that was parsed with its row and cell
+// counts, the DOM node pools' watermarks and the peak RSS of the process.
+// With SetAllocCounting(true) there are heap allocations per phase and
+// worksheet as well, also per row and per cell of the worksheets parsed.
+// With SetPerfCounting(true), where the kernel allows it, there are hardware
+// counters too: instructions, IPC, cache and branch misses, for the phases
+// and for the parse and the extraction of each worksheet apart.
+//
+// Example:
+//
+//  CReadStats stats;
+//  fin.SetStats(&stats);
+//  fin.Read();
+//  stats.Print(cerr, CReadStats::Json);
+class CReadStats
+{
+public:
+  enum EFormat
+  {
+    Text,       // a summary line and semicolon separated tables
+    Json        // one object on one line, for log collectors
+  };
+
+  CReadStats() { Clear(); }
+
+  void Clear();
+
+  // a phase that's just ended. allocations and counters on other threads
+  // for it are added with AddWorkerAllocs() and AddWorkerCounters() before
+  // it ends.
+  void AddPhase(const std::string &name, const CPhaseClock &clock);
+  void AddWorkerAllocs(const CAllocCounts &counts) { workerAllocs += counts; }
+  void AddWorkerCounters(const CPerfSample &sample) { workerCounters += sample; }
+
+  // the state of a DOM's pools, and adding that up for every DOM a Read()
+  // used. 'before' are the same pools when the Read() started, for a DOM that
+  // outlives it.
+  static void ReadPools(const tinyxml2::XMLDocument &document, std::vector<CPoolStats> &pools);
+  void AddPools(const std::vector<CPoolStats> &pools, const std::vector<CPoolStats> *before = NULL);
+
+  // note the peak RSS once the Read() is done
+  void Finish();
+
+  // wall time of all the phases together
+  double Seconds() const;
+
+  void Print(std::ostream &out, EFormat format) const;
+
+  std::string Filename;
+  unsigned long long Bytes;
+  int Threads;
+  std::vector<CPhaseStats> Phases;
+  std::vector<CWorksheetStats> Worksheets;
+  std::vector<CPoolStats> Pools;
+  long long PeakRssKb;    // 0 if unknown
+  bool Allocations;       // counted, see scytl-alloc.h
+  bool HardwareCounters;  // counted, see scytl-perf.h
+
+  // rows and cells over every worksheet parsed
+  long long Rows() const;
+  long long Cells() const;
+
+protected:
+  void printText(std::ostream &out) const;
+  void printJson(std::ostream &out) const;
+
+  CAllocCounts workerAllocs;
+  CPerfSample workerCounters;
+};
+
+// latency histograms by name, for PrintLatencies()
+typedef std::vector<std::pair<std::string, const CLatencyHistogram *> > TLatencies;
+
+// the percentiles of every histogram, in the same formats as CReadStats
+//
+// Example:
+//
+//  Latency;Count;Mean ms;Min ms;P50 ms;P90 ms;P99 ms;P99.9 ms;Max ms
+//  reload;42;8.512;7.905;8.431;9.120;11.002;11.002;11.002
+//  ...
+void PrintLatencies(std::ostream &out, const TLatencies &latencies, CReadStats::EFormat format);
+
+// "text" or "json". returns 1 if 'name' isn't either.
+int ParseStatsFormat(const std::string &name, CReadStats::EFormat &format);
+
+// the most memory the process has had resident so far, 0 if unknown
+long long PeakRssKb();
+
+#endif // SCYTL_STATS_INCLUDED
@@ -0,0 +1,214 @@
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+
+#include "scytl-trace.h"
+#include "scytl-json.h"
+
+using namespace std;
+
+class CTraceEvent
+{
+public:
+  const char *Name;
+  string Detail;
+  double Start;       // microseconds since tracing started
+  double Duration;
+};
+
+// the spans of one thread. the lock is only ever contended while the trace is
+// written or cleared.
+class CTraceBuffer
+{
+public:
+  CTraceBuffer() : Tid(0), InUse(false) {}
+
+  int Tid;
+  string ThreadName;
+  bool InUse;         // by a running thread, under registryLock
+  mutex Lock;
+  vector<CTraceEvent> Events;
+};
+
+static atomic<bool> tracing(false);
+static double epoch = 0;
+
+// buffers are never freed: when a thread exits, the next new thread takes
+// its buffer over and carries on under its tid. that keeps their number down
+// to the most threads ever running at once.
+static mutex registryLock;
+static vector<CTraceBuffer *> buffers;
+
+// hands the buffer back when the thread exits
+class CThreadSlot
+{
+public:
+  CThreadSlot() : Buffer(NULL) {}
+  ~CThreadSlot()
+  {
+    if (Buffer) {
+      lock_guard<mutex> lock(registryLock);
+      Buffer->InUse = false;
+    }
+  }
+
+  CTraceBuffer *Buffer;
+};
+
+static thread_local CThreadSlot threadSlot;
+
+static double microseconds()
+{
+  return chrono::duration<double, micro>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static CTraceBuffer *threadBuffer()
+{
+  if (threadSlot.Buffer)
+    return threadSlot.Buffer;
+
+  lock_guard<mutex> lock(registryLock);
+  CTraceBuffer *buffer = NULL;
+  for (size_t i = 0; i < buffers.size() && !buffer; ++i)
+    if (!buffers[i]->InUse)
+      buffer = buffers[i];
+  if (!buffer) {
+    buffer = new CTraceBuffer;
+    buffer->Tid = (int)buffers.size() + 1;
+    buffer->Events.reserve(256);
+    buffers.push_back(buffer);
+  } else {
+    lock_guard<mutex> bufferLock(buffer->Lock);
+    buffer->ThreadName.clear();
+  }
+  buffer->InUse = true;
+  threadSlot.Buffer = buffer;
+  return buffer;
+}
+
+void SetTracing(bool Enabled)
+{
+  if (Enabled && epoch == 0)
+    epoch = microseconds();
+  tracing.store(Enabled);
+}
+
+bool Tracing()
+{
+  return tracing.load();
+}
+
+void SetTraceThreadName(const string &Name)
+{
+  if (!tracing.load(memory_order_relaxed))
+    return;
+  CTraceBuffer *buffer = threadBuffer();
+  lock_guard<mutex> lock(buffer->Lock);
+  buffer->ThreadName = Name;
+}
+
+CTraceSpan::CTraceSpan(const char *Name)
+  : name(Name), start(-1)
+{
+  if (tracing.load(memory_order_relaxed))
+    start = microseconds();
+}
+
+CTraceSpan::CTraceSpan(const char *Name, const string &Detail)
+  : name(Name), start(-1)
+{
+  if (tracing.load(memory_order_relaxed)) {
+    detail = Detail;
+    start = microseconds();
+  }
+}
+
+void CTraceSpan::End()
+{
+  if (start < 0)
+    return;
+
+  CTraceEvent event;
+  event.Name = name;
+  event.Start = start - epoch;
+  event.Duration = microseconds() - start;
+  start = -1;
+
+  CTraceBuffer *buffer = threadBuffer();
+  lock_guard<mutex> lock(buffer->Lock);
+  buffer->Events.push_back(event);
+  buffer->Events.back().Detail.swap(detail);
+}
+
+// Example:
+//
+//  {"traceEvents":[
+//  {"name":"thread_name","ph":"M","pid":1,"tid":1,"args":{"name":"main"}},
+//  {"name":"extract","cat":"scytl","ph":"X","pid":1,"tid":2,"ts":1523.250,"dur":412.125,"args":{"detail":"President"}},
+//  ...
+//  ],"displayTimeUnit":"ms"}
+int WriteTrace(const string &Filename)
+{
+  ofstream out(Filename.c_str());
+  if (!out) {
+    cout << "Error: can't create <" << Filename << ">" << endl;
+    return 1;
+  }
+
+  out << "{\"traceEvents\":[";
+  bool first = true;
+  char line[128];
+  {
+    lock_guard<mutex> registry(registryLock);
+    for (vector<CTraceBuffer *>::const_iterator it = buffers.begin(); it != buffers.end(); ++it)
+    {
+      CTraceBuffer &buffer = **it;
+      lock_guard<mutex> lock(buffer.Lock);
+
+      snprintf(line, sizeof(line), "thread %d", buffer.Tid);
+      out << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer.Tid
+          << ",\"args\":{\"name\":";
+      WriteJsonString(out, buffer.ThreadName.empty() ? string(line) : buffer.ThreadName);
+      out << "}}";
+      first = false;
+
+      for (vector<CTraceEvent>::const_iterator event = buffer.Events.begin(); event != buffer.Events.end(); ++event)
+      {
+        out << ",\n{\"name\":";
+        WriteJsonString(out, event->Name);
+        snprintf(line, sizeof(line), ",\"cat\":\"scytl\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+                 buffer.Tid, event->Start, event->Duration);
+        out << line;
+        if (!event->Detail.empty()) {
+          out << ",\"args\":{\"detail\":";
+          WriteJsonString(out, event->Detail);
+          out << "}";
+        }
+        out << "}";
+      }
+    }
+  }
+  out << "\n],\"displayTimeUnit\":\"ms\"}" << endl;
+
+  out.close();
+  if (!out) {
+    cout << "Error writing <" << Filename << ">" << endl;
+    return 1;
+  }
+  return 0;
+}
+
+void ClearTrace()
+{
+  lock_guard<mutex> registry(registryLock);
+  for (vector<CTraceBuffer *>::const_iterator it = buffers.begin(); it != buffers.end(); ++it)
+  {
+    lock_guard<mutex> lock((*it)->Lock);
+    (*it)->Events.clear();
+  }
+}
@@ -0,0 +1,54 @@
+#ifndef SCYTL_TRACE_INCLUDED
+#define SCYTL_TRACE_INCLUDED
+
+#include <string>
+
+// A timeline of what every thread spent its time on, written as Chrome
+// trace-event JSON that chrome://tracing and ui.perfetto.dev open. Spans are
+// kept in a buffer per thread, so recording one takes no lock anybody else
+// wants; nothing is recorded until SetTracing(true), and until then a span
+// costs one relaxed atomic load.
+//
+// Example:
+//
+//  SetTracing(true);
+//  {
+//    CTraceSpan span("extract", sheet.Name);
+//    ...
+//  }
+//  WriteTrace("read.trace.json");
+void SetTracing(bool Enabled);
+bool Tracing();
+
+// what the calling thread is called in the trace, "thread <n>" if nothing.
+// does nothing while not tracing.
+void SetTraceThreadName(const std::string &Name);
+
+// a span from construction to End() or destruction, whichever comes first.
+// 'Name' must outlive the trace; it's meant to be a literal. 'Detail' is
+// what the span worked on: a workbook, a worksheet.
+class CTraceSpan
+{
+public:
+  CTraceSpan(const char *Name);
+  CTraceSpan(const char *Name, const std::string &Detail);
+  ~CTraceSpan() { End(); }
+
+  void End();
+
+private:
+  CTraceSpan(const CTraceSpan &);       // not supported
+  void operator=(const CTraceSpan &);   // not supported
+
+  const char *name;
+  std::string detail;
+  double start;     // microseconds, < 0 when not recording
+};
+
+// write every span recorded so far on every thread. returns 1 on failure.
+int WriteTrace(const std::string &Filename);
+
+// forget the spans recorded so far, e.g. once they've been written
+void ClearTrace();
+
+#endif // SCYTL_TRACE_INCLUDED
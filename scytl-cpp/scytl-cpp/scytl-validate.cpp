@@ -0,0 +1,102 @@
+#include <string>
+#include <list>
+#include <vector>
+#include <iostream>
+
+#include "scytl-validate.h"
+#include "scytl-aggregate.h"
+#include "scytl-simd.h"
+
+using namespace std;
+
+// report every row where 'expected' and 'actual' disagree
+static void compareColumns(const vector<const string *> &labels, const int *expected, const int *actual,
+                           size_t column, vector<CTotalsMismatch> &mismatches)
+{
+  size_t rows = labels.size();
+  for (size_t i = FirstDifference(expected, actual, rows); i < rows; i = FirstDifference(expected, actual, rows, i + 1))
+  {
+    CTotalsMismatch mismatch;
+    mismatch.Region = *labels[i];
+    mismatch.Column = (int)column + 1;    // Data doesn't include the label column
+    mismatch.Expected = expected[i];
+    mismatch.Actual = actual[i];
+    mismatches.push_back(mismatch);
+  }
+}
+
+void ValidateTotals(const CElection &election, vector<CTotalsMismatch> &mismatches)
+{
+  mismatches.clear();
+
+  vector<CCandidateSpan> spans;
+  CandidateSpans(election.Header, spans);
+  if (spans.empty())
+    return;
+
+  // the closing "Total" column isn't anybody's
+  int total = -1;
+  const CElectionHeader &last = election.Header.back();
+  if (last.CandidateName == "" && last.ColumnName == "Total")
+    total = (int)election.Header.size() - 2;
+
+  // work a column at a time, so each check is a handful of vector adds and
+  // one vector compare per four rows. sums wrap at 32 bits, which can only
+  // hide a mismatch in a row with billions of votes.
+  size_t columns = election.Header.size() - 1;
+  size_t rows = election.Results.size();
+  vector<const string *> labels;
+  labels.reserve(rows);
+  vector<int> votes(rows * columns, 0);
+  for (list<CLabeledTuple>::const_iterator it = election.Results.begin(); it != election.Results.end(); ++it)
+  {
+    size_t row = labels.size();
+    for (size_t c = 0; c < columns && c < it->Data.size(); ++c)
+      votes[c * rows + row] = it->Data[c];
+    labels.push_back(&it->Label);
+  }
+  if (!rows)
+    return;
+
+  vector<int> expected(rows);
+  vector<int> candidates(rows, 0);
+  for (vector<CCandidateSpan>::const_iterator it = spans.begin(); it != spans.end(); ++it)
+  {
+    const int *totalVotes = it->TotalVotes >= 0 ? &votes[it->TotalVotes * rows] : NULL;
+
+    // a candidate with nothing but a "Total Votes" column has nothing to check
+    if (totalVotes && it->End - it->First == 1) {
+      AddInt32(&candidates[0], totalVotes, rows);
+      continue;
+    }
+
+    expected.assign(rows, 0);
+    for (size_t c = it->First; c < it->End; ++c)
+    {
+      if ((int)c != it->TotalVotes)
+        AddInt32(&expected[0], &votes[c * rows], rows);
+    }
+
+    if (totalVotes) {
+      compareColumns(labels, &expected[0], totalVotes, it->TotalVotes, mismatches);
+      AddInt32(&candidates[0], totalVotes, rows);
+    } else {
+      AddInt32(&candidates[0], &expected[0], rows);
+    }
+  }
+
+  if (total >= 0)
+    compareColumns(labels, &candidates[0], &votes[total * rows], total, mismatches);
+}
+
+void PrintMismatches(ostream &out, const CElection &election)
+{
+  for (vector<CTotalsMismatch>::const_iterator it = election.Mismatches.begin(); it != election.Mismatches.end(); ++it)
+  {
+    const CElectionHeader &header = election.Header[it->Column];
+    out << "Mismatch;" << election.ElectionName << ";" << it->Region << ";";
+    if (header.CandidateName != "")
+      out << header.CandidateName << " - ";
+    out << header.ColumnName << ";" << it->Expected << ";" << it->Actual << endl;
+  }
+}
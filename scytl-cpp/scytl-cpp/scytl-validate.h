@@ -0,0 +1,20 @@
+#ifndef SCYTL_VALIDATE_INCLUDED
+#define SCYTL_VALIDATE_INCLUDED
+
+#include <vector>
+#include <iostream>
+
+#include "scytl-reader.h"
+
+// Scytl exports carry redundant totals: each candidate's "Total Votes" is the
+// sum of their vote-type columns, and the final "Total" is the sum of every
+// candidate's "Total Votes". Check both for every row, the totals row
+// included, and list the rows that don't add up.
+void ValidateTotals(const CElection &election, std::vector<CTotalsMismatch> &mismatches);
+
+// Example:
+//
+//  Mismatch;U.S. President - DEM;Arkansas;Barack Obama - Total Votes;599;600
+void PrintMismatches(std::ostream &out, const CElection &election);
+
+#endif // SCYTL_VALIDATE_INCLUDED
@@ -0,0 +1,357 @@
+#include <string>
+#include <vector>
+#include <set>
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <thread>
+#include <atomic>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/inotify.h>
+#else
+#include <ctime>
+#endif
+
+#include "scytl-watch.h"
+#include "scytl-validate.h"
+#include "scytl-diff.h"
+#include "scytl-trace.h"
+
+using namespace std;
+
+CScytlWatcher::CScytlWatcher(ostream &Out)
+  : out(Out), fd(-1), deltas(false), threads(1), indexOnly(false), stats(false), statsFormat(CReadStats::Text),
+    metricsInterval(10), metricsWritten(0)
+{
+  metrics.AddLatency("reload", &reloadLatency);
+  metrics.AddLatency("refresh", &refreshLatency);
+  metrics.AddLatency("extract", &extractLatency);
+}
+
+CScytlWatcher::~CScytlWatcher()
+{
+  for (size_t i = 0; i < files.size(); ++i)
+  {
+    delete files[i].Reader;
+    delete files[i].Stats;
+  }
+
+#ifdef __linux__
+  if (fd >= 0)
+    close(fd);
+#endif
+}
+
+double CScytlWatcher::now()
+{
+#ifdef __linux__
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+#else
+  return (double)time(NULL);
+#endif
+}
+
+int CScytlWatcher::Add(const string &Filename)
+{
+  CWatchedFile file;
+
+  string::size_type slash = Filename.find_last_of("/\\");
+  if (slash == string::npos) {
+    file.Directory = ".";
+    file.Basename = Filename;
+  } else {
+    file.Directory = slash ? Filename.substr(0, slash) : "/";
+    file.Basename = Filename.substr(slash + 1);
+  }
+
+  if (file.Basename == "")
+    return 1;
+
+  file.Wd = -1;
+  file.Reader = new CScytlReader(Filename);
+  file.Reader->SetExtractLatency(&extractLatency);
+  file.Reader->SetMetrics(&metrics);
+  file.Stats = new CReadStats();
+  files.push_back(file);
+
+  return 0;
+}
+
+int CScytlWatcher::Start()
+{
+#ifdef __linux__
+  fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd < 0) {
+    cout << "Error initializing inotify: " << strerror(errno) << endl;
+    return 1;
+  }
+
+  // IN_CLOSE_WRITE fires once a writer is done with the file, and IN_MOVED_TO
+  // covers writers that build the new file elsewhere and rename it into place.
+  // either way we never read a half written workbook.
+  for (size_t i = 0; i < files.size(); ++i)
+  {
+    files[i].Wd = inotify_add_watch(fd, files[i].Directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (files[i].Wd < 0) {
+      cout << "Error watching <" << files[i].Directory << ">: " << strerror(errno) << endl;
+      return 1;
+    }
+  }
+
+  // initial load. a workbook that can't be read yet will be picked up as soon
+  // as it is written.
+  vector<size_t> all;
+  for (size_t i = 0; i < files.size(); ++i)
+    all.push_back(i);
+  reloadAll(all, true);
+  writeTrace();
+  writeMetrics(true);
+
+  return 0;
+#else
+  cout << "Watch mode requires inotify, which isn't available on this platform" << endl;
+  return 1;
+#endif
+}
+
+int CScytlWatcher::reload(size_t i, bool initial)
+{
+  double changed, readSeconds;
+  if (readWorkbook(i, initial, changed, readSeconds))
+    return 1;
+
+  loaded(i, changed, readSeconds);
+  return 0;
+}
+
+void CScytlWatcher::loaded(size_t i, double changed, double readSeconds)
+{
+  CTraceSpan span("output", files[i].Reader->Filename());
+  reloadLatency.Record(readSeconds);
+
+  // the stats saw every DOM the read used; without them there's just the
+  // reader's own
+  vector<CPoolStats> pools;
+  if (stats)
+    pools = files[i].Stats->Pools;
+  else
+    files[i].Reader->ReadPools(pools);
+  metrics.SetPools(pools);
+
+  if (stats)
+    files[i].Stats->Print(cerr, statsFormat);
+  Reloaded(*files[i].Reader, changed, readSeconds);
+  refreshLatency.Record(now() - changed);
+
+  if (stats) {
+    TLatencies latencies;
+    Latencies(latencies);
+    PrintLatencies(cerr, latencies, statsFormat);
+  }
+}
+
+void CScytlWatcher::Latencies(TLatencies &latencies) const
+{
+  latencies.push_back(make_pair(string("reload"), &reloadLatency));
+  latencies.push_back(make_pair(string("refresh"), &refreshLatency));
+  latencies.push_back(make_pair(string("extract"), &extractLatency));
+}
+
+void CScytlWatcher::writeTrace()
+{
+  if (traceFile == "" || !Tracing())
+    return;
+  WriteTrace(traceFile);
+  ClearTrace();
+}
+
+void CScytlWatcher::writeMetrics(bool refreshed)
+{
+  if (metricsFile == "" || (!refreshed && now() < metricsWritten + metricsInterval))
+    return;
+  metrics.WriteFile(metricsFile);
+  metricsWritten = now();
+}
+
+int CScytlWatcher::readWorkbook(size_t i, bool initial, double &changed, double &readSeconds)
+{
+  CScytlReader &reader = *files[i].Reader;
+  reader.SetStats(stats ? files[i].Stats : NULL);
+  metrics.AddReloadQueue(-1);
+
+  // use the modification time as the moment the change happened, so the
+  // latency we report includes the time the event spent waiting for us.
+  // (on the initial load the file may not have changed for hours.)
+  changed = now();
+  struct stat st;
+  if (!initial && stat(reader.Filename().c_str(), &st) == 0) {
+#ifdef __linux__
+    changed = st.st_mtim.tv_sec + st.st_mtim.tv_nsec * 1e-9;
+#else
+    changed = (double)st.st_mtime;
+#endif
+  }
+
+  double start = now();
+  CWorkbookIndex index;
+  if (indexOnly ? reader.LoadIndex(index) : reader.Read()) {
+    cout << "Error reading from <" << reader.Filename() << ">" << endl;
+    return 1;
+  }
+
+  readSeconds = now() - start;
+  return 0;
+}
+
+void CScytlWatcher::reloadAll(const vector<size_t> &which, bool initial)
+{
+  metrics.AddReloadQueue((long long)which.size());
+
+  if (threads <= 1 || which.size() <= 1)
+  {
+    for (size_t k = 0; k < which.size(); ++k)
+    {
+      files[which[k]].Reader->SetThreads(threads);
+      reload(which[k], initial);
+    }
+    return;
+  }
+
+  // one workbook per thread at a time. the readers are independent, so the
+  // only thing shared is the queue.
+  vector<int> failed(which.size(), 1);
+  vector<double> changed(which.size(), 0), readSeconds(which.size(), 0);
+  atomic<size_t> next(0);
+  vector<thread> workers;
+  size_t count = threads < (int)which.size() ? (size_t)threads : which.size();
+  for (size_t w = 0; w < count; ++w)
+  {
+    workers.push_back(thread([&]() {
+      SetTraceThreadName("reload");
+      for (size_t k = next++; k < which.size(); k = next++)
+      {
+        files[which[k]].Reader->SetThreads(1);
+        failed[k] = readWorkbook(which[k], initial, changed[k], readSeconds[k]);
+      }
+    }));
+  }
+  for (size_t w = 0; w < workers.size(); ++w)
+    workers[w].join();
+
+  for (size_t k = 0; k < which.size(); ++k)
+    if (!failed[k])
+      loaded(which[k], changed[k], readSeconds[k]);
+}
+
+void CScytlWatcher::Reloaded(const CScytlReader &reader, double changed, double readSeconds)
+{
+  if (deltas) {
+    CElectionDelta delta;
+    DiffLastRead(reader, delta);
+    if (!delta.Empty()) {
+      out << "File;" << reader.Filename() << endl;
+      PrintDelta(out, delta);
+    }
+  } else {
+    out << "File;" << reader.Filename() << endl;
+    reader.Print(out);
+  }
+  out.flush();
+
+  for (vector<const CElection *>::const_iterator it = reader.ChangedResults().begin();
+       it != reader.ChangedResults().end();
+       ++it)
+  {
+    PrintMismatches(cerr, **it);
+  }
+
+  cerr << "Reloaded <" << reader.Filename() << ">: "
+       << reader.WorksheetsParsed() << " worksheets parsed in "
+       << readSeconds * 1000.0 << " ms, change to output "
+       << (now() - changed) * 1000.0 << " ms" << endl;
+}
+
+int CScytlWatcher::Poll(int timeoutMs)
+{
+#ifdef __linux__
+  struct pollfd pfd;
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+
+  // wake up in time to write the metrics
+  if (metricsFile != "") {
+    int due = (int)((metricsWritten + metricsInterval - now()) * 1000.0);
+    if (due < 0)
+      due = 0;
+    if (timeoutMs < 0 || due < timeoutMs)
+      timeoutMs = due;
+  }
+
+  int n = poll(&pfd, 1, timeoutMs);
+  if (n < 0)
+    return errno == EINTR ? 0 : 1;
+  if (n == 0) {
+    writeMetrics(false);
+    return 0;
+  }
+
+  // drain every pending event first, so a burst of writes to the same
+  // workbook only costs us one reload
+  set<size_t> changed;
+  for (;;)
+  {
+    char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    ssize_t len = read(fd, buf, sizeof(buf));
+    if (len < 0) {
+      if (errno == EAGAIN)
+        break;
+      if (errno == EINTR)
+        continue;
+      return 1;
+    }
+    if (len == 0)
+      break;
+
+    for (char *p = buf; p < buf + len; )
+    {
+      const struct inotify_event *event = (const struct inotify_event *)p;
+      if (event->len) {
+        for (size_t i = 0; i < files.size(); ++i)
+          if (files[i].Wd == event->wd && files[i].Basename == event->name)
+            changed.insert(i);
+      }
+      p += sizeof(struct inotify_event) + event->len;
+    }
+  }
+
+  reloadAll(vector<size_t>(changed.begin(), changed.end()));
+
+  // events for other files in the directory (such as the trace itself) don't
+  // make a refresh
+  if (!changed.empty())
+    writeTrace();
+  writeMetrics(!changed.empty());
+
+  return 0;
+#else
+  return 1;
+#endif
+}
+
+int CScytlWatcher::Run()
+{
+  for (;;)
+  {
+    if (Poll(-1))
+      return 1;
+  }
+}
@@ -0,0 +1,139 @@
+#ifndef SCYTL_WATCH_INCLUDED
+#define SCYTL_WATCH_INCLUDED
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "scytl-reader.h"
+
+// Keeps a set of workbooks loaded and reloads them whenever they are rewritten.
+// We watch the directory each workbook lives in rather than the file itself so
+// that writers which replace the file with rename() are picked up as well.
+class CScytlWatcher
+{
+public:
+  CScytlWatcher(std::ostream &Out);
+  virtual ~CScytlWatcher();
+
+  // register a workbook. must be called before Start().
+  int Add(const std::string &Filename);
+
+  // print only what changed on each reload instead of the full results
+  void SetDeltas(bool Deltas) { deltas = Deltas; }
+
+  // reload up to 'Threads' changed workbooks at once. a workbook that changed
+  // on its own gets all of them for its worksheets instead (see
+  // CScytlReader::SetThreads()). Reloaded() is always called on the thread
+  // doing the polling, one workbook at a time.
+  void SetThreads(int Threads) { threads = Threads < 1 ? 1 : Threads; }
+
+  // log the stats of every (re)load to cerr, before Reloaded() is called
+  // (see CReadStats), and the latency histograms after it
+  void SetStats(CReadStats::EFormat Format) { stats = true; statsFormat = Format; }
+
+  // after every refresh (the initial load, then each batch of reloads) write
+  // the spans it recorded to 'Filename' and start over, so the file always
+  // holds the latest refresh. tracing itself is turned on with SetTracing().
+  void SetTrace(const std::string &Filename) { traceFile = Filename; }
+
+  // only (re)index each workbook instead of reading it (see
+  // CScytlReader::LoadIndex()), for a Reloaded() that extracts whatever
+  // contests it needs itself
+  void SetIndexOnly(bool IndexOnly) { indexOnly = IndexOnly; }
+
+  // set up the watches and do the initial load of every workbook
+  int Start();
+
+  // descriptor that becomes readable when there are pending change events,
+  // so the watcher can be driven from somebody else's event loop
+  int Fd() const { return fd; }
+
+  // wait up to timeoutMs (-1 = forever) for change events, then reload every
+  // workbook that changed. returns 1 if the watch itself failed.
+  int Poll(int timeoutMs);
+
+  // Poll() forever
+  int Run();
+
+  size_t Count() const { return files.size(); }
+  const CScytlReader &Reader(size_t i) const { return *files[i].Reader; }
+
+  // the stats of the latest load of files[i], with SetStats()
+  const CReadStats &Stats(size_t i) const { return *files[i].Stats; }
+
+  // every (re)load since Start(), over all the workbooks: how long Read()
+  // took, how long from the write to Reloaded() being done with it, and how
+  // long each worksheet parsed took to extract
+  const CLatencyHistogram &ReloadLatency() const { return reloadLatency; }
+  const CLatencyHistogram &RefreshLatency() const { return refreshLatency; }
+  const CLatencyHistogram &ExtractLatency() const { return extractLatency; }
+
+  // all three, named "reload", "refresh" and "extract", added to 'latencies'
+  void Latencies(TLatencies &latencies) const;
+
+  // what has been ingested since Start(), for monitoring. the latencies
+  // above are part of it.
+  CScytlMetrics &Metrics() { return metrics; }
+
+  // write Metrics() to 'Filename' after every refresh, and every
+  // 'IntervalSeconds' in between for as long as Poll() or Run() are waiting
+  void SetMetricsFile(const std::string &Filename, double IntervalSeconds = 10)
+  { metricsFile = Filename; metricsInterval = IntervalSeconds; }
+
+protected:
+  // called after a workbook has been (re)loaded successfully. 'changed' is the
+  // wall clock time (seconds since the epoch) of the write that triggered it.
+  // the default prints the refreshed results along with a latency metric.
+  virtual void Reloaded(const CScytlReader &reader, double changed, double readSeconds);
+
+  static double now();
+
+  int reload(size_t i, bool initial = false);
+
+  // reload files[which[...]], several at a time if we have the threads
+  void reloadAll(const std::vector<size_t> &which, bool initial = false);
+
+  // the Read() half of reload(): 'changed' is when the workbook was written
+  int readWorkbook(size_t i, bool initial, double &changed, double &readSeconds);
+
+  // after a successful readWorkbook(), on the polling thread
+  void loaded(size_t i, double changed, double readSeconds);
+
+  // after a refresh, with SetTrace()
+  void writeTrace();
+
+  // with SetMetricsFile(), after a refresh or once the interval is up
+  void writeMetrics(bool refreshed);
+
+  std::ostream &out;
+
+private:
+  class CWatchedFile
+  {
+  public:
+    std::string Directory;
+    std::string Basename;
+    int Wd;
+    CScytlReader *Reader;
+    CReadStats *Stats;
+  };
+
+  int fd;
+  bool deltas;
+  int threads;
+  bool indexOnly;
+  bool stats;
+  CReadStats::EFormat statsFormat;
+  std::string traceFile;
+  CLatencyHistogram reloadLatency;
+  CLatencyHistogram refreshLatency;
+  CLatencyHistogram extractLatency;
+  CScytlMetrics metrics;
+  std::string metricsFile;
+  double metricsInterval;
+  double metricsWritten;
+  std::vector<CWatchedFile> files;
+};
+
+#endif // SCYTL_WATCH_INCLUDED
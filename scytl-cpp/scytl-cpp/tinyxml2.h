@@ -285,6 +285,14 @@ public:
     virtual int ItemSize() const = 0;
     virtual void* Alloc() = 0;
     virtual void Free( void* ) = 0;
+
+    /// Items allocated right now, the most there ever were at once, and in total.
+    virtual int CurrentAllocs() const = 0;
+    virtual int MaxAllocs() const = 0;
+    virtual int TotalAllocs() const = 0;
+    /// Blocks the items are carved from, and the bytes each one takes.
+    virtual int Blocks() const = 0;
+    virtual int BlockSize() const = 0;
 };
 
 
@@ -306,9 +314,21 @@ public:
     virtual int ItemSize() const	{
         return SIZE;
     }
-    int CurrentAllocs() const		{
+    virtual int CurrentAllocs() const	{
         return _currentAllocs;
     }
+    virtual int MaxAllocs() const	{
+        return _maxAllocs;
+    }
+    virtual int TotalAllocs() const	{
+        return _nAllocs;
+    }
+    virtual int Blocks() const	{
+        return _blockPtrs.Size();
+    }
+    virtual int BlockSize() const	{
+        return sizeof( Block );
+    }
 
     virtual void* Alloc() {
         if ( !_root ) {
@@ -1504,6 +1524,22 @@ public:
     /// If there is an error, print it to stdout.
     void PrintError() const;
 
+    /// The pools the document's nodes are allocated from. They keep their
+    /// blocks until the document is destroyed, so MaxAllocs() is the largest
+    /// DOM this document has held.
+    const MemPool& ElementPool() const {
+        return _elementPool;
+    }
+    const MemPool& AttributePool() const {
+        return _attributePool;
+    }
+    const MemPool& TextPool() const {
+        return _textPool;
+    }
+    const MemPool& CommentPool() const {
+        return _commentPool;
+    }
+
     // internal
     char* Identify( char* p, XMLNode** node );
 